@@ -46,6 +46,8 @@
 #include <linux/cred.h>
 #include <linux/dax.h>
 #include <linux/uaccess.h>
+#include <linux/hashtable.h>
+#include <linux/iversion.h>
 #include <asm/param.h>
 #include <asm/page.h>
 
@@ -425,6 +427,206 @@ static int elf_read(struct file *file, void *buf, size_t len, loff_t pos)
 	return 0;
 }
 
+#ifdef CONFIG_BINFMT_ELF_HDR_CACHE
+/*
+ * Cache of the header reads done at exec time.
+ *
+ * Every exec reads the program headers of the binary, its PT_INTERP path
+ * and then the ELF and program headers of the interpreter. For binaries
+ * that are executed over and over those reads always return the same
+ * bytes, so remember them per inode and satisfy the next exec from memory
+ * instead of going through kernel_read() and the page cache.
+ *
+ * An entry is keyed by the inode and is only used while the inode's size,
+ * mtime, ctime, generation and i_version are unchanged. Timestamps alone
+ * can miss a same-size rewrite within one tick, so only inodes whose
+ * filesystem maintains i_version are cached: i_version is queried before
+ * the read, which makes the next change to the inode bump it, so any
+ * write or truncate after that invalidates the entry. Entries are
+ * append-only: a read is added by publishing a new slot after its data,
+ * so lookups only need RCU.
+ *
+ * The table is small and fixed, buckets are kept at ELF_CACHE_DEPTH
+ * entries by dropping the oldest one, so the memory used is bounded by
+ * ELF_CACHE_DEPTH << ELF_CACHE_BITS entries of ELF_CACHE_SIZE bytes.
+ */
+#define ELF_CACHE_BITS		8
+#define ELF_CACHE_DEPTH		4
+#define ELF_CACHE_READS		6
+#define ELF_CACHE_SIZE		2048
+
+struct elf_hdr_cache {
+	struct hlist_node	node;
+	struct rcu_head		rcu;
+	const struct inode	*inode;		/* only compared, never used */
+	unsigned long		ino;
+	dev_t			dev;
+	u32			generation;
+	loff_t			size;
+	struct timespec64	mtime;
+	struct timespec64	ctime;
+	u64			iversion;
+	unsigned int		nr;		/* published reads */
+	unsigned int		used;		/* bytes of data[] in use */
+	struct {
+		loff_t		pos;
+		unsigned int	len;
+		unsigned int	off;
+	} reads[ELF_CACHE_READS];
+	char			data[];
+};
+
+#define ELF_CACHE_DATA	(ELF_CACHE_SIZE - sizeof(struct elf_hdr_cache))
+
+static DEFINE_HASHTABLE(elf_hdr_cache, ELF_CACHE_BITS);
+static DEFINE_SPINLOCK(elf_hdr_cache_lock);
+
+static bool elf_cache_match(const struct elf_hdr_cache *c,
+			    const struct inode *inode, u64 iversion)
+{
+	return c->inode == inode &&
+	       c->ino == inode->i_ino &&
+	       c->dev == inode->i_sb->s_dev &&
+	       c->generation == inode->i_generation &&
+	       c->size == i_size_read(inode) &&
+	       timespec64_equal(&c->mtime, &inode->i_mtime) &&
+	       timespec64_equal(&c->ctime, &inode->i_ctime) &&
+	       c->iversion == iversion;
+}
+
+static void elf_cache_init(struct elf_hdr_cache *c, const struct inode *inode,
+			   u64 iversion)
+{
+	c->inode = inode;
+	c->ino = inode->i_ino;
+	c->dev = inode->i_sb->s_dev;
+	c->generation = inode->i_generation;
+	c->size = i_size_read(inode);
+	c->mtime = inode->i_mtime;
+	c->ctime = inode->i_ctime;
+	c->iversion = iversion;
+	c->nr = 0;
+	c->used = 0;
+}
+
+static bool elf_cache_lookup(const struct inode *inode, u64 iversion,
+			     void *buf, size_t len, loff_t pos)
+{
+	struct elf_hdr_cache *c;
+	bool found = false;
+	unsigned int i, nr;
+
+	rcu_read_lock();
+	hash_for_each_possible_rcu(elf_hdr_cache, c, node, (unsigned long)inode) {
+		if (c->inode != inode)
+			continue;
+		if (!elf_cache_match(c, inode, iversion))
+			break;
+		/* Pairs with the smp_store_release() in elf_cache_insert() */
+		nr = smp_load_acquire(&c->nr);
+		for (i = 0; i < nr; i++) {
+			if (c->reads[i].pos == pos && c->reads[i].len == len) {
+				memcpy(buf, c->data + c->reads[i].off, len);
+				found = true;
+				break;
+			}
+		}
+		break;
+	}
+	rcu_read_unlock();
+	return found;
+}
+
+static void elf_cache_insert(const struct inode *inode, u64 iversion,
+			     const void *buf, size_t len, loff_t pos)
+{
+	struct elf_hdr_cache *c, *new, *stale = NULL, *last = NULL;
+	unsigned int depth = 0;
+
+	if (len > ELF_CACHE_DATA)
+		return;
+
+	new = kmalloc(ELF_CACHE_SIZE, GFP_KERNEL);
+	if (!new)
+		return;
+
+	spin_lock(&elf_hdr_cache_lock);
+	hash_for_each_possible(elf_hdr_cache, c, node, (unsigned long)inode) {
+		depth++;
+		last = c;
+		if (c->inode != inode)
+			continue;
+		if (!elf_cache_match(c, inode, iversion)) {
+			stale = c;
+			continue;
+		}
+		if (c->nr < ELF_CACHE_READS &&
+		    c->used + len <= ELF_CACHE_DATA) {
+			unsigned int nr = c->nr;
+
+			c->reads[nr].pos = pos;
+			c->reads[nr].len = len;
+			c->reads[nr].off = c->used;
+			memcpy(c->data + c->used, buf, len);
+			c->used += len;
+			smp_store_release(&c->nr, nr + 1);
+		}
+		spin_unlock(&elf_hdr_cache_lock);
+		kfree(new);
+		return;
+	}
+
+	if (stale) {
+		hash_del_rcu(&stale->node);
+		kfree_rcu(stale, rcu);
+	} else if (depth >= ELF_CACHE_DEPTH) {
+		hash_del_rcu(&last->node);
+		kfree_rcu(last, rcu);
+	}
+
+	elf_cache_init(new, inode, iversion);
+	new->reads[0].pos = pos;
+	new->reads[0].len = len;
+	new->reads[0].off = 0;
+	memcpy(new->data, buf, len);
+	new->used = len;
+	new->nr = 1;
+	hash_add_rcu(elf_hdr_cache, &new->node, (unsigned long)inode);
+	spin_unlock(&elf_hdr_cache_lock);
+}
+
+/*
+ * elf_read() for the headers needed at exec time, served from the header
+ * cache when the same bytes were already read from the unchanged inode.
+ */
+static int elf_read_cached(struct file *file, void *buf, size_t len,
+			   loff_t pos)
+{
+	struct inode *inode = file_inode(file);
+	u64 iversion;
+	int retval;
+
+	if (!IS_I_VERSION(inode))
+		return elf_read(file, buf, len, pos);
+
+	/* Before the read, so that a later write is seen as a new i_version */
+	iversion = inode_query_iversion(inode);
+	if (elf_cache_lookup(inode, iversion, buf, len, pos))
+		return 0;
+
+	retval = elf_read(file, buf, len, pos);
+	if (!retval)
+		elf_cache_insert(inode, iversion, buf, len, pos);
+	return retval;
+}
+#else
+static inline int elf_read_cached(struct file *file, void *buf, size_t len,
+				  loff_t pos)
+{
+	return elf_read(file, buf, len, pos);
+}
+#endif /* CONFIG_BINFMT_ELF_HDR_CACHE */
+
 static unsigned long maximum_alignment(struct elf_phdr *cmds, int nr)
 {
 	unsigned long alignment = 0;
@@ -479,7 +681,7 @@ static struct elf_phdr *load_elf_phdrs(const struct elfhdr *elf_ex,
 		goto out;
 
 	/* Read in the program headers */
-	retval = elf_read(elf_file, elf_phdata, size, elf_ex->e_phoff);
+	retval = elf_read_cached(elf_file, elf_phdata, size, elf_ex->e_phoff);
 	if (retval < 0) {
 		err = retval;
 		goto out;
@@ -883,8 +1085,8 @@ static int load_elf_binary(struct linux_binprm *bprm)
 		if (!elf_interpreter)
 			goto out_free_ph;
 
-		retval = elf_read(bprm->file, elf_interpreter, elf_ppnt->p_filesz,
-				  elf_ppnt->p_offset);
+		retval = elf_read_cached(bprm->file, elf_interpreter,
+					 elf_ppnt->p_filesz, elf_ppnt->p_offset);
 		if (retval < 0)
 			goto out_free_interp;
 		/* make sure path is NULL terminated */
@@ -911,8 +1113,8 @@ static int load_elf_binary(struct linux_binprm *bprm)
 		}
 
 		/* Get the exec headers */
-		retval = elf_read(interpreter, interp_elf_ex,
-				  sizeof(*interp_elf_ex), 0);
+		retval = elf_read_cached(interpreter, interp_elf_ex,
+					 sizeof(*interp_elf_ex), 0);
 		if (retval < 0)
 			goto out_free_dentry;
 
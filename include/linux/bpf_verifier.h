@@ -56,6 +56,8 @@ struct bpf_reg_state {
 
 		u32 mem_size; /* for PTR_TO_MEM | PTR_TO_MEM_OR_NULL */
 
+		u32 subprogno; /* for PTR_TO_FUNC */
+
 		/* Max size from any of the above. */
 		unsigned long raw;
 	};
@@ -192,6 +194,11 @@ struct bpf_func_state {
 	 */
 	u32 subprogno;
 
+	/* this frame is a callback run by a helper such as bpf_loop() */
+	bool in_callback_fn;
+	/* the callback was handed a pointer into the stack of a caller */
+	bool callback_ctx_on_stack;
+
 	/* The following fields should be last. See copy_func_state() */
 	int acquired_refs;
 	struct bpf_reference_state *refs;
@@ -288,6 +295,10 @@ struct bpf_verifier_state_list {
 	struct bpf_verifier_state state;
 	struct bpf_verifier_state_list *next;
 	int miss_cnt, hit_cnt;
+	/* hash of the parts of 'state' that states_equal() requires to
+	 * match exactly, see state_shape_hash()
+	 */
+	u32 shape_hash;
 };
 
 /* Possible states for alu_state member. */
@@ -422,6 +433,10 @@ struct bpf_verifier_env {
 	 * memory consumption during verification
 	 */
 	u32 peak_states;
+	/* number of times the search was pruned at an equivalent state */
+	u32 pruned_states;
+	/* number of explored states ruled out by shape hash alone */
+	u32 shape_hash_skips;
 	/* longest register parentage chain walked for liveness marking */
 	u32 longest_mark_read_walk;
 };
@@ -195,6 +195,10 @@ enum  hrtimer_base_type {
  * @nr_retries:		Total number of hrtimer interrupt retries
  * @nr_hangs:		Total number of hrtimer interrupt hangs
  * @max_hang_time:	Maximum time spent in hrtimer_interrupt
+ * @nr_batched:		Total number of events expired in the same hrtimer
+ *			interrupt instead of reprogramming the device
+ * @nr_coalesced:	Total number of timers expired ahead of an earlier
+ *			queued one because their slack window had started
  * @softirq_expiry_lock: Lock which is taken while softirq based hrtimer are
  *			 expired
  * @timer_waiters:	A hrtimer_cancel() invocation waits for the timer
@@ -225,7 +229,9 @@ struct hrtimer_cpu_base {
 	unsigned short			nr_retries;
 	unsigned short			nr_hangs;
 	unsigned int			max_hang_time;
+	unsigned int			nr_batched;
 #endif
+	unsigned int			nr_coalesced;
 #ifdef CONFIG_PREEMPT_RT
 	spinlock_t			softirq_expiry_lock;
 	atomic_t			timer_waiters;
@@ -37,6 +37,11 @@ struct pt_regs;
  * @affinity_hint:	hint to user space for preferred irq affinity
  * @affinity_notify:	context for notification of affinity changes
  * @pending_mask:	pending rebalanced interrupts
+ * @balance_count:	tot_count at the last in-kernel balancer sample
+ * @balance_rate:	interrupts per second over the last balancer interval
+ * @balance_cpu:	CPU the in-kernel balancer last moved the irq to, or -1
+ * @balance_next:	jiffies before which the balancer won't move the irq
+ * @balance_mask:	affinity the irq had before the balancer first moved it
  * @threads_oneshot:	bitfield to handle shared oneshot threads
  * @threads_active:	number of irqaction threads currently running
  * @wait_for_threads:	wait queue for sync_irq to wait for threaded handlers
@@ -77,6 +82,13 @@ struct irq_desc {
 #ifdef CONFIG_GENERIC_PENDING_IRQ
 	cpumask_var_t		pending_mask;
 #endif
+#ifdef CONFIG_IRQ_BALANCE
+	unsigned int		balance_count;
+	unsigned int		balance_rate;
+	int			balance_cpu;
+	unsigned long		balance_next;
+	cpumask_var_t		balance_mask;
+#endif
 #endif
 	unsigned long		threads_oneshot;
 	atomic_t		threads_active;
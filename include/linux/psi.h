@@ -29,6 +29,7 @@ int psi_show(struct seq_file *s, struct psi_group *group, enum psi_res res);
 #ifdef CONFIG_CGROUPS
 int psi_cgroup_alloc(struct cgroup *cgrp);
 void psi_cgroup_free(struct cgroup *cgrp);
+void psi_cgroup_enable(struct cgroup *cgrp, bool enable);
 void cgroup_move_task(struct task_struct *p, struct css_set *to);
 
 struct psi_trigger *psi_trigger_create(struct psi_group *group,
@@ -134,6 +134,12 @@ struct psi_trigger {
 };
 
 struct psi_group {
+	/*
+	 * Accounting can be switched off per cgroup through cgroup.pressure.
+	 * This does not switch off the cgroup's descendants.
+	 */
+	bool enabled;
+
 	/* Protects data used by the aggregator */
 	struct mutex avgs_lock;
 
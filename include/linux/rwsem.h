@@ -51,6 +51,9 @@ struct rw_semaphore {
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map	dep_map;
 #endif
+#ifdef CONFIG_RWSEM_CLASS_STATS
+	const char *stat_name;	/* contention statistics class */
+#endif
 };
 
 /* In all implementations count != 0 means locked */
@@ -86,6 +89,12 @@ static inline int rwsem_is_locked(struct rw_semaphore *sem)
 #define __RWSEM_OPT_INIT(lockname)
 #endif
 
+#ifdef CONFIG_RWSEM_CLASS_STATS
+# define __RWSEM_STAT_INIT(lockname) .stat_name = #lockname,
+#else
+# define __RWSEM_STAT_INIT(lockname)
+#endif
+
 #define __RWSEM_INITIALIZER(name)				\
 	{ __RWSEM_COUNT_INIT(name),				\
 	  .owner = ATOMIC_LONG_INIT(0),				\
@@ -93,6 +102,7 @@ static inline int rwsem_is_locked(struct rw_semaphore *sem)
 	  .wait_lock = __RAW_SPIN_LOCK_UNLOCKED(name.wait_lock),\
 	  .wait_list = LIST_HEAD_INIT((name).wait_list),	\
 	  __RWSEM_DEBUG_INIT(name)				\
+	  __RWSEM_STAT_INIT(name)				\
 	  __RWSEM_DEP_MAP_INIT(name) }
 
 #define DECLARE_RWSEM(name) \
@@ -40,6 +40,7 @@ struct audit_context;
 struct backing_dev_info;
 struct bio_list;
 struct blk_plug;
+struct bpf_local_storage;
 struct capture_control;
 struct cfs_rq;
 struct fs_struct;
@@ -305,6 +306,9 @@ struct sched_info {
 	/* When were we last queued to run? */
 	unsigned long long		last_queued;
 
+	/* Was the current wait on a runqueue started by a wakeup? */
+	unsigned int			wakeup_queued;
+
 #endif /* CONFIG_SCHED_INFO */
 };
 
@@ -1333,6 +1337,10 @@ struct task_struct {
 	/* Used by LSM modules for access restriction: */
 	void				*security;
 #endif
+#ifdef CONFIG_BPF_SYSCALL
+	/* Used by BPF task local storage */
+	struct bpf_local_storage __rcu	*bpf_storage;
+#endif
 
 #ifdef CONFIG_GCC_PLUGIN_STACKLEAK
 	unsigned long			lowest_stack;
@@ -1667,6 +1675,11 @@ static inline int set_cpus_allowed_ptr(struct task_struct *p, const struct cpuma
 #endif
 
 extern int yield_to(struct task_struct *p, bool preempt);
+#ifdef CONFIG_SCHED_PROXY_EXEC
+extern void sched_proxy_donate(struct task_struct *owner);
+#else
+static inline void sched_proxy_donate(struct task_struct *owner) { }
+#endif
 extern void set_user_nice(struct task_struct *p, long nice);
 extern int task_prio(const struct task_struct *p);
 
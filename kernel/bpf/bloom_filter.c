@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bloom_filter.c: BPF bloom filter map
+ *
+ * A bloom filter answers "definitely not present" or "probably present" for
+ * a value, in a fixed amount of memory and without ever touching the
+ * values themselves. Placed in front of a large hash map, it lets the
+ * common miss be answered from a compact bit array instead of walking a
+ * hash bucket that is unlikely to be in the cache.
+ *
+ * Values are added with bpf_map_push_elem() and tested with
+ * bpf_map_peek_elem(), which returns 0 if the value may be present and
+ * -ENOENT if it is not. From user space, BPF_MAP_UPDATE_ELEM adds and
+ * BPF_MAP_LOOKUP_ELEM tests a value. Values cannot be removed.
+ */
+#include <linux/bitmap.h>
+#include <linux/bpf.h>
+#include <linux/btf.h>
+#include <linux/err.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+
+#define BLOOM_CREATE_FLAG_MASK \
+	(BPF_F_NUMA_NODE | BPF_F_ZERO_SEED | BPF_F_ACCESS_MASK)
+
+/* The lowest 4 bits of map_extra hold the number of hash functions */
+#define BLOOM_NR_HASH_MASK	0xF
+#define BLOOM_NR_HASH_DEFAULT	5
+
+struct bpf_bloom_filter {
+	struct bpf_map map;
+	u32 bitset_mask;
+	u32 hash_seed;
+	/* Number of u32s in the value if its size is a multiple of u32, in
+	 * which case the faster jhash2() is used, 0 otherwise.
+	 */
+	u32 aligned_u32_count;
+	u32 nr_hash_funcs;
+	unsigned long bitset[];
+};
+
+static struct bpf_bloom_filter *bpf_bloom_filter(struct bpf_map *map)
+{
+	return container_of(map, struct bpf_bloom_filter, map);
+}
+
+static u32 bloom_hash(struct bpf_bloom_filter *bloom, void *value,
+		      u32 value_size, u32 index)
+{
+	u32 h;
+
+	if (bloom->aligned_u32_count)
+		h = jhash2(value, bloom->aligned_u32_count,
+			   bloom->hash_seed + index);
+	else
+		h = jhash(value, value_size, bloom->hash_seed + index);
+
+	return h & bloom->bitset_mask;
+}
+
+static int bloom_map_peek_elem(struct bpf_map *map, void *value)
+{
+	struct bpf_bloom_filter *bloom = bpf_bloom_filter(map);
+	u32 i, h;
+
+	for (i = 0; i < bloom->nr_hash_funcs; i++) {
+		h = bloom_hash(bloom, value, map->value_size, i);
+		if (!test_bit(h, bloom->bitset))
+			return -ENOENT;
+	}
+
+	return 0;
+}
+
+static int bloom_map_push_elem(struct bpf_map *map, void *value, u64 flags)
+{
+	struct bpf_bloom_filter *bloom = bpf_bloom_filter(map);
+	u32 i, h;
+
+	if (flags != BPF_ANY)
+		return -EINVAL;
+
+	/* Lockless, bits are only ever set. Skip the atomic for bits which
+	 * are set already so that pushing values that are mostly present
+	 * does not keep bouncing the cache lines between CPUs.
+	 */
+	for (i = 0; i < bloom->nr_hash_funcs; i++) {
+		h = bloom_hash(bloom, value, map->value_size, i);
+		if (!test_bit(h, bloom->bitset))
+			set_bit(h, bloom->bitset);
+	}
+
+	return 0;
+}
+
+static int bloom_map_pop_elem(struct bpf_map *map, void *value)
+{
+	return -EOPNOTSUPP;
+}
+
+static int bloom_map_delete_elem(struct bpf_map *map, void *value)
+{
+	return -EOPNOTSUPP;
+}
+
+static int bloom_map_get_next_key(struct bpf_map *map, void *key,
+				  void *next_key)
+{
+	return -EOPNOTSUPP;
+}
+
+/* Called from syscall */
+static int bloom_map_alloc_check(union bpf_attr *attr)
+{
+	if (!bpf_capable())
+		return -EPERM;
+
+	if (attr->key_size != 0 || attr->value_size == 0 ||
+	    attr->max_entries == 0 ||
+	    attr->map_flags & ~BLOOM_CREATE_FLAG_MASK ||
+	    !bpf_map_flags_access_ok(attr->map_flags) ||
+	    attr->map_extra & ~BLOOM_NR_HASH_MASK)
+		return -EINVAL;
+
+	if (attr->value_size > KMALLOC_MAX_SIZE)
+		/* if value_size is bigger, the user space won't be able to
+		 * access the elements.
+		 */
+		return -E2BIG;
+
+	return 0;
+}
+
+static struct bpf_map *bloom_map_alloc(union bpf_attr *attr)
+{
+	u32 bitset_bytes, bitset_mask, nr_hash_funcs, nr_bits;
+	int ret, numa_node = bpf_map_attr_numa_node(attr);
+	struct bpf_map_memory mem = {0};
+	struct bpf_bloom_filter *bloom;
+	u64 cost;
+
+	nr_hash_funcs = attr->map_extra & BLOOM_NR_HASH_MASK;
+	if (!nr_hash_funcs)
+		nr_hash_funcs = BLOOM_NR_HASH_DEFAULT;
+
+	/* The bit array size that minimizes the false positive rate is
+	 * n * k / ln(2), for n expected entries and k hash functions. 7 / 5
+	 * approximates 1 / ln(2).
+	 *
+	 * It is rounded up to a power of two so that a mask can be used in
+	 * place of a modulo. If that overflows a u32, the bit array gets
+	 * 2^32 bits.
+	 */
+	if (check_mul_overflow(attr->max_entries, nr_hash_funcs, &nr_bits) ||
+	    check_mul_overflow(nr_bits / 5, (u32)7, &nr_bits) ||
+	    nr_bits > (1UL << 31)) {
+		/* U32_MAX bits rounds up to the same number of bytes */
+		bitset_bytes = BITS_TO_BYTES(U32_MAX);
+		bitset_mask = U32_MAX;
+	} else {
+		if (nr_bits <= BITS_PER_LONG)
+			nr_bits = BITS_PER_LONG;
+		else
+			nr_bits = roundup_pow_of_two(nr_bits);
+		bitset_bytes = BITS_TO_BYTES(nr_bits);
+		bitset_mask = nr_bits - 1;
+	}
+
+	bitset_bytes = roundup(bitset_bytes, sizeof(unsigned long));
+	cost = sizeof(*bloom) + (u64)bitset_bytes;
+
+	ret = bpf_map_charge_init(&mem, cost);
+	if (ret < 0)
+		return ERR_PTR(ret);
+
+	bloom = bpf_map_area_alloc(cost, numa_node);
+	if (!bloom) {
+		bpf_map_charge_finish(&mem);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	memset(bloom, 0, sizeof(*bloom));
+	bpf_map_init_from_attr(&bloom->map, attr);
+	bpf_map_charge_move(&bloom->map.memory, &mem);
+
+	bloom->nr_hash_funcs = nr_hash_funcs;
+	bloom->bitset_mask = bitset_mask;
+
+	if ((attr->value_size & (sizeof(u32) - 1)) == 0)
+		bloom->aligned_u32_count = attr->value_size / sizeof(u32);
+
+	if (!(attr->map_flags & BPF_F_ZERO_SEED))
+		bloom->hash_seed = get_random_int();
+
+	return &bloom->map;
+}
+
+/* Called when map->refcnt goes to zero, either from workqueue or from syscall */
+static void bloom_map_free(struct bpf_map *map)
+{
+	bpf_map_area_free(bpf_bloom_filter(map));
+}
+
+static void *bloom_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	/* The eBPF program should use map_peek_elem instead */
+	return ERR_PTR(-EINVAL);
+}
+
+static int bloom_map_update_elem(struct bpf_map *map, void *key,
+				 void *value, u64 flags)
+{
+	/* The eBPF program should use map_push_elem instead */
+	return -EINVAL;
+}
+
+static int bloom_map_check_btf(const struct bpf_map *map,
+			       const struct btf *btf,
+			       const struct btf_type *key_type,
+			       const struct btf_type *value_type)
+{
+	/* Bloom filter maps are keyless */
+	return btf_type_is_void(key_type) ? 0 : -EINVAL;
+}
+
+static int bloom_map_btf_id;
+const struct bpf_map_ops bloom_filter_map_ops = {
+	.map_meta_equal = bpf_map_meta_equal,
+	.map_alloc_check = bloom_map_alloc_check,
+	.map_alloc = bloom_map_alloc,
+	.map_free = bloom_map_free,
+	.map_get_next_key = bloom_map_get_next_key,
+	.map_push_elem = bloom_map_push_elem,
+	.map_peek_elem = bloom_map_peek_elem,
+	.map_pop_elem = bloom_map_pop_elem,
+	.map_lookup_elem = bloom_map_lookup_elem,
+	.map_update_elem = bloom_map_update_elem,
+	.map_delete_elem = bloom_map_delete_elem,
+	.map_check_btf = bloom_map_check_btf,
+	.map_btf_name = "bpf_bloom_filter",
+	.map_btf_id = &bloom_map_btf_id,
+};
@@ -59,6 +59,7 @@ void bpf_inode_storage_free(struct inode *inode)
 	bool free_inode_storage = false;
 	struct bpf_storage_blob *bsb;
 	struct hlist_node *n;
+	unsigned long flags;
 
 	bsb = bpf_inode(inode);
 	if (!bsb)
@@ -81,7 +82,7 @@ void bpf_inode_storage_free(struct inode *inode)
 	 * when unlinking elem from the local_storage->list and
 	 * the map's bucket->list.
 	 */
-	raw_spin_lock_bh(&local_storage->lock);
+	raw_spin_lock_irqsave(&local_storage->lock, flags);
 	hlist_for_each_entry_safe(selem, n, &local_storage->list, snode) {
 		/* Always unlink from map before unlinking from
 		 * local_storage.
@@ -90,7 +91,7 @@ void bpf_inode_storage_free(struct inode *inode)
 		free_inode_storage = bpf_selem_unlink_storage_nolock(
 			local_storage, selem, false);
 	}
-	raw_spin_unlock_bh(&local_storage->lock);
+	raw_spin_unlock_irqrestore(&local_storage->lock, flags);
 	rcu_read_unlock();
 
 	/* free_inoode_storage should always be true as long as
@@ -237,7 +238,7 @@ static void inode_storage_map_free(struct bpf_map *map)
 
 	smap = (struct bpf_local_storage_map *)map;
 	bpf_local_storage_cache_idx_free(&inode_cache, smap->cache_idx);
-	bpf_local_storage_map_free(smap);
+	bpf_local_storage_map_free(smap, NULL);
 }
 
 static int inode_storage_map_btf_id;
@@ -661,3 +661,22 @@ int bpf_iter_run_prog(struct bpf_prog *prog, void *ctx)
 	 */
 	return ret == 0 ? 0 : -EAGAIN;
 }
+
+/* Shared by the tcp and udp targets, which resume from the same kind of
+ * position: a hash table bucket and the cookie of the last socket shown.
+ */
+int bpf_iter_attach_sock(struct bpf_prog *prog,
+			 union bpf_iter_link_info *linfo,
+			 struct bpf_iter_aux_info *aux)
+{
+	aux->sock.cookie = linfo->sock.cookie;
+	aux->sock.bucket = linfo->sock.bucket;
+	return 0;
+}
+
+void bpf_iter_sock_show_fdinfo(const struct bpf_iter_aux_info *aux,
+			       struct seq_file *seq)
+{
+	seq_printf(seq, "bucket:\t%u\n", aux->sock.bucket);
+	seq_printf(seq, "cookie:\t%llu\n", aux->sock.cookie);
+}
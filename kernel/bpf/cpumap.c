@@ -27,7 +27,7 @@
 #include <linux/capability.h>
 #include <trace/events/xdp.h>
 
-#include <linux/netdevice.h>   /* netif_receive_skb_core */
+#include <linux/netdevice.h>   /* napi_gro_receive */
 #include <linux/etherdevice.h> /* eth_type_trans */
 
 /* General idea: XDP packets getting XDP redirected to another CPU,
@@ -65,6 +65,9 @@ struct bpf_cpu_map_entry {
 	struct bpf_cpumap_val value;
 	struct bpf_prog *prog;
 
+	/* GRO state of the kthread, never polled as a NAPI instance */
+	struct napi_struct napi;
+
 	atomic_t refcnt; /* Control when this struct can be free'ed */
 	struct rcu_head rcu;
 
@@ -300,6 +303,7 @@ static int cpu_map_kthread_run(void *data)
 {
 	struct bpf_cpu_map_entry *rcpu = data;
 
+	napi_gro_init(&rcpu->napi);
 	set_current_state(TASK_INTERRUPTIBLE);
 
 	/* When kthread gives stop order, then rcpu have been disconnected
@@ -362,7 +366,6 @@ static int cpu_map_kthread_run(void *data)
 		for (i = 0; i < nframes; i++) {
 			struct xdp_frame *xdpf = frames[i];
 			struct sk_buff *skb = skbs[i];
-			int ret;
 
 			skb = cpu_map_build_skb(xdpf, skb);
 			if (!skb) {
@@ -370,11 +373,16 @@ static int cpu_map_kthread_run(void *data)
 				continue;
 			}
 
-			/* Inject into network stack */
-			ret = netif_receive_skb_core(skb);
-			if (ret == NET_RX_DROP)
-				drops++;
+			/* Inject into network stack, through GRO */
+			napi_gro_receive(&rcpu->napi, skb);
 		}
+		/* Pass the batch up as a list. GRO may hold on to young
+		 * packets while more frames are queued, but everything is
+		 * completed before the ring runs empty and the kthread can
+		 * sleep or stop.
+		 */
+		napi_gro_flush_list(&rcpu->napi,
+				    !__ptr_ring_empty(rcpu->queue));
 		/* Feedback loop via tracepoint */
 		trace_xdp_cpumap_kthread(rcpu->map_id, n, drops, sched, &stats);
 
@@ -12,6 +12,7 @@
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include <net/ipv6.h>
 #include <uapi/linux/btf.h>
 
@@ -28,13 +29,38 @@ struct lpm_trie_node {
 	u8				data[];
 };
 
+/* Large tries get a table indexed by the first LPM_STRIDE_BITS bits of the
+ * key, which lets lookups skip the top levels of the trie. See the comment
+ * above lpm_stride_rebuild().
+ */
+#define LPM_STRIDE_BITS		16
+#define LPM_STRIDE_SIZE		(1U << LPM_STRIDE_BITS)
+#define LPM_STRIDE_MIN_ENTRIES	16384
+#define LPM_STRIDE_DELAY	(HZ / 10)
+
+struct lpm_stride_entry {
+	/* node to continue the trie walk at */
+	struct lpm_trie_node		*start;
+	/* best match among the nodes skipped to get there */
+	struct lpm_trie_node		*found;
+};
+
+struct lpm_stride_table {
+	struct rcu_head			rcu;
+	struct lpm_stride_entry		entries[LPM_STRIDE_SIZE];
+};
+
 struct lpm_trie {
 	struct bpf_map			map;
 	struct lpm_trie_node __rcu	*root;
+	struct lpm_stride_table __rcu	*stride;
 	size_t				n_entries;
 	size_t				max_prefixlen;
 	size_t				data_size;
 	spinlock_t			lock;
+	/* bumped on every change, protected by @lock */
+	u64				gen;
+	struct delayed_work		stride_work;
 };
 
 /* This trie implements a longest prefix match algorithm that can be used to
@@ -223,16 +249,35 @@ static size_t longest_prefix_match(const struct lpm_trie *trie,
 	return prefixlen;
 }
 
+static inline u32 lpm_stride_index(const u8 *data)
+{
+	return data[0] << 8 | data[1];
+}
+
 /* Called from syscall or from eBPF program */
 static void *trie_lookup_elem(struct bpf_map *map, void *_key)
 {
 	struct lpm_trie *trie = container_of(map, struct lpm_trie, map);
 	struct lpm_trie_node *node, *found = NULL;
 	struct bpf_lpm_trie_key *key = _key;
+	struct lpm_stride_table *stride;
 
-	/* Start walking the trie from the root node ... */
+	/* Start walking the trie from the root node, or from where the
+	 * stride table says the walk would have gotten after the first
+	 * LPM_STRIDE_BITS bits of the key ...
+	 */
+	stride = rcu_dereference(trie->stride);
+	if (stride && key->prefixlen >= LPM_STRIDE_BITS) {
+		struct lpm_stride_entry *ent;
 
-	for (node = rcu_dereference(trie->root); node;) {
+		ent = &stride->entries[lpm_stride_index(key->data)];
+		node = ent->start;
+		found = ent->found;
+	} else {
+		node = rcu_dereference(trie->root);
+	}
+
+	for (; node;) {
 		unsigned int next_bit;
 		size_t matchlen;
 
@@ -296,6 +341,39 @@ static struct lpm_trie_node *lpm_trie_node_alloc(const struct lpm_trie *trie,
 	return node;
 }
 
+static bool trie_can_stride(const struct lpm_trie *trie)
+{
+	return trie->max_prefixlen > LPM_STRIDE_BITS &&
+	       trie->map.max_entries >= LPM_STRIDE_MIN_ENTRIES;
+}
+
+/* Must be called with trie->lock held before every change to the trie,
+ * and in particular before any node is queued for freeing: a lookup that
+ * finds the stride table must not be handed a node whose grace period has
+ * already started.
+ */
+static void lpm_stride_invalidate(struct lpm_trie *trie)
+{
+	struct lpm_stride_table *stride;
+
+	trie->gen++;
+	stride = rcu_dereference_protected(trie->stride,
+					   lockdep_is_held(&trie->lock));
+	if (stride) {
+		RCU_INIT_POINTER(trie->stride, NULL);
+		kvfree_rcu(stride, rcu);
+	}
+}
+
+/* Called with trie->lock held once the trie has been changed. The stride
+ * table is rebuilt a little later if the trie is still large enough.
+ */
+static void lpm_stride_queue_rebuild(struct lpm_trie *trie)
+{
+	if (trie_can_stride(trie) && trie->n_entries >= LPM_STRIDE_MIN_ENTRIES)
+		schedule_delayed_work(&trie->stride_work, LPM_STRIDE_DELAY);
+}
+
 /* Called from syscall or from eBPF program */
 static int trie_update_elem(struct bpf_map *map,
 			    void *_key, void *value, u64 flags)
@@ -330,6 +408,7 @@ static int trie_update_elem(struct bpf_map *map,
 		goto out;
 	}
 
+	lpm_stride_invalidate(trie);
 	trie->n_entries++;
 
 	new_node->prefixlen = key->prefixlen;
@@ -421,6 +500,9 @@ static int trie_update_elem(struct bpf_map *map,
 		kfree(new_node);
 		kfree(im_node);
 	}
+	/* The table was dropped above even if the update failed late */
+	if (new_node)
+		lpm_stride_queue_rebuild(trie);
 
 	spin_unlock_irqrestore(&trie->lock, irq_flags);
 
@@ -474,6 +556,7 @@ static int trie_delete_elem(struct bpf_map *map, void *_key)
 		goto out;
 	}
 
+	lpm_stride_invalidate(trie);
 	trie->n_entries--;
 
 	/* If the node we are removing has two children, simply mark it
@@ -518,11 +601,98 @@ static int trie_delete_elem(struct bpf_map *map, void *_key)
 	kfree_rcu(node, rcu);
 
 out:
+	if (!ret)
+		lpm_stride_queue_rebuild(trie);
 	spin_unlock_irqrestore(&trie->lock, irq_flags);
 
 	return ret;
 }
 
+/* Fill in the stride table entry for keys starting with the LPM_STRIDE_BITS
+ * bits in @idx. Nodes with a prefix shorter than that are matched and
+ * branched on with bits of @idx alone, so the walk through them is the same
+ * for all those keys and can be done up front.
+ */
+static void lpm_stride_fill(struct lpm_trie *trie,
+			    struct lpm_stride_entry *ent, u32 idx)
+{
+	struct lpm_trie_node *node, *found = NULL;
+	u8 data[2] = { idx >> 8, idx & 0xff };
+	u32 mask;
+
+	for (node = rcu_dereference(trie->root);
+	     node && node->prefixlen < LPM_STRIDE_BITS;) {
+		mask = ~(LPM_STRIDE_SIZE - 1) >> node->prefixlen;
+		if ((lpm_stride_index(node->data) ^ idx) & mask &
+		    (LPM_STRIDE_SIZE - 1)) {
+			node = NULL;
+			break;
+		}
+
+		if (!(node->flags & LPM_TREE_NODE_FLAG_IM))
+			found = node;
+
+		node = rcu_dereference(node->child[extract_bit(data,
+							       node->prefixlen)]);
+	}
+
+	ent->start = node;
+	ent->found = found;
+}
+
+/* Each lookup in a large trie chases a pointer per trie level, from the
+ * root on, and the top levels are the same for many keys. Once the trie has
+ * at least LPM_STRIDE_MIN_ENTRIES entries, a table with an entry for every
+ * possible value of the first LPM_STRIDE_BITS bits of the key records where
+ * the walk for those keys continues, and the best match found on the way
+ * there.
+ *
+ * The table is built here without holding trie->lock, which updates may
+ * change the trie under. It is only published if trie->gen shows that none
+ * did, and every change drops it again, so a table in use always matches
+ * the trie. A map which keeps being updated falls back to walking from the
+ * root, the table helps large maps which are mostly read.
+ */
+static void lpm_stride_rebuild(struct work_struct *work)
+{
+	struct lpm_trie *trie = container_of(to_delayed_work(work),
+					     struct lpm_trie, stride_work);
+	struct lpm_stride_table *stride;
+	unsigned long irq_flags;
+	u32 idx;
+	u64 gen;
+
+	stride = kvmalloc_node(sizeof(*stride), GFP_USER | __GFP_NOWARN,
+			       trie->map.numa_node);
+	if (!stride)
+		return;
+
+	spin_lock_irqsave(&trie->lock, irq_flags);
+	gen = trie->gen;
+	spin_unlock_irqrestore(&trie->lock, irq_flags);
+
+	for (idx = 0; idx < LPM_STRIDE_SIZE; idx++) {
+		if (idx % 4096 == 0) {
+			if (idx)
+				rcu_read_unlock();
+			cond_resched();
+			rcu_read_lock();
+		}
+		lpm_stride_fill(trie, &stride->entries[idx], idx);
+	}
+	rcu_read_unlock();
+
+	spin_lock_irqsave(&trie->lock, irq_flags);
+	if (trie->gen == gen && trie->n_entries >= LPM_STRIDE_MIN_ENTRIES) {
+		rcu_assign_pointer(trie->stride, stride);
+		stride = NULL;
+	}
+	spin_unlock_irqrestore(&trie->lock, irq_flags);
+
+	/* Changed in the meantime, which queued the work again */
+	kvfree(stride);
+}
+
 #define LPM_DATA_SIZE_MAX	256
 #define LPM_DATA_SIZE_MIN	1
 
@@ -570,12 +740,15 @@ static struct bpf_map *trie_alloc(union bpf_attr *attr)
 	cost_per_node = sizeof(struct lpm_trie_node) +
 			attr->value_size + trie->data_size;
 	cost += (u64) attr->max_entries * cost_per_node;
+	if (trie_can_stride(trie))
+		cost += sizeof(struct lpm_stride_table);
 
 	ret = bpf_map_charge_init(&trie->map.memory, cost);
 	if (ret)
 		goto out_err;
 
 	spin_lock_init(&trie->lock);
+	INIT_DELAYED_WORK(&trie->stride_work, lpm_stride_rebuild);
 
 	return &trie->map;
 out_err:
@@ -589,6 +762,9 @@ static void trie_free(struct bpf_map *map)
 	struct lpm_trie_node __rcu **slot;
 	struct lpm_trie_node *node;
 
+	cancel_delayed_work_sync(&trie->stride_work);
+	kvfree(rcu_dereference_protected(trie->stride, 1));
+
 	/* Always start at the root and walk down to a node that has no
 	 * children. Then free that node, nullify its reference in the parent
 	 * and start over.
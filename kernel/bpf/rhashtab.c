@@ -0,0 +1,385 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Resizable BPF hash map
+ *
+ * BPF_MAP_TYPE_HASH sizes its bucket array, and when preallocated its
+ * elements, for max_entries up front. BPF_MAP_TYPE_RHASH is backed by an
+ * rhashtable instead: the bucket array starts small, is grown and shrunk
+ * incrementally from a worker as elements come and go, and elements are
+ * allocated on update. Memory therefore tracks the number of elements
+ * actually in the map and max_entries is only an upper bound.
+ *
+ * Lookups walk the bucket chains under RCU, also while a resize is in
+ * progress. Updates and deletes take the per-bucket bit lock of the
+ * rhashtable, there is no map wide lock or freelist.
+ *
+ * Bucket locks are taken with bottom halves disabled, so unlike the
+ * preallocated hash map this map cannot be used from tracing programs,
+ * which can run in hard irq or NMI context.
+ */
+#include <linux/bpf.h>
+#include <linux/btf.h>
+#include <linux/err.h>
+#include <linux/rhashtable.h>
+#include <linux/slab.h>
+
+#define RHTAB_CREATE_FLAG_MASK \
+	(BPF_F_NUMA_NODE | BPF_F_ACCESS_MASK)
+
+struct bpf_rhtab {
+	struct bpf_map map;
+	struct rhashtable ht;
+	atomic_t count;	/* number of elements in this hashtable */
+	u32 elem_size;	/* size of each element in bytes */
+};
+
+/* each rhtab element is struct rhtab_elem + key + value */
+struct rhtab_elem {
+	struct rhash_head node;
+	struct rcu_head rcu;
+	char key[] __aligned(8);
+};
+
+static inline void *rhtab_elem_value(struct rhtab_elem *l, u32 key_size)
+{
+	return l->key + round_up(key_size, 8);
+}
+
+/* Called from syscall */
+static int rhtab_map_alloc_check(union bpf_attr *attr)
+{
+	if (!bpf_capable())
+		return -EPERM;
+
+	if (attr->map_flags & ~RHTAB_CREATE_FLAG_MASK ||
+	    !bpf_map_flags_access_ok(attr->map_flags))
+		return -EINVAL;
+
+	if (attr->max_entries == 0 || attr->key_size == 0 ||
+	    attr->value_size == 0)
+		return -EINVAL;
+
+	if (attr->key_size > MAX_BPF_STACK)
+		/* eBPF programs initialize keys on stack, so they cannot be
+		 * larger than max stack size
+		 */
+		return -E2BIG;
+
+	if (attr->value_size >= KMALLOC_MAX_SIZE -
+	    MAX_BPF_STACK - sizeof(struct rhtab_elem))
+		/* if value_size is bigger, the user space won't be able to
+		 * access the elements via bpf syscall.
+		 */
+		return -E2BIG;
+
+	return 0;
+}
+
+static struct bpf_map *rhtab_map_alloc(union bpf_attr *attr)
+{
+	struct rhashtable_params params = {
+		.head_offset = offsetof(struct rhtab_elem, node),
+		.key_offset = offsetof(struct rhtab_elem, key),
+		.key_len = attr->key_size,
+		.automatic_shrinking = true,
+	};
+	struct bpf_rhtab *rhtab;
+	u64 cost;
+	int err;
+
+	/* Never grow the bucket array past what BPF_MAP_TYPE_HASH would
+	 * allocate for the same max_entries.
+	 */
+	if (attr->max_entries > (1U << 31))
+		params.max_size = 1U << 31;
+	else
+		params.max_size = roundup_pow_of_two(attr->max_entries);
+
+	rhtab = kzalloc(sizeof(*rhtab), GFP_USER);
+	if (!rhtab)
+		return ERR_PTR(-ENOMEM);
+
+	bpf_map_init_from_attr(&rhtab->map, attr);
+
+	rhtab->elem_size = sizeof(struct rhtab_elem) +
+			   round_up(rhtab->map.key_size, 8) +
+			   round_up(rhtab->map.value_size, 8);
+
+	/* Charge for a full map, so that the memlock limit means the same
+	 * thing as for BPF_F_NO_PREALLOC hash maps.
+	 */
+	cost = (u64) params.max_size * sizeof(void *) +
+	       (u64) rhtab->elem_size * rhtab->map.max_entries;
+
+	err = bpf_map_charge_init(&rhtab->map.memory, cost);
+	if (err)
+		goto free_rhtab;
+
+	err = rhashtable_init(&rhtab->ht, &params);
+	if (err)
+		goto free_charge;
+
+	return &rhtab->map;
+
+free_charge:
+	bpf_map_charge_finish(&rhtab->map.memory);
+free_rhtab:
+	kfree(rhtab);
+	return ERR_PTR(err);
+}
+
+static void rhtab_free_elem(void *ptr, void *arg)
+{
+	kfree(ptr);
+}
+
+/* Called when map->refcnt goes to zero, either from workqueue or from syscall */
+static void rhtab_map_free(struct bpf_map *map)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+
+	/* No program uses the map any more and elements which were removed
+	 * earlier are freed by kfree_rcu(), which does not touch the map.
+	 */
+	rhashtable_free_and_destroy(&rhtab->ht, rhtab_free_elem, NULL);
+	kfree(rhtab);
+}
+
+static struct rhtab_elem *__rhtab_map_lookup_elem(struct bpf_rhtab *rhtab,
+						  void *key)
+{
+	/* The params are not compile time constants, so ht.p is what the
+	 * rhashtable helpers expect.
+	 */
+	return rhashtable_lookup(&rhtab->ht, key, rhtab->ht.p);
+}
+
+/* Called from syscall or from eBPF program */
+static void *rhtab_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	l = __rhtab_map_lookup_elem(rhtab, key);
+	if (l)
+		return rhtab_elem_value(l, map->key_size);
+
+	return NULL;
+}
+
+static struct rhtab_elem *rhtab_alloc_elem(struct bpf_rhtab *rhtab,
+					   void *key, void *value)
+{
+	u32 key_size = rhtab->map.key_size;
+	struct rhtab_elem *l;
+
+	l = kmalloc_node(rhtab->elem_size, GFP_ATOMIC | __GFP_NOWARN,
+			 rhtab->map.numa_node);
+	if (!l)
+		return NULL;
+
+	memcpy(l->key, key, key_size);
+	copy_map_value(&rhtab->map, rhtab_elem_value(l, key_size), value);
+	return l;
+}
+
+/* Called from syscall or from eBPF program */
+static int rhtab_map_update_elem(struct bpf_map *map, void *key, void *value,
+				 u64 map_flags)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l_new, *l_old;
+	int ret;
+
+	if (unlikely(map_flags > BPF_EXIST))
+		/* unknown flags */
+		return -EINVAL;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	l_new = rhtab_alloc_elem(rhtab, key, value);
+	if (!l_new)
+		return -ENOMEM;
+
+again:
+	l_old = __rhtab_map_lookup_elem(rhtab, key);
+	if (l_old) {
+		if (map_flags == BPF_NOEXIST) {
+			ret = -EEXIST;
+			goto free_new;
+		}
+
+		/* swap in the new element under the bucket lock, so that
+		 * concurrent lookups see either the old or the new value
+		 */
+		ret = rhashtable_replace_fast(&rhtab->ht, &l_old->node,
+					      &l_new->node, rhtab->ht.p);
+		if (ret == -ENOENT)
+			/* old element was deleted meanwhile */
+			goto again;
+		if (ret)
+			goto free_new;
+
+		kfree_rcu(l_old, rcu);
+		return 0;
+	}
+
+	if (map_flags == BPF_EXIST) {
+		ret = -ENOENT;
+		goto free_new;
+	}
+
+	if (atomic_inc_return(&rhtab->count) > map->max_entries) {
+		ret = -E2BIG;
+		goto dec_count;
+	}
+
+	l_old = rhashtable_lookup_get_insert_fast(&rhtab->ht, &l_new->node,
+						  rhtab->ht.p);
+	if (!l_old)
+		return 0;
+
+	atomic_dec(&rhtab->count);
+	if (IS_ERR(l_old)) {
+		ret = PTR_ERR(l_old);
+		goto free_new;
+	}
+	/* same key was inserted meanwhile, start over */
+	goto again;
+
+dec_count:
+	atomic_dec(&rhtab->count);
+free_new:
+	kfree(l_new);
+	return ret;
+}
+
+/* Called from syscall or from eBPF program */
+static int rhtab_map_delete_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	l = __rhtab_map_lookup_elem(rhtab, key);
+	if (!l)
+		return -ENOENT;
+
+	if (rhashtable_remove_fast(&rhtab->ht, &l->node, rhtab->ht.p))
+		/* deleted by someone else meanwhile */
+		return -ENOENT;
+
+	atomic_dec(&rhtab->count);
+	kfree_rcu(l, rcu);
+	return 0;
+}
+
+/* Called from syscall.
+ *
+ * Walks the bucket array like BPF_MAP_TYPE_HASH does, continuing into the
+ * table being resized to, if any. Elements are rehashed while a resize is
+ * in progress, so a walk that overlaps a resize can skip or repeat
+ * elements.
+ */
+static int rhtab_map_get_next_key(struct bpf_map *map, void *key,
+				  void *next_key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhashtable *ht = &rhtab->ht;
+	u32 key_size = map->key_size;
+	struct bucket_table *tbl;
+	struct rhash_head *he;
+	struct rhtab_elem *l;
+	unsigned int i = 0;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	tbl = rht_dereference_rcu(ht->tbl, ht);
+
+	if (!key)
+		goto find_first_elem;
+
+	/* lookup the key in whichever table it currently lives in */
+	for (; tbl; tbl = rht_dereference_rcu(tbl->future_tbl, ht)) {
+		i = rht_key_hashfn(ht, tbl, key, ht->p);
+		rht_for_each_entry_rcu(l, he, tbl, i, node) {
+			if (memcmp(l->key, key, key_size))
+				continue;
+
+			/* key was found, get next key in the same bucket */
+			he = rht_dereference_bucket_rcu(he->next, tbl, i);
+			if (!rht_is_a_nulls(he)) {
+				l = rht_obj(ht, he);
+				memcpy(next_key, l->key, key_size);
+				return 0;
+			}
+
+			/* no more elements in this bucket, go to the next one */
+			i++;
+			goto find_first_elem;
+		}
+	}
+
+	/* key was not found, start over */
+	tbl = rht_dereference_rcu(ht->tbl, ht);
+	i = 0;
+
+find_first_elem:
+	/* iterate over buckets */
+	for (; tbl; tbl = rht_dereference_rcu(tbl->future_tbl, ht), i = 0) {
+		for (; i < tbl->size; i++) {
+			/* pick first element in the bucket */
+			he = rht_ptr_rcu(rht_bucket(tbl, i));
+			if (!rht_is_a_nulls(he)) {
+				l = rht_obj(ht, he);
+				memcpy(next_key, l->key, key_size);
+				return 0;
+			}
+		}
+	}
+
+	/* iterated over all buckets and all elements */
+	return -ENOENT;
+}
+
+static void rhtab_map_seq_show_elem(struct bpf_map *map, void *key,
+				    struct seq_file *m)
+{
+	void *value;
+
+	rcu_read_lock();
+
+	value = rhtab_map_lookup_elem(map, key);
+	if (!value) {
+		rcu_read_unlock();
+		return;
+	}
+
+	btf_type_seq_show(map->btf, map->btf_key_type_id, key, m);
+	seq_puts(m, ": ");
+	btf_type_seq_show(map->btf, map->btf_value_type_id, value, m);
+	seq_puts(m, "\n");
+
+	rcu_read_unlock();
+}
+
+static int rhtab_map_btf_id;
+const struct bpf_map_ops rhtab_map_ops = {
+	.map_meta_equal = bpf_map_meta_equal,
+	.map_alloc_check = rhtab_map_alloc_check,
+	.map_alloc = rhtab_map_alloc,
+	.map_free = rhtab_map_free,
+	.map_get_next_key = rhtab_map_get_next_key,
+	.map_lookup_elem = rhtab_map_lookup_elem,
+	.map_update_elem = rhtab_map_update_elem,
+	.map_delete_elem = rhtab_map_delete_elem,
+	.map_seq_show_elem = rhtab_map_seq_show_elem,
+	.map_lookup_batch = generic_map_lookup_batch,
+	.map_update_batch = generic_map_update_batch,
+	.map_delete_batch = generic_map_delete_batch,
+	.map_btf_name = "bpf_rhtab",
+	.map_btf_id = &rhtab_map_btf_id,
+};
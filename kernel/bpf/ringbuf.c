@@ -29,13 +29,28 @@
 #define RINGBUF_MAX_DATA_SZ \
 	(((1ULL << 24) - RINGBUF_POS_PAGES - RINGBUF_PGOFF) * PAGE_SIZE)
 
+#ifdef CONFIG_64BIT
+/* Producers reserve space without a lock, see bpf_ringbuf_claim(). The
+ * position of the next record lives in the low RINGBUF_POS_BITS of
+ * rb->pending, the number of producers which claimed space but haven't
+ * written their record header yet in the bits above.
+ */
+#define RINGBUF_POS_BITS	52
+#define RINGBUF_POS_MASK	((1UL << RINGBUF_POS_BITS) - 1)
+#define RINGBUF_PENDING_ONE	(1UL << RINGBUF_POS_BITS)
+#endif
+
 struct bpf_ringbuf {
 	wait_queue_head_t waitq;
 	struct irq_work work;
 	u64 mask;
 	struct page **pages;
 	int nr_pages;
+#ifdef CONFIG_64BIT
+	atomic_long_t pending ____cacheline_aligned_in_smp;
+#else
 	spinlock_t spinlock ____cacheline_aligned_in_smp;
+#endif
 	/* Consumer and producer counters are put into separate pages to allow
 	 * mapping consumer page as r/w, but restrict producer page to r/o.
 	 * This protects producer position from being modified by user-space
@@ -136,7 +151,11 @@ static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node)
 	if (!rb)
 		return ERR_PTR(-ENOMEM);
 
+#ifdef CONFIG_64BIT
+	atomic_long_set(&rb->pending, 0);
+#else
 	spin_lock_init(&rb->spinlock);
+#endif
 	init_waitqueue_head(&rb->waitq);
 	init_irq_work(&rb->work, bpf_ringbuf_notify);
 
@@ -324,45 +343,135 @@ bpf_ringbuf_restore_from_rec(struct bpf_ringbuf_hdr *hdr)
 	return (void*)((addr & PAGE_MASK) - off);
 }
 
-static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
+#ifdef CONFIG_64BIT
+/* Claim len bytes at the producer end of the ring buffer, returning their
+ * position in *prod_pos. The consumer must not see producer_pos move past
+ * the claimed space before its record header is written, which the caller
+ * does before calling bpf_ringbuf_publish().
+ *
+ * Claims are made with a cmpxchg on rb->pending, which also counts the
+ * producers in between the two calls. The one which brings that count back
+ * to zero publishes all space claimed up to that point. Producers thus never
+ * wait for each other, neither on other CPUs nor when nested in NMI, and
+ * producer_pos only lags behind while some other producer is writing its
+ * header.
+ */
+static bool bpf_ringbuf_claim(struct bpf_ringbuf *rb, unsigned long cons_pos,
+			      u32 len, unsigned long *prod_pos,
+			      unsigned long *flags)
 {
-	unsigned long cons_pos, prod_pos, new_prod_pos, flags;
-	u32 len, pg_off;
-	struct bpf_ringbuf_hdr *hdr;
+	long old, new;
+
+	BUILD_BUG_ON(RINGBUF_MAX_DATA_SZ >= RINGBUF_POS_MASK / 2);
+
+	preempt_disable();
+	old = atomic_long_read(&rb->pending);
+	do {
+		/* check for out of ringbuf space by ensuring producer position
+		 * doesn't advance more than (ringbuf_size - 1) ahead
+		 */
+		if (((old + len - cons_pos) & RINGBUF_POS_MASK) > rb->mask ||
+		    (old & ~RINGBUF_POS_MASK) == ~RINGBUF_POS_MASK) {
+			preempt_enable();
+			return false;
+		}
+		new = ((old + len) & RINGBUF_POS_MASK) +
+		      (old & ~RINGBUF_POS_MASK) + RINGBUF_PENDING_ONE;
+	} while (!atomic_long_try_cmpxchg(&rb->pending, &old, new));
 
-	if (unlikely(size > RINGBUF_MAX_RECORD_SZ))
-		return NULL;
+	*prod_pos = old & RINGBUF_POS_MASK;
+	return true;
+}
 
-	len = round_up(size + BPF_RINGBUF_HDR_SZ, 8);
-	cons_pos = smp_load_acquire(&rb->consumer_pos);
+static void bpf_ringbuf_publish(struct bpf_ringbuf *rb, unsigned long prod_pos,
+			       u32 len, unsigned long flags)
+{
+	unsigned long pending, pos, prev, delta;
 
+	/* fully ordered, so our record header is written before whoever
+	 * sees the count drop to zero moves producer_pos past it
+	 */
+	pending = atomic_long_sub_return(RINGBUF_PENDING_ONE, &rb->pending);
+	if (pending & ~RINGBUF_POS_MASK)
+		goto out;
+
+	pos = READ_ONCE(rb->producer_pos);
+	for (;;) {
+		delta = (pending - pos) & RINGBUF_POS_MASK;
+		/* another producer already published past that */
+		if (!delta || delta > RINGBUF_POS_MASK / 2)
+			goto out;
+		/* pairs with consumer's smp_load_acquire() */
+		prev = cmpxchg_release(&rb->producer_pos, pos, pos + delta);
+		if (prev == pos)
+			break;
+		pos = prev;
+	}
+
+	/* Records of other producers became visible along with ours. They
+	 * may have been committed already, with the consumer woken up while
+	 * it couldn't see them yet, so wake it up again.
+	 */
+	if (pos != prod_pos && smp_load_acquire(&rb->consumer_pos) == pos)
+		irq_work_queue(&rb->work);
+out:
+	preempt_enable();
+}
+#else
+static bool bpf_ringbuf_claim(struct bpf_ringbuf *rb, unsigned long cons_pos,
+			      u32 len, unsigned long *prod_pos,
+			      unsigned long *flags)
+{
 	if (in_nmi()) {
-		if (!spin_trylock_irqsave(&rb->spinlock, flags))
-			return NULL;
+		if (!spin_trylock_irqsave(&rb->spinlock, *flags))
+			return false;
 	} else {
-		spin_lock_irqsave(&rb->spinlock, flags);
+		spin_lock_irqsave(&rb->spinlock, *flags);
 	}
 
-	prod_pos = rb->producer_pos;
-	new_prod_pos = prod_pos + len;
-
 	/* check for out of ringbuf space by ensuring producer position
 	 * doesn't advance more than (ringbuf_size - 1) ahead
 	 */
-	if (new_prod_pos - cons_pos > rb->mask) {
-		spin_unlock_irqrestore(&rb->spinlock, flags);
-		return NULL;
+	if (rb->producer_pos + len - cons_pos > rb->mask) {
+		spin_unlock_irqrestore(&rb->spinlock, *flags);
+		return false;
 	}
 
+	*prod_pos = rb->producer_pos;
+	return true;
+}
+
+static void bpf_ringbuf_publish(struct bpf_ringbuf *rb, unsigned long prod_pos,
+			       u32 len, unsigned long flags)
+{
+	/* pairs with consumer's smp_load_acquire() */
+	smp_store_release(&rb->producer_pos, prod_pos + len);
+
+	spin_unlock_irqrestore(&rb->spinlock, flags);
+}
+#endif
+
+static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
+{
+	unsigned long cons_pos, prod_pos, flags = 0;
+	u32 len, pg_off;
+	struct bpf_ringbuf_hdr *hdr;
+
+	if (unlikely(size > RINGBUF_MAX_RECORD_SZ))
+		return NULL;
+
+	len = round_up(size + BPF_RINGBUF_HDR_SZ, 8);
+	cons_pos = smp_load_acquire(&rb->consumer_pos);
+
+	if (!bpf_ringbuf_claim(rb, cons_pos, len, &prod_pos, &flags))
+		return NULL;
+
 	hdr = (void *)rb->data + (prod_pos & rb->mask);
 	pg_off = bpf_ringbuf_rec_pg_off(rb, hdr);
 	hdr->len = size | BPF_RINGBUF_BUSY_BIT;
 	hdr->pg_off = pg_off;
 
-	/* pairs with consumer's smp_load_acquire() */
-	smp_store_release(&rb->producer_pos, new_prod_pos);
-
-	spin_unlock_irqrestore(&rb->spinlock, flags);
+	bpf_ringbuf_publish(rb, prod_pos, len, flags);
 
 	return (void *)hdr + BPF_RINGBUF_HDR_SZ;
 }
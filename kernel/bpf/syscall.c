@@ -31,6 +31,7 @@
 #include <linux/poll.h>
 #include <linux/bpf-netns.h>
 #include <linux/rcupdate_trace.h>
+#include <linux/sort.h>
 
 #define IS_FD_ARRAY(map) ((map)->map_type == BPF_MAP_TYPE_PERF_EVENT_ARRAY || \
 			  (map)->map_type == BPF_MAP_TYPE_CGROUP_ARRAY || \
@@ -194,7 +195,8 @@ static int bpf_map_update_value(struct bpf_map *map, struct fd f, void *key,
 		err = bpf_fd_reuseport_array_update_elem(map, key, value,
 							 flags);
 	} else if (map->map_type == BPF_MAP_TYPE_QUEUE ||
-		   map->map_type == BPF_MAP_TYPE_STACK) {
+		   map->map_type == BPF_MAP_TYPE_STACK ||
+		   map->map_type == BPF_MAP_TYPE_BLOOM_FILTER) {
 		err = map->ops->map_push_elem(map, value, flags);
 	} else {
 		rcu_read_lock();
@@ -233,7 +235,8 @@ static int bpf_map_copy_value(struct bpf_map *map, void *key, void *value,
 	} else if (map->map_type == BPF_MAP_TYPE_REUSEPORT_SOCKARRAY) {
 		err = bpf_fd_reuseport_array_lookup_elem(map, key, value);
 	} else if (map->map_type == BPF_MAP_TYPE_QUEUE ||
-		   map->map_type == BPF_MAP_TYPE_STACK) {
+		   map->map_type == BPF_MAP_TYPE_STACK ||
+		   map->map_type == BPF_MAP_TYPE_BLOOM_FILTER) {
 		err = map->ops->map_peek_elem(map, value);
 	} else if (map->map_type == BPF_MAP_TYPE_STRUCT_OPS) {
 		/* struct_ops map requires directly updating "value" */
@@ -337,6 +340,7 @@ void bpf_map_init_from_attr(struct bpf_map *map, union bpf_attr *attr)
 	map->key_size = attr->key_size;
 	map->value_size = attr->value_size;
 	map->max_entries = attr->max_entries;
+	map->map_extra = attr->map_extra;
 	map->map_flags = bpf_map_flags_retain_permanent(attr->map_flags);
 	map->numa_node = bpf_map_attr_numa_node(attr);
 }
@@ -545,6 +549,7 @@ static void bpf_map_show_fdinfo(struct seq_file *m, struct file *filp)
 		   "value_size:\t%u\n"
 		   "max_entries:\t%u\n"
 		   "map_flags:\t%#x\n"
+		   "map_extra:\t%#llx\n"
 		   "memlock:\t%llu\n"
 		   "map_id:\t%u\n"
 		   "frozen:\t%u\n",
@@ -553,6 +558,7 @@ static void bpf_map_show_fdinfo(struct seq_file *m, struct file *filp)
 		   map->value_size,
 		   map->max_entries,
 		   map->map_flags,
+		   (unsigned long long)map->map_extra,
 		   map->memory.pages * 1ULL << PAGE_SHIFT,
 		   map->id,
 		   READ_ONCE(map->frozen));
@@ -773,7 +779,8 @@ static int map_check_btf(struct bpf_map *map, const struct btf *btf,
 		    map->map_type != BPF_MAP_TYPE_ARRAY &&
 		    map->map_type != BPF_MAP_TYPE_CGROUP_STORAGE &&
 		    map->map_type != BPF_MAP_TYPE_SK_STORAGE &&
-		    map->map_type != BPF_MAP_TYPE_INODE_STORAGE)
+		    map->map_type != BPF_MAP_TYPE_INODE_STORAGE &&
+		    map->map_type != BPF_MAP_TYPE_TASK_STORAGE)
 			return -ENOTSUPP;
 		if (map->spin_lock_off + sizeof(struct bpf_spin_lock) >
 		    map->value_size) {
@@ -790,7 +797,7 @@ static int map_check_btf(struct bpf_map *map, const struct btf *btf,
 	return ret;
 }
 
-#define BPF_MAP_CREATE_LAST_FIELD btf_vmlinux_value_type_id
+#define BPF_MAP_CREATE_LAST_FIELD map_extra
 /* called via syscall */
 static int map_create(union bpf_attr *attr)
 {
@@ -804,6 +811,10 @@ static int map_create(union bpf_attr *attr)
 	if (err)
 		return -EINVAL;
 
+	if (attr->map_type != BPF_MAP_TYPE_BLOOM_FILTER &&
+	    attr->map_extra != 0)
+		return -EINVAL;
+
 	if (attr->btf_vmlinux_value_type_id) {
 		if (attr->map_type != BPF_MAP_TYPE_STRUCT_OPS ||
 		    attr->btf_key_type_id || attr->btf_value_type_id)
@@ -1044,6 +1055,15 @@ static int map_lookup_elem(union bpf_attr *attr)
 	if (!value)
 		goto free_key;
 
+	if (map->map_type == BPF_MAP_TYPE_BLOOM_FILTER) {
+		/* The value to test for is passed in, nothing is returned */
+		if (copy_from_user(value, uvalue, value_size))
+			err = -EFAULT;
+		else
+			err = bpf_map_copy_value(map, key, value, attr->flags);
+		goto free_value;
+	}
+
 	err = bpf_map_copy_value(map, key, value, attr->flags);
 	if (err)
 		goto free_value;
@@ -1808,14 +1828,22 @@ static void bpf_prog_show_fdinfo(struct seq_file *m, struct file *filp)
 		   "memlock:\t%llu\n"
 		   "prog_id:\t%u\n"
 		   "run_time_ns:\t%llu\n"
-		   "run_cnt:\t%llu\n",
+		   "run_cnt:\t%llu\n"
+		   "verified_insns:\t%u\n"
+		   "verified_states:\t%u\n"
+		   "verified_peak_states:\t%u\n"
+		   "verified_pruned_states:\t%u\n",
 		   prog->type,
 		   prog->jited,
 		   prog_tag,
 		   prog->pages * 1ULL << PAGE_SHIFT,
 		   prog->aux->id,
 		   stats.nsecs,
-		   stats.cnt);
+		   stats.cnt,
+		   prog->aux->verified_insns,
+		   prog->aux->verified_states,
+		   prog->aux->verified_peak_states,
+		   prog->aux->verified_pruned_states);
 }
 #endif
 
@@ -2720,6 +2748,190 @@ static int bpf_tracing_prog_attach(struct bpf_prog *prog,
 	return err;
 }
 
+/* vmlinux has ~22k functions fentry/fexit progs can attach to */
+#define BPF_TRACING_MULTI_MAX_CNT	(1U << 15)
+
+struct bpf_tracing_multi_link {
+	struct bpf_link link;
+	enum bpf_attach_type attach_type;
+	u32 cnt;
+	struct bpf_trampoline **trampolines;
+	struct bpf_tramp_node *nodes;
+};
+
+static void bpf_tracing_multi_link_release(struct bpf_link *link)
+{
+	struct bpf_tracing_multi_link *tr_link =
+		container_of(link, struct bpf_tracing_multi_link, link);
+	u32 i;
+
+	bpf_trampoline_unlink_prog_multi(link->prog, tr_link->trampolines,
+					 tr_link->nodes, tr_link->cnt);
+
+	for (i = 0; i < tr_link->cnt; i++)
+		bpf_trampoline_put(tr_link->trampolines[i]);
+}
+
+static void bpf_tracing_multi_link_dealloc(struct bpf_link *link)
+{
+	struct bpf_tracing_multi_link *tr_link =
+		container_of(link, struct bpf_tracing_multi_link, link);
+
+	kvfree(tr_link->nodes);
+	kvfree(tr_link->trampolines);
+	kfree(tr_link);
+}
+
+static void bpf_tracing_multi_link_show_fdinfo(const struct bpf_link *link,
+					       struct seq_file *seq)
+{
+	struct bpf_tracing_multi_link *tr_link =
+		container_of(link, struct bpf_tracing_multi_link, link);
+
+	seq_printf(seq,
+		   "attach_type:\t%d\n"
+		   "target_cnt:\t%u\n",
+		   tr_link->attach_type,
+		   tr_link->cnt);
+}
+
+static int bpf_tracing_multi_link_fill_link_info(const struct bpf_link *link,
+						 struct bpf_link_info *info)
+{
+	struct bpf_tracing_multi_link *tr_link =
+		container_of(link, struct bpf_tracing_multi_link, link);
+
+	info->tracing.attach_type = tr_link->attach_type;
+
+	return 0;
+}
+
+static const struct bpf_link_ops bpf_tracing_multi_link_lops = {
+	.release = bpf_tracing_multi_link_release,
+	.dealloc = bpf_tracing_multi_link_dealloc,
+	.show_fdinfo = bpf_tracing_multi_link_show_fdinfo,
+	.fill_link_info = bpf_tracing_multi_link_fill_link_info,
+};
+
+static int btf_id_cmp(const void *a, const void *b)
+{
+	u32 id_a = *(const u32 *)a, id_b = *(const u32 *)b;
+
+	return id_a < id_b ? -1 : id_a > id_b;
+}
+
+/* Attach one fentry/fexit/fmod_ret prog to many kernel functions with a
+ * single link. The prog was verified against the prototype of the function
+ * it was loaded for, so all targets must have that same prototype. BTF
+ * dedup leaves one FUNC_PROTO per distinct prototype, which makes that a
+ * pointer compare.
+ */
+static int bpf_tracing_multi_attach(struct bpf_prog *prog,
+				    const union bpf_attr *attr)
+{
+	u32 cnt = attr->link_create.tracing_multi.btf_ids_cnt;
+	struct bpf_tracing_multi_link *link = NULL;
+	struct bpf_link_primer link_primer;
+	struct bpf_tramp_node *nodes = NULL;
+	struct bpf_trampoline **trs = NULL;
+	void __user *ubtf_ids;
+	u32 *btf_ids = NULL;
+	u32 i, nr_trs = 0;
+	int err;
+
+	if (prog->expected_attach_type != BPF_TRACE_FENTRY &&
+	    prog->expected_attach_type != BPF_TRACE_FEXIT &&
+	    prog->expected_attach_type != BPF_MODIFY_RETURN)
+		return -EINVAL;
+	/* only kernel functions can be targets */
+	if (attr->link_create.target_fd || attr->link_create.flags)
+		return -EINVAL;
+	if (cnt > BPF_TRACING_MULTI_MAX_CNT)
+		return -E2BIG;
+
+	ubtf_ids = u64_to_user_ptr(attr->link_create.tracing_multi.btf_ids);
+	btf_ids = kvmalloc_array(cnt, sizeof(*btf_ids), GFP_USER);
+	trs = kvcalloc(cnt, sizeof(*trs), GFP_USER);
+	nodes = kvcalloc(cnt, sizeof(*nodes), GFP_USER);
+	if (!btf_ids || !trs || !nodes) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+	if (copy_from_user(btf_ids, ubtf_ids, cnt * sizeof(*btf_ids))) {
+		err = -EFAULT;
+		goto out_free;
+	}
+
+	/* sorted to catch duplicates, and so that concurrent links lock the
+	 * trampolines they share in the same order
+	 */
+	sort(btf_ids, cnt, sizeof(*btf_ids), btf_id_cmp, NULL);
+	for (i = 1; i < cnt; i++) {
+		if (btf_ids[i] == btf_ids[i - 1]) {
+			err = -EINVAL;
+			goto out_free;
+		}
+	}
+
+	for (i = 0; i < cnt; i++) {
+		struct bpf_attach_target_info tgt_info = {};
+
+		err = bpf_check_attach_target(NULL, prog, NULL, btf_ids[i],
+					      &tgt_info);
+		if (err)
+			goto out_put;
+		if (tgt_info.tgt_type != prog->aux->attach_func_proto) {
+			err = -EINVAL;
+			goto out_put;
+		}
+
+		trs[i] = bpf_trampoline_get(bpf_trampoline_compute_key(NULL, btf_ids[i]),
+					    &tgt_info);
+		if (!trs[i]) {
+			err = -ENOMEM;
+			goto out_put;
+		}
+		nr_trs++;
+		cond_resched();
+	}
+
+	link = kzalloc(sizeof(*link), GFP_USER);
+	if (!link) {
+		err = -ENOMEM;
+		goto out_put;
+	}
+	bpf_link_init(&link->link, BPF_LINK_TYPE_TRACING,
+		      &bpf_tracing_multi_link_lops, prog);
+	link->attach_type = prog->expected_attach_type;
+
+	err = bpf_link_prime(&link->link, &link_primer);
+	if (err)
+		goto out_put;
+
+	err = bpf_trampoline_link_prog_multi(prog, trs, nodes, cnt);
+	if (err) {
+		bpf_link_cleanup(&link_primer);
+		link = NULL;
+		goto out_put;
+	}
+
+	link->cnt = cnt;
+	link->trampolines = trs;
+	link->nodes = nodes;
+	kvfree(btf_ids);
+
+	return bpf_link_settle(&link_primer);
+out_put:
+	for (i = 0; i < nr_trs; i++)
+		bpf_trampoline_put(trs[i]);
+	kfree(link);
+out_free:
+	kvfree(nodes);
+	kvfree(trs);
+	kvfree(btf_ids);
+	return err;
+}
+
 struct bpf_raw_tp_link {
 	struct bpf_link link;
 	struct bpf_raw_event_map *btp;
@@ -2952,6 +3164,9 @@ attach_type_to_prog_type(enum bpf_attach_type attach_type)
 	case BPF_CGROUP_SETSOCKOPT:
 		return BPF_PROG_TYPE_CGROUP_SOCKOPT;
 	case BPF_TRACE_ITER:
+	case BPF_TRACE_FENTRY:
+	case BPF_TRACE_FEXIT:
+	case BPF_MODIFY_RETURN:
 		return BPF_PROG_TYPE_TRACING;
 	case BPF_SK_LOOKUP:
 		return BPF_PROG_TYPE_SK_LOOKUP;
@@ -3443,6 +3658,11 @@ static int bpf_prog_get_info_by_fd(struct file *file,
 	bpf_prog_get_stats(prog, &stats);
 	info.run_time_ns = stats.nsecs;
 	info.run_cnt = stats.cnt;
+	/* Recursion misses are not counted yet, the field only keeps the
+	 * layout of upstream's bpf_prog_info.
+	 */
+	info.recursion_misses = 0;
+	info.verified_insns = prog->aux->verified_insns;
 
 	if (!bpf_capable()) {
 		info.jited_prog_len = 0;
@@ -3690,6 +3910,7 @@ static int bpf_map_get_info_by_fd(struct file *file,
 	info.value_size = map->value_size;
 	info.max_entries = map->max_entries;
 	info.map_flags = map->map_flags;
+	info.map_extra = map->map_extra;
 	memcpy(info.name, map->name, sizeof(map->name));
 
 	if (map->btf) {
@@ -4024,6 +4245,8 @@ static int tracing_bpf_link_attach(const union bpf_attr *attr, struct bpf_prog *
 		return bpf_tracing_prog_attach(prog,
 					       attr->link_create.target_fd,
 					       attr->link_create.target_btf_id);
+	else if (attr->link_create.tracing_multi.btf_ids_cnt)
+		return bpf_tracing_multi_attach(prog, attr);
 	return -EINVAL;
 }
 
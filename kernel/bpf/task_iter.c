@@ -6,6 +6,8 @@
 #include <linux/pid_namespace.h>
 #include <linux/fs.h>
 #include <linux/fdtable.h>
+#include <linux/mm.h>
+#include <linux/sched/mm.h>
 #include <linux/filter.h>
 #include <linux/btf_ids.h>
 
@@ -305,9 +307,190 @@ static const struct seq_operations task_file_seq_ops = {
 	.show	= task_file_seq_show,
 };
 
+struct bpf_iter_seq_task_vma_info {
+	/* The first field must be struct bpf_iter_seq_task_common.
+	 * this is assumed by {init, fini}_seq_pidns() callback functions.
+	 */
+	struct bpf_iter_seq_task_common common;
+	struct task_struct *task;
+	struct mm_struct *mm;
+	u32 tid;
+	/* The next vma shown is the first one ending above addr */
+	unsigned long addr;
+};
+
+static struct vm_area_struct *
+task_vma_seq_get_next(struct bpf_iter_seq_task_vma_info *info)
+{
+	struct pid_namespace *ns = info->common.ns;
+	struct vm_area_struct *vma;
+	u32 curr_tid;
+
+	/* If this function returns a non-NULL vma, it holds a reference to
+	 * the task and its mm, and the mmap_lock for reading. Otherwise it
+	 * holds none of them.
+	 */
+again:
+	if (!info->task) {
+		curr_tid = info->tid;
+		info->task = task_seq_get_next(ns, &curr_tid, false);
+		if (!info->task) {
+			info->tid = curr_tid;
+			return NULL;
+		}
+
+		if (curr_tid != info->tid) {
+			info->tid = curr_tid;
+			info->addr = 0;
+		}
+
+		/* Threads share the mm of their group leader */
+		if (thread_group_leader(info->task))
+			info->mm = get_task_mm(info->task);
+		if (!info->mm) {
+			put_task_struct(info->task);
+			info->task = NULL;
+			info->tid++;
+			info->addr = 0;
+			goto again;
+		}
+		mmap_read_lock(info->mm);
+	}
+
+	vma = find_vma(info->mm, info->addr);
+	if (vma)
+		return vma;
+
+	/* the current task is done, go to the next task */
+	mmap_read_unlock(info->mm);
+	mmput(info->mm);
+	put_task_struct(info->task);
+	info->mm = NULL;
+	info->task = NULL;
+	info->tid++;
+	info->addr = 0;
+	goto again;
+}
+
+static void *task_vma_seq_start(struct seq_file *seq, loff_t *pos)
+{
+	struct bpf_iter_seq_task_vma_info *info = seq->private;
+	struct vm_area_struct *vma;
+
+	info->task = NULL;
+	info->mm = NULL;
+	vma = task_vma_seq_get_next(info);
+	if (vma && *pos == 0)
+		++*pos;
+
+	return vma;
+}
+
+static void *task_vma_seq_next(struct seq_file *seq, void *v, loff_t *pos)
+{
+	struct bpf_iter_seq_task_vma_info *info = seq->private;
+	struct vm_area_struct *vma = v;
+
+	++*pos;
+	info->addr = vma->vm_end;
+
+	/* Do not hold off writers or other tasks for the whole walk of a
+	 * large address space. vma is not looked at once the lock is
+	 * dropped; the walk picks up again from info->addr.
+	 */
+	if (mmap_lock_is_contended(info->mm) || need_resched()) {
+		mmap_read_unlock(info->mm);
+		cond_resched();
+		mmap_read_lock(info->mm);
+	}
+
+	return task_vma_seq_get_next(info);
+}
+
+struct bpf_iter__task_vma {
+	__bpf_md_ptr(struct bpf_iter_meta *, meta);
+	__bpf_md_ptr(struct task_struct *, task);
+	__bpf_md_ptr(struct vm_area_struct *, vma);
+};
+
+DEFINE_BPF_ITER_FUNC(task_vma, struct bpf_iter_meta *meta,
+		     struct task_struct *task, struct vm_area_struct *vma)
+
+static int __task_vma_seq_show(struct seq_file *seq,
+			       struct vm_area_struct *vma, bool in_stop)
+{
+	struct bpf_iter_seq_task_vma_info *info = seq->private;
+	struct bpf_iter__task_vma ctx;
+	struct bpf_iter_meta meta;
+	struct bpf_prog *prog;
+
+	meta.seq = seq;
+	prog = bpf_iter_get_info(&meta, in_stop);
+	if (!prog)
+		return 0;
+
+	ctx.meta = &meta;
+	ctx.task = info->task;
+	ctx.vma = vma;
+	return bpf_iter_run_prog(prog, &ctx);
+}
+
+static int task_vma_seq_show(struct seq_file *seq, void *v)
+{
+	return __task_vma_seq_show(seq, v, false);
+}
+
+static void task_vma_seq_stop(struct seq_file *seq, void *v)
+{
+	struct bpf_iter_seq_task_vma_info *info = seq->private;
+
+	if (!v) {
+		(void)__task_vma_seq_show(seq, v, true);
+	} else {
+		mmap_read_unlock(info->mm);
+		mmput(info->mm);
+		put_task_struct(info->task);
+		info->mm = NULL;
+		info->task = NULL;
+	}
+}
+
+static int bpf_iter_attach_task_vma(struct bpf_prog *prog,
+				    union bpf_iter_link_info *linfo,
+				    struct bpf_iter_aux_info *aux)
+{
+	aux->task_vma.tid = linfo->task_vma.tid;
+	aux->task_vma.addr = linfo->task_vma.addr;
+	return 0;
+}
+
+static void bpf_iter_task_vma_show_fdinfo(const struct bpf_iter_aux_info *aux,
+					  struct seq_file *seq)
+{
+	seq_printf(seq, "tid:\t%u\n", aux->task_vma.tid);
+	seq_printf(seq, "addr:\t0x%llx\n", aux->task_vma.addr);
+}
+
+static int init_seq_task_vma(void *priv_data, struct bpf_iter_aux_info *aux)
+{
+	struct bpf_iter_seq_task_vma_info *info = priv_data;
+
+	info->tid = aux->task_vma.tid;
+	info->addr = aux->task_vma.addr;
+	return init_seq_pidns(priv_data, aux);
+}
+
+static const struct seq_operations task_vma_seq_ops = {
+	.start	= task_vma_seq_start,
+	.next	= task_vma_seq_next,
+	.stop	= task_vma_seq_stop,
+	.show	= task_vma_seq_show,
+};
+
 BTF_ID_LIST(btf_task_file_ids)
 BTF_ID(struct, task_struct)
 BTF_ID(struct, file)
+BTF_ID(struct, vm_area_struct)
 
 static const struct bpf_iter_seq_info task_seq_info = {
 	.seq_ops		= &task_seq_ops,
@@ -345,6 +528,27 @@ static struct bpf_iter_reg task_file_reg_info = {
 	.seq_info		= &task_file_seq_info,
 };
 
+static const struct bpf_iter_seq_info task_vma_seq_info = {
+	.seq_ops		= &task_vma_seq_ops,
+	.init_seq_private	= init_seq_task_vma,
+	.fini_seq_private	= fini_seq_pidns,
+	.seq_priv_size		= sizeof(struct bpf_iter_seq_task_vma_info),
+};
+
+static struct bpf_iter_reg task_vma_reg_info = {
+	.target			= "task_vma",
+	.attach_target		= bpf_iter_attach_task_vma,
+	.show_fdinfo		= bpf_iter_task_vma_show_fdinfo,
+	.ctx_arg_info_size	= 2,
+	.ctx_arg_info		= {
+		{ offsetof(struct bpf_iter__task_vma, task),
+		  PTR_TO_BTF_ID_OR_NULL },
+		{ offsetof(struct bpf_iter__task_vma, vma),
+		  PTR_TO_BTF_ID_OR_NULL },
+	},
+	.seq_info		= &task_vma_seq_info,
+};
+
 static int __init task_iter_init(void)
 {
 	int ret;
@@ -356,6 +560,12 @@ static int __init task_iter_init(void)
 
 	task_file_reg_info.ctx_arg_info[0].btf_id = btf_task_file_ids[0];
 	task_file_reg_info.ctx_arg_info[1].btf_id = btf_task_file_ids[1];
-	return bpf_iter_reg_target(&task_file_reg_info);
+	ret = bpf_iter_reg_target(&task_file_reg_info);
+	if (ret)
+		return ret;
+
+	task_vma_reg_info.ctx_arg_info[0].btf_id = btf_task_file_ids[0];
+	task_vma_reg_info.ctx_arg_info[1].btf_id = btf_task_file_ids[2];
+	return bpf_iter_reg_target(&task_vma_reg_info);
 }
 late_initcall(task_iter_init);
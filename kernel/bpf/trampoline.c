@@ -25,6 +25,12 @@ static struct hlist_head trampoline_table[TRAMPOLINE_TABLE_SIZE];
 /* serializes access to trampoline_table */
 static DEFINE_MUTEX(trampoline_mutex);
 
+/* serializes the multi target links. Each of them locks one trampoline at
+ * a time and marks the ones it registers with ftrace in a batch as
+ * multi_pending until the batch is done.
+ */
+static DEFINE_MUTEX(trampoline_multi_mutex);
+
 void *bpf_jit_alloc_exec_page(void)
 {
 	void *image;
@@ -144,7 +150,7 @@ static int register_fentry(struct bpf_trampoline *tr, void *new_addr)
 static struct bpf_tramp_progs *
 bpf_trampoline_get_progs(const struct bpf_trampoline *tr, int *total)
 {
-	const struct bpf_prog_aux *aux;
+	const struct bpf_tramp_node *node;
 	struct bpf_tramp_progs *tprogs;
 	struct bpf_prog **progs;
 	int kind;
@@ -159,21 +165,26 @@ bpf_trampoline_get_progs(const struct bpf_trampoline *tr, int *total)
 		*total += tr->progs_cnt[kind];
 		progs = tprogs[kind].progs;
 
-		hlist_for_each_entry(aux, &tr->progs_hlist[kind], tramp_hlist)
-			*progs++ = aux->prog;
+		hlist_for_each_entry(node, &tr->progs_hlist[kind], tramp_hlist)
+			*progs++ = node->prog;
 	}
 	return tprogs;
 }
 
-static void __bpf_tramp_image_put_deferred(struct work_struct *work)
+static void __bpf_tramp_image_free(struct bpf_tramp_image *im)
 {
-	struct bpf_tramp_image *im;
-
-	im = container_of(work, struct bpf_tramp_image, work);
 	bpf_image_ksym_del(&im->ksym);
 	bpf_jit_free_exec(im->image);
 	bpf_jit_uncharge_modmem(1);
 	percpu_ref_exit(&im->pcref);
+}
+
+static void __bpf_tramp_image_put_deferred(struct work_struct *work)
+{
+	struct bpf_tramp_image *im;
+
+	im = container_of(work, struct bpf_tramp_image, work);
+	__bpf_tramp_image_free(im);
 	kfree_rcu(im, rcu);
 }
 
@@ -298,30 +309,26 @@ static struct bpf_tramp_image *bpf_tramp_image_alloc(u64 key, u32 idx)
 	return ERR_PTR(err);
 }
 
-static int bpf_trampoline_update(struct bpf_trampoline *tr)
+/* Generate a new image calling the progs currently linked to @tr. Returns
+ * NULL if no progs are linked.
+ */
+static struct bpf_tramp_image *bpf_trampoline_prepare(struct bpf_trampoline *tr)
 {
-	struct bpf_tramp_image *im;
+	struct bpf_tramp_image *im = NULL;
 	struct bpf_tramp_progs *tprogs;
 	u32 flags = BPF_TRAMP_F_RESTORE_REGS;
 	int err, total;
 
 	tprogs = bpf_trampoline_get_progs(tr, &total);
 	if (IS_ERR(tprogs))
-		return PTR_ERR(tprogs);
+		return ERR_CAST(tprogs);
 
-	if (total == 0) {
-		err = unregister_fentry(tr, tr->cur_image->image);
-		bpf_tramp_image_put(tr->cur_image);
-		tr->cur_image = NULL;
-		tr->selector = 0;
+	if (total == 0)
 		goto out;
-	}
 
 	im = bpf_tramp_image_alloc(tr->key, tr->selector);
-	if (IS_ERR(im)) {
-		err = PTR_ERR(im);
+	if (IS_ERR(im))
 		goto out;
-	}
 
 	if (tprogs[BPF_TRAMP_FEXIT].nr_progs ||
 	    tprogs[BPF_TRAMP_MODIFY_RETURN].nr_progs)
@@ -330,8 +337,49 @@ static int bpf_trampoline_update(struct bpf_trampoline *tr)
 	err = arch_prepare_bpf_trampoline(im, im->image, im->image + PAGE_SIZE,
 					  &tr->func.model, flags, tprogs,
 					  tr->func.addr);
-	if (err < 0)
-		goto out;
+	if (err < 0) {
+		/* never reachable, no need to wait for anything */
+		__bpf_tramp_image_free(im);
+		kfree(im);
+		im = ERR_PTR(err);
+	}
+out:
+	kfree(tprogs);
+	return im;
+}
+
+/* @im is now called from tr->func.addr */
+static void bpf_trampoline_install(struct bpf_trampoline *tr,
+				   struct bpf_tramp_image *im)
+{
+	if (tr->cur_image)
+		bpf_tramp_image_put(tr->cur_image);
+	tr->cur_image = im;
+	tr->selector++;
+}
+
+/* tr->func.addr no longer calls the trampoline */
+static void bpf_trampoline_uninstall(struct bpf_trampoline *tr)
+{
+	bpf_tramp_image_put(tr->cur_image);
+	tr->cur_image = NULL;
+	tr->selector = 0;
+}
+
+static int bpf_trampoline_update(struct bpf_trampoline *tr)
+{
+	struct bpf_tramp_image *im;
+	int err;
+
+	im = bpf_trampoline_prepare(tr);
+	if (IS_ERR(im))
+		return PTR_ERR(im);
+
+	if (!im) {
+		err = unregister_fentry(tr, tr->cur_image->image);
+		bpf_trampoline_uninstall(tr);
+		return err;
+	}
 
 	WARN_ON(tr->cur_image && tr->selector == 0);
 	WARN_ON(!tr->cur_image && tr->selector);
@@ -341,15 +389,12 @@ static int bpf_trampoline_update(struct bpf_trampoline *tr)
 	else
 		/* first time registering */
 		err = register_fentry(tr, im->image);
-	if (err)
-		goto out;
-	if (tr->cur_image)
-		bpf_tramp_image_put(tr->cur_image);
-	tr->cur_image = im;
-	tr->selector++;
-out:
-	kfree(tprogs);
-	return err;
+	if (err) {
+		bpf_tramp_image_put(im);
+		return err;
+	}
+	bpf_trampoline_install(tr, im);
+	return 0;
 }
 
 static enum bpf_tramp_prog_type bpf_attach_type_to_tramp(struct bpf_prog *prog)
@@ -374,11 +419,58 @@ static enum bpf_tramp_prog_type bpf_attach_type_to_tramp(struct bpf_prog *prog)
 	}
 }
 
+static int bpf_trampoline_progs_cnt(const struct bpf_trampoline *tr)
+{
+	return tr->progs_cnt[BPF_TRAMP_FENTRY] + tr->progs_cnt[BPF_TRAMP_FEXIT] +
+	       tr->progs_cnt[BPF_TRAMP_MODIFY_RETURN];
+}
+
+static bool bpf_trampoline_has_prog(const struct bpf_trampoline *tr,
+				    enum bpf_tramp_prog_type kind,
+				    const struct bpf_prog *prog)
+{
+	const struct bpf_tramp_node *node;
+
+	hlist_for_each_entry(node, &tr->progs_hlist[kind], tramp_hlist)
+		if (node->prog == prog)
+			return true;
+	return false;
+}
+
+static int bpf_trampoline_add_node(struct bpf_trampoline *tr,
+				   struct bpf_tramp_node *node,
+				   enum bpf_tramp_prog_type kind)
+{
+	int cnt;
+
+	if (tr->extension_prog)
+		/* cannot attach fentry/fexit if extension prog is attached. */
+		return -EBUSY;
+	cnt = tr->progs_cnt[BPF_TRAMP_FENTRY] + tr->progs_cnt[BPF_TRAMP_FEXIT];
+	if (cnt >= BPF_MAX_TRAMP_PROGS)
+		return -E2BIG;
+	if (!hlist_unhashed(&node->tramp_hlist) ||
+	    bpf_trampoline_has_prog(tr, kind, node->prog))
+		/* prog already linked */
+		return -EBUSY;
+	hlist_add_head(&node->tramp_hlist, &tr->progs_hlist[kind]);
+	tr->progs_cnt[kind]++;
+	return 0;
+}
+
+static void bpf_trampoline_del_node(struct bpf_trampoline *tr,
+				    struct bpf_tramp_node *node,
+				    enum bpf_tramp_prog_type kind)
+{
+	hlist_del(&node->tramp_hlist);
+	tr->progs_cnt[kind]--;
+}
+
 int bpf_trampoline_link_prog(struct bpf_prog *prog, struct bpf_trampoline *tr)
 {
+	struct bpf_tramp_node *node = &prog->aux->tramp_node;
 	enum bpf_tramp_prog_type kind;
 	int err = 0;
-	int cnt;
 
 	kind = bpf_attach_type_to_tramp(prog);
 	mutex_lock(&tr->mutex);
@@ -389,10 +481,15 @@ int bpf_trampoline_link_prog(struct bpf_prog *prog, struct bpf_trampoline *tr)
 		err = -EBUSY;
 		goto out;
 	}
-	cnt = tr->progs_cnt[BPF_TRAMP_FENTRY] + tr->progs_cnt[BPF_TRAMP_FEXIT];
+	if (tr->multi_pending) {
+		/* being (un)registered by a multi target link */
+		err = -EBUSY;
+		goto out;
+	}
 	if (kind == BPF_TRAMP_REPLACE) {
 		/* Cannot attach extension if fentry/fexit are in use. */
-		if (cnt) {
+		if (tr->progs_cnt[BPF_TRAMP_FENTRY] +
+		    tr->progs_cnt[BPF_TRAMP_FEXIT]) {
 			err = -EBUSY;
 			goto out;
 		}
@@ -401,22 +498,13 @@ int bpf_trampoline_link_prog(struct bpf_prog *prog, struct bpf_trampoline *tr)
 					 prog->bpf_func);
 		goto out;
 	}
-	if (cnt >= BPF_MAX_TRAMP_PROGS) {
-		err = -E2BIG;
-		goto out;
-	}
-	if (!hlist_unhashed(&prog->aux->tramp_hlist)) {
-		/* prog already linked */
-		err = -EBUSY;
+	node->prog = prog;
+	err = bpf_trampoline_add_node(tr, node, kind);
+	if (err)
 		goto out;
-	}
-	hlist_add_head(&prog->aux->tramp_hlist, &tr->progs_hlist[kind]);
-	tr->progs_cnt[kind]++;
 	err = bpf_trampoline_update(tr);
-	if (err) {
-		hlist_del(&prog->aux->tramp_hlist);
-		tr->progs_cnt[kind]--;
-	}
+	if (err)
+		bpf_trampoline_del_node(tr, node, kind);
 out:
 	mutex_unlock(&tr->mutex);
 	return err;
@@ -437,14 +525,217 @@ int bpf_trampoline_unlink_prog(struct bpf_prog *prog, struct bpf_trampoline *tr)
 		tr->extension_prog = NULL;
 		goto out;
 	}
-	hlist_del(&prog->aux->tramp_hlist);
-	tr->progs_cnt[kind]--;
+	bpf_trampoline_del_node(tr, &prog->aux->tramp_node, kind);
 	err = bpf_trampoline_update(tr);
 out:
 	mutex_unlock(&tr->mutex);
 	return err;
 }
 
+/* Like bpf_trampoline_update() after linking @node, except when this is the
+ * first trampoline of an ftrace managed function. Then the new image is
+ * returned in @pending and it is up to the caller to register it.
+ */
+static int bpf_trampoline_link_node_deferred(struct bpf_trampoline *tr,
+					     struct bpf_tramp_node *node,
+					     enum bpf_tramp_prog_type kind,
+					     struct bpf_tramp_image **pending)
+{
+	struct bpf_tramp_image *im;
+	int err;
+
+	err = bpf_trampoline_add_node(tr, node, kind);
+	if (err)
+		return err;
+
+	if (!tr->cur_image) {
+		err = is_ftrace_location(tr->func.addr);
+		if (err < 0)
+			goto out;
+	}
+	if (tr->cur_image || !err) {
+		/* replacing an image, or poking the call in directly */
+		err = bpf_trampoline_update(tr);
+		goto out;
+	}
+
+	im = bpf_trampoline_prepare(tr);
+	if (IS_ERR(im)) {
+		err = PTR_ERR(im);
+		goto out;
+	}
+	tr->func.ftrace_managed = true;
+	*pending = im;
+	err = 0;
+out:
+	if (err)
+		bpf_trampoline_del_node(tr, node, kind);
+	return err;
+}
+
+/* Link @prog to all of @trs, using @nodes[i] for @trs[i]. The functions
+ * which get their first trampoline are registered with ftrace in one
+ * batch, so that all of their call sites are patched in a single pass
+ * instead of one pass per function. Functions which already have a
+ * trampoline get their image replaced one at a time, as with
+ * bpf_trampoline_link_prog().
+ *
+ * Each trampoline is locked only while its own image is prepared or
+ * installed. Until the batch is registered, the trampolines in it are
+ * marked multi_pending and refuse other links.
+ *
+ * @trs must not contain duplicates. Either @prog is linked to all of @trs,
+ * or to none of them.
+ */
+int bpf_trampoline_link_prog_multi(struct bpf_prog *prog,
+				   struct bpf_trampoline **trs,
+				   struct bpf_tramp_node *nodes, u32 cnt)
+{
+	enum bpf_tramp_prog_type kind;
+	struct bpf_tramp_image **ims;
+	unsigned long *ips, *addrs;
+	struct bpf_trampoline *tr;
+	u32 i, nr_ips = 0;
+	int err = -ENOMEM;
+
+	kind = bpf_attach_type_to_tramp(prog);
+	if (kind == BPF_TRAMP_REPLACE)
+		return -EINVAL;
+
+	ims = kvcalloc(cnt, sizeof(*ims), GFP_KERNEL);
+	ips = kvcalloc(cnt, sizeof(*ips), GFP_KERNEL);
+	addrs = kvcalloc(cnt, sizeof(*addrs), GFP_KERNEL);
+	if (!ims || !ips || !addrs)
+		goto out_free;
+
+	mutex_lock(&trampoline_multi_mutex);
+	for (i = 0; i < cnt; i++) {
+		tr = trs[i];
+		mutex_lock(&tr->mutex);
+		nodes[i].prog = prog;
+		err = bpf_trampoline_link_node_deferred(tr, &nodes[i], kind,
+							&ims[i]);
+		if (ims[i]) {
+			tr->multi_pending = true;
+			ips[nr_ips] = (unsigned long)tr->func.addr;
+			addrs[nr_ips++] = (unsigned long)ims[i]->image;
+		}
+		mutex_unlock(&tr->mutex);
+		if (err)
+			goto out_unlink;
+		cond_resched();
+	}
+
+	if (nr_ips) {
+		err = register_ftrace_direct_ips(ips, addrs, nr_ips);
+		if (err)
+			goto out_unlink;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		if (!ims[i])
+			continue;
+		tr = trs[i];
+		mutex_lock(&tr->mutex);
+		bpf_trampoline_install(tr, ims[i]);
+		tr->multi_pending = false;
+		mutex_unlock(&tr->mutex);
+	}
+	mutex_unlock(&trampoline_multi_mutex);
+	goto out_free;
+
+out_unlink:
+	/* trs[0] to trs[i - 1] are linked */
+	while (i--) {
+		tr = trs[i];
+		mutex_lock(&tr->mutex);
+		bpf_trampoline_del_node(tr, &nodes[i], kind);
+		if (ims[i]) {
+			/* never registered, nothing can be running it */
+			bpf_tramp_image_put(ims[i]);
+			tr->multi_pending = false;
+		} else {
+			WARN_ON_ONCE(bpf_trampoline_update(tr));
+		}
+		mutex_unlock(&tr->mutex);
+	}
+	mutex_unlock(&trampoline_multi_mutex);
+out_free:
+	kvfree(addrs);
+	kvfree(ips);
+	kvfree(ims);
+	return err;
+}
+
+/* Undo bpf_trampoline_link_prog_multi(). The functions which lose their
+ * last prog are unregistered from ftrace in one batch. Should never fail.
+ */
+void bpf_trampoline_unlink_prog_multi(struct bpf_prog *prog,
+				      struct bpf_trampoline **trs,
+				      struct bpf_tramp_node *nodes, u32 cnt)
+{
+	enum bpf_tramp_prog_type kind;
+	unsigned long *ips, *addrs;
+	struct bpf_trampoline *tr;
+	u32 i, nr_ips = 0;
+	int err = 0;
+
+	kind = bpf_attach_type_to_tramp(prog);
+
+	/* Without the arrays every function is unregistered on its own */
+	ips = kvcalloc(cnt, sizeof(*ips), GFP_KERNEL);
+	addrs = kvcalloc(cnt, sizeof(*addrs), GFP_KERNEL);
+	if (!ips || !addrs) {
+		kvfree(ips);
+		ips = NULL;
+	}
+
+	mutex_lock(&trampoline_multi_mutex);
+	for (i = 0; i < cnt; i++) {
+		tr = trs[i];
+		mutex_lock(&tr->mutex);
+		bpf_trampoline_del_node(tr, &nodes[i], kind);
+		if (ips && tr->func.ftrace_managed &&
+		    !bpf_trampoline_progs_cnt(tr)) {
+			/* The image keeps calling @prog until it is
+			 * unregistered below, @prog outlives this function.
+			 */
+			tr->multi_pending = true;
+			ips[nr_ips] = (unsigned long)tr->func.addr;
+			addrs[nr_ips++] = (unsigned long)tr->cur_image->image;
+		} else {
+			WARN_ON_ONCE(bpf_trampoline_update(tr));
+		}
+		mutex_unlock(&tr->mutex);
+		cond_resched();
+	}
+
+	if (nr_ips)
+		err = unregister_ftrace_direct_ips(ips, addrs, nr_ips);
+	WARN_ON_ONCE(err);
+
+	for (i = 0; nr_ips && i < cnt; i++) {
+		tr = trs[i];
+		mutex_lock(&tr->mutex);
+		if (tr->multi_pending) {
+			tr->multi_pending = false;
+			/* The stale images call @prog, which is about to
+			 * be freed. If the batch failed, unregister them one
+			 * by one.
+			 */
+			if (err)
+				WARN_ON_ONCE(bpf_trampoline_update(tr));
+			else
+				bpf_trampoline_uninstall(tr);
+		}
+		mutex_unlock(&tr->mutex);
+	}
+	mutex_unlock(&trampoline_multi_mutex);
+
+	kvfree(addrs);
+	kvfree(ips);
+}
+
 struct bpf_trampoline *bpf_trampoline_get(u64 key,
 					  struct bpf_attach_target_info *tgt_info)
 {
@@ -19,6 +19,7 @@
 #include <linux/sort.h>
 #include <linux/perf_event.h>
 #include <linux/ctype.h>
+#include <linux/jhash.h>
 #include <linux/error-injection.h>
 #include <linux/bpf_lsm.h>
 #include <linux/btf_ids.h>
@@ -240,6 +241,7 @@ struct bpf_call_arg_meta {
 	int func_id;
 	u32 btf_id;
 	u32 ret_btf_id;
+	u32 subprogno;
 };
 
 struct btf *btf_vmlinux;
@@ -443,7 +445,8 @@ static bool arg_type_may_be_null(enum bpf_arg_type type)
 	       type == ARG_PTR_TO_MEM_OR_NULL ||
 	       type == ARG_PTR_TO_CTX_OR_NULL ||
 	       type == ARG_PTR_TO_SOCKET_OR_NULL ||
-	       type == ARG_PTR_TO_ALLOC_MEM_OR_NULL;
+	       type == ARG_PTR_TO_ALLOC_MEM_OR_NULL ||
+	       type == ARG_PTR_TO_STACK_OR_NULL;
 }
 
 /* Determine whether the function releases some resources allocated by another
@@ -526,6 +529,7 @@ static const char * const reg_type_str[] = {
 	[PTR_TO_RDONLY_BUF_OR_NULL] = "rdonly_buf_or_null",
 	[PTR_TO_RDWR_BUF]	= "rdwr_buf",
 	[PTR_TO_RDWR_BUF_OR_NULL] = "rdwr_buf_or_null",
+	[PTR_TO_FUNC]		= "func",
 };
 
 static char slot_type_char[] = {
@@ -1483,6 +1487,17 @@ static int check_subprogs(struct bpf_verifier_env *env)
 
 	/* determine subprog starts. The end is one before the next starts */
 	for (i = 0; i < insn_cnt; i++) {
+		if (bpf_pseudo_func(insn + i)) {
+			if (!env->bpf_capable) {
+				verbose(env,
+					"function pointers are allowed for CAP_BPF and CAP_SYS_ADMIN\n");
+				return -EPERM;
+			}
+			ret = add_subprog(env, i + insn[i].imm + 1);
+			if (ret < 0)
+				return ret;
+			continue;
+		}
 		if (insn[i].code != (BPF_JMP | BPF_CALL))
 			continue;
 		if (insn[i].src_reg != BPF_PSEUDO_CALL)
@@ -1906,6 +1921,11 @@ static int backtrack_insn(struct bpf_verifier_env *env, int idx,
 		if (opcode == BPF_CALL) {
 			if (insn->src_reg == BPF_PSEUDO_CALL)
 				return -ENOTSUPP;
+			/* bpf_loop() passes control to its callback, which
+			 * precision tracking cannot follow
+			 */
+			if (insn->imm == BPF_FUNC_loop)
+				return -ENOTSUPP;
 			/* regular helper call sets R0 */
 			*reg_mask &= ~1;
 			if (*reg_mask & 0x3f) {
@@ -2216,6 +2236,7 @@ static bool is_spillable_regtype(enum bpf_reg_type type)
 	case PTR_TO_PERCPU_BTF_ID:
 	case PTR_TO_MEM:
 	case PTR_TO_MEM_OR_NULL:
+	case PTR_TO_FUNC:
 		return true;
 	default:
 		return false;
@@ -2752,6 +2773,56 @@ static int check_stack_read(struct bpf_verifier_env *env,
 }
 
 
+/* The stack of the frames below a bpf_loop() callback is shared by all
+ * iterations of the loop, while the callback itself is only verified once,
+ * starting from a state where everything scalar in those frames is unknown.
+ * Keep what one iteration leaves behind within that state: the callback may
+ * only store scalars there, into slots that already hold scalar data.
+ */
+static int check_callback_stack_write(struct bpf_verifier_env *env,
+				      /* stack frame we're writing to */
+				      struct bpf_func_state *state,
+				      int min_off, int max_off,
+				      int value_regno)
+{
+	struct bpf_verifier_state *vstate = env->cur_state;
+	int i, slot, spi;
+	u8 stype;
+
+	for (i = vstate->curframe; i > state->frameno; i--)
+		if (vstate->frame[i]->in_callback_fn)
+			break;
+	if (i == state->frameno)
+		return 0;
+
+	if (value_regno >= 0 && cur_regs(env)[value_regno].type != SCALAR_VALUE) {
+		verbose(env, "callback cannot spill pointers into stack frame of the caller\n");
+		return -EACCES;
+	}
+
+	for (i = min_off; i < max_off; i++) {
+		slot = -i - 1;
+		spi = slot / BPF_REG_SIZE;
+		if (slot >= state->allocated_stack) {
+			stype = STACK_INVALID;
+		} else {
+			stype = state->stack[spi].slot_type[slot % BPF_REG_SIZE];
+			if (stype == STACK_SPILL &&
+			    state->stack[spi].spilled_ptr.type != SCALAR_VALUE) {
+				verbose(env, "callback cannot overwrite spilled pointer in stack frame of the caller, off %d\n",
+					i);
+				return -EACCES;
+			}
+		}
+		if (stype == STACK_INVALID && !env->allow_uninit_stack) {
+			verbose(env, "callback cannot initialize stack of the caller, off %d\n",
+				i);
+			return -EACCES;
+		}
+	}
+	return 0;
+}
+
 /* check_stack_write dispatches to check_stack_write_fixed_off or
  * check_stack_write_var_off.
  *
@@ -2770,6 +2841,12 @@ static int check_stack_write(struct bpf_verifier_env *env,
 	struct bpf_func_state *state = func(env, reg);
 	int err;
 
+	err = check_callback_stack_write(env, state, reg->smin_value + off,
+					 reg->smax_value + off + size,
+					 value_regno);
+	if (err)
+		return err;
+
 	if (tnum_is_const(reg->var_off)) {
 		off += reg->var_off.value;
 		err = check_stack_write_fixed_off(env, state, off, size,
@@ -3322,9 +3399,12 @@ static int check_max_stack_depth(struct bpf_verifier_env *env)
 continue_func:
 	subprog_end = subprog[idx + 1].start;
 	for (; i < subprog_end; i++) {
-		if (insn[i].code != (BPF_JMP | BPF_CALL))
-			continue;
-		if (insn[i].src_reg != BPF_PSEUDO_CALL)
+		/* a callback runs on top of the frame that passes it to
+		 * a helper, so count it the same way as a direct call
+		 */
+		if (!bpf_pseudo_func(insn + i) &&
+		    (insn[i].code != (BPF_JMP | BPF_CALL) ||
+		     insn[i].src_reg != BPF_PSEUDO_CALL))
 			continue;
 		/* remember insn and function to return to */
 		ret_insn[frame] = i + 1;
@@ -4062,6 +4142,16 @@ static int check_stack_range_initialized(
 		return 0;
 	}
 
+	/* A helper clobbering the stack writes to it as much as a store
+	 * does, so it is subject to the same limits inside a callback.
+	 */
+	if (clobber) {
+		err = check_callback_stack_write(env, state, min_off,
+						 max_off + access_size, -1);
+		if (err)
+			return err;
+	}
+
 	for (i = min_off; i < max_off + access_size; i++) {
 		u8 *stype;
 
@@ -4377,6 +4467,8 @@ static const struct bpf_reg_types const_map_ptr_types = { .types = { CONST_PTR_T
 static const struct bpf_reg_types btf_ptr_types = { .types = { PTR_TO_BTF_ID } };
 static const struct bpf_reg_types spin_lock_types = { .types = { PTR_TO_MAP_VALUE } };
 static const struct bpf_reg_types percpu_btf_ptr_types = { .types = { PTR_TO_PERCPU_BTF_ID } };
+static const struct bpf_reg_types func_ptr_types = { .types = { PTR_TO_FUNC } };
+static const struct bpf_reg_types stack_ptr_types = { .types = { PTR_TO_STACK } };
 
 static const struct bpf_reg_types *compatible_reg_types[__BPF_ARG_TYPE_MAX] = {
 	[ARG_PTR_TO_MAP_KEY]		= &map_key_value_types,
@@ -4405,6 +4497,8 @@ static const struct bpf_reg_types *compatible_reg_types[__BPF_ARG_TYPE_MAX] = {
 	[ARG_PTR_TO_INT]		= &int_ptr_types,
 	[ARG_PTR_TO_LONG]		= &int_ptr_types,
 	[ARG_PTR_TO_PERCPU_BTF_ID]	= &percpu_btf_ptr_types,
+	[ARG_PTR_TO_FUNC]		= &func_ptr_types,
+	[ARG_PTR_TO_STACK_OR_NULL]	= &stack_ptr_types,
 };
 
 static int check_reg_type(struct bpf_verifier_env *env, u32 regno,
@@ -4564,7 +4658,12 @@ static int check_func_arg(struct bpf_verifier_env *env, u32 arg,
 			verbose(env, "invalid map_ptr to access map->value\n");
 			return -EACCES;
 		}
-		meta->raw_mode = (arg_type == ARG_PTR_TO_UNINIT_MAP_VALUE);
+		/* bpf_map_peek_elem() on a bloom filter reads the value it
+		 * is given rather than filling it in.
+		 */
+		meta->raw_mode = (arg_type == ARG_PTR_TO_UNINIT_MAP_VALUE &&
+				  meta->map_ptr->map_type !=
+				  BPF_MAP_TYPE_BLOOM_FILTER);
 		err = check_helper_mem_access(env, regno,
 					      meta->map_ptr->value_size, false,
 					      meta);
@@ -4574,6 +4673,8 @@ static int check_func_arg(struct bpf_verifier_env *env, u32 arg,
 			return -EACCES;
 		}
 		meta->ret_btf_id = reg->btf_id;
+	} else if (arg_type == ARG_PTR_TO_FUNC) {
+		meta->subprogno = reg->subprogno;
 	} else if (arg_type == ARG_PTR_TO_SPIN_LOCK) {
 		if (meta->func_id == BPF_FUNC_spin_lock) {
 			if (process_spin_lock(env, regno, true))
@@ -4790,6 +4891,11 @@ static int check_map_func_compatibility(struct bpf_verifier_env *env,
 		    func_id != BPF_FUNC_map_push_elem)
 			goto error;
 		break;
+	case BPF_MAP_TYPE_BLOOM_FILTER:
+		if (func_id != BPF_FUNC_map_peek_elem &&
+		    func_id != BPF_FUNC_map_push_elem)
+			goto error;
+		break;
 	case BPF_MAP_TYPE_SK_STORAGE:
 		if (func_id != BPF_FUNC_sk_storage_get &&
 		    func_id != BPF_FUNC_sk_storage_delete)
@@ -4800,6 +4906,11 @@ static int check_map_func_compatibility(struct bpf_verifier_env *env,
 		    func_id != BPF_FUNC_inode_storage_delete)
 			goto error;
 		break;
+	case BPF_MAP_TYPE_TASK_STORAGE:
+		if (func_id != BPF_FUNC_task_storage_get &&
+		    func_id != BPF_FUNC_task_storage_delete)
+			goto error;
+		break;
 	default:
 		break;
 	}
@@ -4861,13 +4972,18 @@ static int check_map_func_compatibility(struct bpf_verifier_env *env,
 		    map->map_type != BPF_MAP_TYPE_SOCKHASH)
 			goto error;
 		break;
-	case BPF_FUNC_map_peek_elem:
 	case BPF_FUNC_map_pop_elem:
-	case BPF_FUNC_map_push_elem:
 		if (map->map_type != BPF_MAP_TYPE_QUEUE &&
 		    map->map_type != BPF_MAP_TYPE_STACK)
 			goto error;
 		break;
+	case BPF_FUNC_map_peek_elem:
+	case BPF_FUNC_map_push_elem:
+		if (map->map_type != BPF_MAP_TYPE_QUEUE &&
+		    map->map_type != BPF_MAP_TYPE_STACK &&
+		    map->map_type != BPF_MAP_TYPE_BLOOM_FILTER)
+			goto error;
+		break;
 	case BPF_FUNC_sk_storage_get:
 	case BPF_FUNC_sk_storage_delete:
 		if (map->map_type != BPF_MAP_TYPE_SK_STORAGE)
@@ -4878,6 +4994,11 @@ static int check_map_func_compatibility(struct bpf_verifier_env *env,
 		if (map->map_type != BPF_MAP_TYPE_INODE_STORAGE)
 			goto error;
 		break;
+	case BPF_FUNC_task_storage_get:
+	case BPF_FUNC_task_storage_delete:
+		if (map->map_type != BPF_MAP_TYPE_TASK_STORAGE)
+			goto error;
+		break;
 	default:
 		break;
 	}
@@ -5169,6 +5290,108 @@ static int check_func_call(struct bpf_verifier_env *env, struct bpf_insn *insn,
 	return 0;
 }
 
+static int check_reference_leak(struct bpf_verifier_env *env)
+{
+	struct bpf_func_state *state = cur_func(env);
+	int i;
+
+	for (i = 0; i < state->acquired_refs; i++) {
+		verbose(env, "Unreleased reference id=%d alloc_insn=%d\n",
+			state->refs[i].id, state->refs[i].insn_idx);
+	}
+	return state->acquired_refs ? -EINVAL : 0;
+}
+
+static bool in_callback(struct bpf_verifier_env *env)
+{
+	struct bpf_verifier_state *state = env->cur_state;
+	int i;
+
+	for (i = 1; i <= state->curframe; i++)
+		if (state->frame[i]->in_callback_fn)
+			return true;
+	return false;
+}
+
+/* Forget the values of scalars in the stack of all frames up to the
+ * current one. A callback that was given a pointer into that stack may
+ * have changed them on any iteration of the loop, or on none at all.
+ */
+static void widen_callback_caller_stacks(struct bpf_verifier_env *env)
+{
+	struct bpf_verifier_state *state = env->cur_state;
+	struct bpf_stack_state *stack;
+	int i, j, k;
+
+	for (i = 0; i <= state->curframe; i++) {
+		for (j = 0; j < state->frame[i]->allocated_stack / BPF_REG_SIZE; j++) {
+			stack = &state->frame[i]->stack[j];
+			if (stack->slot_type[0] == STACK_SPILL) {
+				if (stack->spilled_ptr.type == SCALAR_VALUE)
+					__mark_reg_unknown(env, &stack->spilled_ptr);
+				continue;
+			}
+			for (k = 0; k < BPF_REG_SIZE; k++)
+				if (stack->slot_type[k] == STACK_ZERO)
+					stack->slot_type[k] = STACK_MISC;
+		}
+	}
+}
+
+/* Set up the frame in which the callback passed to bpf_loop() is verified.
+ * It is verified once, with R1 being any valid loop index and R2 the
+ * context pointer, and returns to the insn after the helper call.
+ */
+static int push_callback_frame(struct bpf_verifier_env *env, int insn_idx,
+			       int subprog)
+{
+	struct bpf_verifier_state *state = env->cur_state;
+	struct bpf_func_state *caller, *callee;
+	struct bpf_reg_state *reg;
+
+	if (state->curframe + 1 >= MAX_CALL_FRAMES) {
+		verbose(env, "the call stack of %d frames is too deep\n",
+			state->curframe + 2);
+		return -E2BIG;
+	}
+
+	caller = state->frame[state->curframe];
+	if (state->frame[state->curframe + 1]) {
+		verbose(env, "verifier bug. Frame %d already allocated\n",
+			state->curframe + 1);
+		return -EFAULT;
+	}
+
+	callee = kzalloc(sizeof(*callee), GFP_KERNEL);
+	if (!callee)
+		return -ENOMEM;
+	state->frame[state->curframe + 1] = callee;
+
+	init_func_state(env, callee, insn_idx /* callsite */,
+			state->curframe + 1 /* frameno within this callchain */,
+			subprog /* subprog number within this prog */);
+	callee->in_callback_fn = true;
+	callee->callback_ctx_on_stack =
+		caller->regs[BPF_REG_3].type == PTR_TO_STACK;
+
+	/* R1 is the loop index. Copying the caller's registers keeps the
+	 * liveness chain connected.
+	 */
+	callee->regs[BPF_REG_1] = caller->regs[BPF_REG_1];
+	reg = &callee->regs[BPF_REG_1];
+	__mark_reg_unknown(env, reg);
+	reg->var_off = tnum_range(0, BPF_MAX_LOOPS - 1);
+	__update_reg_bounds(reg);
+	reg->subreg_def = DEF_NOT_SUBREG;
+
+	/* R2 is callback_ctx */
+	callee->regs[BPF_REG_2] = caller->regs[BPF_REG_3];
+
+	if (callee->callback_ctx_on_stack)
+		widen_callback_caller_stacks(env);
+	return 0;
+}
+
 static int prepare_func_exit(struct bpf_verifier_env *env, int *insn_idx)
 {
 	struct bpf_verifier_state *state = env->cur_state;
@@ -5178,7 +5401,28 @@ static int prepare_func_exit(struct bpf_verifier_env *env, int *insn_idx)
 
 	callee = state->frame[state->curframe];
 	r0 = &callee->regs[BPF_REG_0];
-	if (r0->type == PTR_TO_STACK) {
+	if (callee->in_callback_fn) {
+		struct tnum range = tnum_range(0, 1);
+
+		if (r0->type != SCALAR_VALUE) {
+			verbose(env, "At callback exit the register R0 is not a known value (%s)\n",
+				reg_type_str[r0->type]);
+			return -EINVAL;
+		}
+		err = mark_chain_precision(env, BPF_REG_0);
+		if (err)
+			return err;
+		if (!tnum_in(range, r0->var_off)) {
+			verbose(env, "At callback exit the register R0 should have been 0 or 1\n");
+			return -EINVAL;
+		}
+		/* Every iteration starts without references, so each one
+		 * has to release what it acquired.
+		 */
+		err = check_reference_leak(env);
+		if (err)
+			return err;
+	} else if (r0->type == PTR_TO_STACK) {
 		/* technically it's ok to return caller's stack pointer
 		 * (or caller's caller's pointer) back to the caller,
 		 * since these pointers are valid. Only current stack
@@ -5191,13 +5435,22 @@ static int prepare_func_exit(struct bpf_verifier_env *env, int *insn_idx)
 
 	state->curframe--;
 	caller = state->frame[state->curframe];
-	/* return to the caller whatever r0 had in the callee */
-	caller->regs[BPF_REG_0] = *r0;
+	if (callee->in_callback_fn) {
+		/* r0 of the caller already holds the helper's return value.
+		 * The loop may also have stopped before running the callback
+		 * even once.
+		 */
+		if (callee->callback_ctx_on_stack)
+			widen_callback_caller_stacks(env);
+	} else {
+		/* return to the caller whatever r0 had in the callee */
+		caller->regs[BPF_REG_0] = *r0;
 
-	/* Transfer references to the caller */
-	err = transfer_reference_state(caller, callee);
-	if (err)
-		return err;
+		/* Transfer references to the caller */
+		err = transfer_reference_state(caller, callee);
+		if (err)
+			return err;
+	}
 
 	*insn_idx = callee->callsite + 1;
 	if (env->log.level & BPF_LOG_LEVEL) {
@@ -5316,25 +5569,14 @@ record_func_key(struct bpf_verifier_env *env, struct bpf_call_arg_meta *meta,
 	return 0;
 }
 
-static int check_reference_leak(struct bpf_verifier_env *env)
-{
-	struct bpf_func_state *state = cur_func(env);
-	int i;
-
-	for (i = 0; i < state->acquired_refs; i++) {
-		verbose(env, "Unreleased reference id=%d alloc_insn=%d\n",
-			state->refs[i].id, state->refs[i].insn_idx);
-	}
-	return state->acquired_refs ? -EINVAL : 0;
-}
-
-static int check_helper_call(struct bpf_verifier_env *env, int func_id, int insn_idx)
+static int check_helper_call(struct bpf_verifier_env *env, int func_id,
+			     int *insn_idx_p)
 {
 	const struct bpf_func_proto *fn = NULL;
+	int i, err, insn_idx = *insn_idx_p;
 	struct bpf_reg_state *regs;
 	struct bpf_call_arg_meta meta;
 	bool changes_data;
-	int i, err;
 
 	/* find function prototype */
 	if (func_id < 0 || func_id >= __BPF_FUNC_MAX_ID) {
@@ -5370,6 +5612,16 @@ static int check_helper_call(struct bpf_verifier_env *env, int func_id, int insn
 		return -EINVAL;
 	}
 
+	/* Packet pointers a callback got from its caller are assumed to
+	 * stay valid across all iterations of the loop, and a tail call
+	 * would return into the middle of it.
+	 */
+	if ((changes_data || func_id == BPF_FUNC_tail_call) && in_callback(env)) {
+		verbose(env, "func %s#%d is not allowed in callbacks\n",
+			func_id_name(func_id), func_id);
+		return -EINVAL;
+	}
+
 	memset(&meta, 0, sizeof(meta));
 	meta.pkt_access = fn->pkt_access;
 
@@ -5432,6 +5684,12 @@ static int check_helper_call(struct bpf_verifier_env *env, int func_id, int insn
 		return -EINVAL;
 	}
 
+	if (func_id == BPF_FUNC_loop) {
+		err = push_callback_frame(env, insn_idx, meta.subprogno);
+		if (err)
+			return err;
+	}
+
 	/* reset caller saved regs */
 	for (i = 0; i < CALLER_SAVED_REGS; i++) {
 		mark_reg_not_init(env, regs, caller_saved[i]);
@@ -5510,11 +5768,14 @@ static int check_helper_call(struct bpf_verifier_env *env, int func_id, int insn
 				PTR_TO_BTF_ID : PTR_TO_BTF_ID_OR_NULL;
 			regs[BPF_REG_0].btf_id = meta.ret_btf_id;
 		}
-	} else if (fn->ret_type == RET_PTR_TO_BTF_ID_OR_NULL) {
+	} else if (fn->ret_type == RET_PTR_TO_BTF_ID_OR_NULL ||
+		   fn->ret_type == RET_PTR_TO_BTF_ID) {
 		int ret_btf_id;
 
 		mark_reg_known_zero(env, regs, BPF_REG_0);
-		regs[BPF_REG_0].type = PTR_TO_BTF_ID_OR_NULL;
+		regs[BPF_REG_0].type = fn->ret_type == RET_PTR_TO_BTF_ID ?
+						     PTR_TO_BTF_ID :
+						     PTR_TO_BTF_ID_OR_NULL;
 		ret_btf_id = *fn->ret_btf_id;
 		if (ret_btf_id == 0) {
 			verbose(env, "invalid return type %d of func %s#%d\n",
@@ -5576,6 +5837,21 @@ static int check_helper_call(struct bpf_verifier_env *env, int func_id, int insn
 
 	if (changes_data)
 		clear_all_pkt_pointers(env);
+
+	if (func_id == BPF_FUNC_loop) {
+		struct bpf_verifier_state *state = env->cur_state;
+
+		/* and go analyze first insn of the callback */
+		state->curframe++;
+		*insn_idx_p = env->subprog_info[meta.subprogno].start - 1;
+
+		if (env->log.level & BPF_LOG_LEVEL) {
+			verbose(env, "caller:\n");
+			print_verifier_state(env, state->frame[state->curframe - 1]);
+			verbose(env, "callback:\n");
+			print_verifier_state(env, state->frame[state->curframe]);
+		}
+	}
 	return 0;
 }
 
@@ -5989,6 +6265,7 @@ static int adjust_ptr_min_max_vals(struct bpf_verifier_env *env,
 	case PTR_TO_TCP_SOCK:
 	case PTR_TO_TCP_SOCK_OR_NULL:
 	case PTR_TO_XDP_SOCK:
+	case PTR_TO_FUNC:
 		verbose(env, "R%d pointer arithmetic on %s prohibited\n",
 			dst, reg_type_str[ptr_reg->type]);
 		return -EACCES;
@@ -8114,6 +8391,21 @@ static int check_ld_imm(struct bpf_verifier_env *env, struct bpf_insn *insn)
 		return 0;
 	}
 
+	if (insn->src_reg == BPF_PSEUDO_FUNC) {
+		int subprogno;
+
+		subprogno = find_subprog(env, env->insn_idx + insn->imm + 1);
+		if (subprogno < 0) {
+			verbose(env, "verifier bug. No program starts at insn %d\n",
+				env->insn_idx + insn->imm + 1);
+			return -EFAULT;
+		}
+		mark_reg_known_zero(env, regs, insn->dst_reg);
+		dst_reg->type = PTR_TO_FUNC;
+		dst_reg->subprogno = subprogno;
+		return 0;
+	}
+
 	map = env->used_maps[aux->map_index];
 	mark_reg_known_zero(env, regs, insn->dst_reg);
 	dst_reg->map_ptr = map;
@@ -8570,6 +8862,17 @@ static int check_cfg(struct bpf_verifier_env *env)
 			goto peek_stack;
 		else if (ret < 0)
 			goto err_free;
+		/* the function a BPF_PSEUDO_FUNC ld_imm64 points to is
+		 * reached through the helper it is passed to
+		 */
+		if (bpf_pseudo_func(insns + t)) {
+			ret = push_insn(t, t + insns[t].imm + 1, BRANCH,
+					env, false);
+			if (ret == 1)
+				goto peek_stack;
+			else if (ret < 0)
+				goto err_free;
+		}
 	}
 
 mark_explored:
@@ -9335,6 +9638,30 @@ static bool states_equal(struct bpf_verifier_env *env,
 	return true;
 }
 
+/* Hash the parts of a state that states_equal() only accepts when they
+ * match exactly: the call chain, the spin lock and the acquired references.
+ * Registers and stack slots are compared with a "more conservative than"
+ * relation which a hash can't capture, so they are left out. States with
+ * different hashes can never be equal, which lets is_state_visited() skip
+ * them without walking their frames.
+ */
+static u32 state_shape_hash(struct bpf_verifier_state *st)
+{
+	struct bpf_func_state *frame;
+	u32 hash;
+	int i, j;
+
+	hash = jhash_2words(st->curframe, st->active_spin_lock, 0);
+	for (i = 0; i <= st->curframe; i++) {
+		frame = st->frame[i];
+		hash = jhash_2words(frame->callsite, frame->acquired_refs, hash);
+		for (j = 0; j < frame->acquired_refs; j++)
+			hash = jhash_2words(frame->refs[j].id,
+					    frame->refs[j].insn_idx, hash);
+	}
+	return hash;
+}
+
 /* Return 0 if no propagation happened. Return negative error code if error
  * happened. Otherwise, return the propagated bit.
  */
@@ -9481,6 +9808,8 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 	struct bpf_verifier_state *cur = env->cur_state, *new;
 	int i, j, err, states_cnt = 0;
 	bool add_new_state = env->test_state_freq ? true : false;
+	bool shape_match;
+	u32 shape_hash;
 
 	cur->last_insn_idx = env->prev_insn_idx;
 	if (!env->insn_aux_data[insn_idx].prune_point)
@@ -9505,13 +9834,18 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 	sl = *pprev;
 
 	clean_live_states(env, insn_idx, cur);
+	shape_hash = state_shape_hash(cur);
 
 	while (sl) {
 		states_cnt++;
 		if (sl->state.insn_idx != insn_idx)
 			goto next;
+		shape_match = sl->shape_hash == shape_hash;
+		if (!shape_match)
+			env->shape_hash_skips++;
 		if (sl->state.branches) {
-			if (states_maybe_looping(&sl->state, cur) &&
+			if (shape_match &&
+			    states_maybe_looping(&sl->state, cur) &&
 			    states_equal(env, &sl->state, cur)) {
 				verbose_linfo(env, insn_idx, "; ");
 				verbose(env, "infinite loop detected at insn %d\n", insn_idx);
@@ -9534,8 +9868,9 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 				add_new_state = false;
 			goto miss;
 		}
-		if (states_equal(env, &sl->state, cur)) {
+		if (shape_match && states_equal(env, &sl->state, cur)) {
 			sl->hit_cnt++;
+			env->pruned_states++;
 			/* reached equivalent register/stack state,
 			 * prune the search.
 			 * Registers read by the continuation are read by us.
@@ -9624,6 +9959,7 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 	new_sl = kzalloc(sizeof(struct bpf_verifier_state_list), GFP_KERNEL);
 	if (!new_sl)
 		return -ENOMEM;
+	new_sl->shape_hash = shape_hash;
 	env->total_states++;
 	env->peak_states++;
 	env->prev_jmps_processed = env->jmps_processed;
@@ -9946,7 +10282,7 @@ static int do_check(struct bpf_verifier_env *env)
 				if (insn->src_reg == BPF_PSEUDO_CALL)
 					err = check_func_call(env, insn, &env->insn_idx);
 				else
-					err = check_helper_call(env, insn->imm, env->insn_idx);
+					err = check_helper_call(env, insn->imm, &env->insn_idx);
 				if (err)
 					return err;
 
@@ -10164,6 +10500,20 @@ static int check_map_prog_compatibility(struct bpf_verifier_env *env,
 
 {
 	enum bpf_prog_type prog_type = resolve_prog_type(prog);
+
+	/* Resizable hash maps take their bucket locks with only bottom
+	 * halves disabled, which is not safe from the hard irq and NMI
+	 * contexts that trace type programs can run in.
+	 */
+	if ((is_tracing_prog_type(prog_type) ||
+	     prog_type == BPF_PROG_TYPE_TRACING) &&
+	    (map->map_type == BPF_MAP_TYPE_RHASH ||
+	     (map->inner_map_meta &&
+	      map->inner_map_meta->map_type == BPF_MAP_TYPE_RHASH))) {
+		verbose(env, "trace type programs cannot use resizable hash maps\n");
+		return -EINVAL;
+	}
+
 	/*
 	 * Validate that trace type programs use preallocated hash maps.
 	 *
@@ -10294,6 +10644,17 @@ static int resolve_pseudo_ldimm64(struct bpf_verifier_env *env)
 				goto next_insn;
 			}
 
+			if (insn[0].src_reg == BPF_PSEUDO_FUNC) {
+				/* insn[1].imm carries the subprog number
+				 * while the program is JITed
+				 */
+				if (insn[1].imm != 0) {
+					verbose(env, "unrecognized bpf_ld_imm64 insn\n");
+					return -EINVAL;
+				}
+				goto next_insn;
+			}
+
 			/* In final convert_pseudo_ld_imm64() step, this is
 			 * converted into regular 64-bit imm load insn.
 			 */
@@ -10419,9 +10780,13 @@ static void convert_pseudo_ld_imm64(struct bpf_verifier_env *env)
 	int insn_cnt = env->prog->len;
 	int i;
 
-	for (i = 0; i < insn_cnt; i++, insn++)
-		if (insn->code == (BPF_LD | BPF_IMM | BPF_DW))
-			insn->src_reg = 0;
+	for (i = 0; i < insn_cnt; i++, insn++) {
+		if (insn->code != (BPF_LD | BPF_IMM | BPF_DW))
+			continue;
+		if (insn->src_reg == BPF_PSEUDO_FUNC)
+			continue;
+		insn->src_reg = 0;
+	}
 }
 
 /* single env->prog->insni[off] instruction was replaced with the range
@@ -11043,6 +11408,21 @@ static int jit_subprogs(struct bpf_verifier_env *env)
 		return 0;
 
 	for (i = 0, insn = prog->insnsi; i < prog->len; i++, insn++) {
+		if (bpf_pseudo_func(insn)) {
+			subprog = find_subprog(env, i + insn->imm + 1);
+			if (subprog <= 0) {
+				WARN_ONCE(1, "verifier bug. No program starts at insn %d\n",
+					  i + insn->imm + 1);
+				return -EFAULT;
+			}
+			/* Remember the subprog in the upper half of the
+			 * imm64. Being non-zero, it also makes the JIT pick
+			 * the same encoding for the load as for the final
+			 * address patched in below.
+			 */
+			insn[1].imm = subprog;
+			continue;
+		}
 		if (insn->code != (BPF_JMP | BPF_CALL) ||
 		    insn->src_reg != BPF_PSEUDO_CALL)
 			continue;
@@ -11173,6 +11553,12 @@ static int jit_subprogs(struct bpf_verifier_env *env)
 	for (i = 0; i < env->subprog_cnt; i++) {
 		insn = func[i]->insnsi;
 		for (j = 0; j < func[i]->len; j++, insn++) {
+			if (bpf_pseudo_func(insn)) {
+				subprog = insn[1].imm;
+				insn[0].imm = (u32)(long)func[subprog]->bpf_func;
+				insn[1].imm = ((u64)(long)func[subprog]->bpf_func) >> 32;
+				continue;
+			}
 			if (insn->code != (BPF_JMP | BPF_CALL) ||
 			    insn->src_reg != BPF_PSEUDO_CALL)
 				continue;
@@ -11219,6 +11605,10 @@ static int jit_subprogs(struct bpf_verifier_env *env)
 	 * later look the same as if they were interpreted only.
 	 */
 	for (i = 0, insn = prog->insnsi; i < prog->len; i++, insn++) {
+		if (bpf_pseudo_func(insn)) {
+			insn[1].imm = 0;
+			continue;
+		}
 		if (insn->code != (BPF_JMP | BPF_CALL) ||
 		    insn->src_reg != BPF_PSEUDO_CALL)
 			continue;
@@ -11249,6 +11639,10 @@ static int jit_subprogs(struct bpf_verifier_env *env)
 	/* cleanup main prog to be interpreted */
 	prog->jit_requested = 0;
 	for (i = 0, insn = prog->insnsi; i < prog->len; i++, insn++) {
+		if (bpf_pseudo_func(insn)) {
+			insn[1].imm = 0;
+			continue;
+		}
 		if (insn->code != (BPF_JMP | BPF_CALL) ||
 		    insn->src_reg != BPF_PSEUDO_CALL)
 			continue;
@@ -11285,6 +11679,13 @@ static int fixup_call_args(struct bpf_verifier_env *env)
 		return -EINVAL;
 	}
 	for (i = 0; i < prog->len; i++, insn++) {
+		if (bpf_pseudo_func(insn)) {
+			/* When JIT fails the progs with callback calls
+			 * have to be rejected, since interpreter doesn't support them yet.
+			 */
+			verbose(env, "callbacks are not allowed in non-JITed programs\n");
+			return -EINVAL;
+		}
 		if (insn->code != (BPF_JMP | BPF_CALL) ||
 		    insn->src_reg != BPF_PSEUDO_CALL)
 			continue;
@@ -11859,12 +12260,15 @@ static void print_verification_stats(struct bpf_verifier_env *env)
 				verbose(env, "+");
 		}
 		verbose(env, "\n");
+		verbose(env, "state compares skipped by shape hash %d\n",
+			env->shape_hash_skips);
 	}
 	verbose(env, "processed %d insns (limit %d) max_states_per_insn %d "
-		"total_states %d peak_states %d mark_read %d\n",
+		"total_states %d peak_states %d mark_read %d pruned_states %d\n",
 		env->insn_processed, BPF_COMPLEXITY_LIMIT_INSNS,
 		env->max_states_per_insn, env->total_states,
-		env->peak_states, env->longest_mark_read_walk);
+		env->peak_states, env->longest_mark_read_walk,
+		env->pruned_states);
 }
 
 static int check_struct_ops_btf_id(struct bpf_verifier_env *env)
@@ -12436,6 +12840,10 @@ int bpf_check(struct bpf_prog **prog, union bpf_attr *attr,
 
 	env->verification_time = ktime_get_ns() - start_time;
 	print_verification_stats(env);
+	env->prog->aux->verified_insns = env->insn_processed;
+	env->prog->aux->verified_states = env->total_states;
+	env->prog->aux->verified_peak_states = env->peak_states;
+	env->prog->aux->verified_pruned_states = env->pruned_states;
 
 	if (log->level && bpf_verifier_log_full(log))
 		ret = -ENOSPC;
@@ -3621,6 +3621,39 @@ static void cgroup_pressure_release(struct kernfs_open_file *of)
 {
 	psi_trigger_replace(&of->priv, NULL);
 }
+
+static int cgroup_psi_enable_show(struct seq_file *seq, void *v)
+{
+	struct cgroup *cgrp = seq_css(seq)->cgroup;
+
+	seq_printf(seq, "%d\n", READ_ONCE(cgrp->psi.enabled));
+	return 0;
+}
+
+static ssize_t cgroup_psi_enable_write(struct kernfs_open_file *of,
+				       char *buf, size_t nbytes, loff_t off)
+{
+	struct cgroup *cgrp;
+	bool enable;
+	ssize_t ret;
+
+	if (static_branch_likely(&psi_disabled))
+		return -EOPNOTSUPP;
+
+	ret = kstrtobool(strstrip(buf), &enable);
+	if (ret)
+		return ret;
+
+	cgrp = cgroup_kn_lock_live(of->kn, false);
+	if (!cgrp)
+		return -ENOENT;
+
+	psi_cgroup_enable(cgrp, enable);
+
+	cgroup_kn_unlock(of->kn);
+
+	return nbytes;
+}
 #endif /* CONFIG_PSI */
 
 static int cgroup_freeze_show(struct seq_file *seq, void *v)
@@ -4902,6 +4935,12 @@ static struct cftype cgroup_base_files[] = {
 		.poll = cgroup_pressure_poll,
 		.release = cgroup_pressure_release,
 	},
+	{
+		.name = "cgroup.pressure",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cgroup_psi_enable_show,
+		.write = cgroup_psi_enable_write,
+	},
 #endif /* CONFIG_PSI */
 	{ }	/* terminate */
 };
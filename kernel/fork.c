@@ -96,6 +96,7 @@
 #include <linux/kasan.h>
 #include <linux/scs.h>
 #include <linux/io_uring.h>
+#include <linux/bpf.h>
 
 #ifdef CONFIG_USER_NS
 #include <linux/user_namespace.h>
@@ -445,6 +446,8 @@ void put_task_stack(struct task_struct *tsk)
 
 void free_task(struct task_struct *tsk)
 {
+	/* Here rather than in __put_task_struct() so failed forks free it too */
+	bpf_task_storage_free(tsk);
 	scs_release(tsk);
 
 #ifndef CONFIG_THREAD_INFO_IN_TASK
@@ -906,6 +909,11 @@ static struct task_struct *dup_task_struct(struct task_struct *orig, int node)
 	tsk->seccomp.filter = NULL;
 #endif
 
+#ifdef CONFIG_BPF_SYSCALL
+	/* Likewise, free_task() must not free the storage of orig */
+	RCU_INIT_POINTER(tsk->bpf_storage, NULL);
+#endif
+
 	setup_thread_stack(tsk, orig);
 	clear_user_return_notifier(tsk);
 	clear_tsk_need_resched(tsk);
@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * In-kernel interrupt balancer.
+ *
+ * Periodically samples the per CPU time accounting and the per interrupt
+ * counts, and moves the busiest movable interrupt away from CPUs whose
+ * time is mostly taken by task work (user and system time). The interrupt
+ * and the softirq work it raises then run on a CPU which has room for it.
+ *
+ * Only interrupts which user space could move through /proc/irq/N/
+ * smp_affinity are considered, i.e. managed and per CPU interrupts are left
+ * alone. An interrupt is only attributed to a CPU when its effective
+ * affinity is that single CPU. An affinity set from user space or by the
+ * driver is respected: the balancer only touches interrupts whose
+ * affinity is a multi CPU mask or the CPU it moved them to last, and only
+ * moves them within the mask they had before its first move.
+ *
+ * Moves are rate limited globally (irqbalance.max_moves per interval) and
+ * per interrupt (irqbalance.cooldown_ms). The current view and the last
+ * decisions are reported in /proc/irq/balance.
+ *
+ * This does not play well with a user space irqbalance daemon, only one
+ * of them should be enabled.
+ */
+#include <linux/irq.h>
+#include <linux/interrupt.h>
+#include <linux/kernel_stat.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/moduleparam.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
+#include <linux/sched/isolation.h>
+
+#include "internals.h"
+
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "irqbalance."
+
+static bool irqbal_enabled __read_mostly;
+static unsigned int irqbal_interval_ms __read_mostly = 1000;
+static unsigned int irqbal_busy_pct __read_mostly = 90;
+static unsigned int irqbal_headroom_pct __read_mostly = 25;
+static unsigned int irqbal_min_rate __read_mostly = 1000;
+static unsigned int irqbal_cooldown_ms __read_mostly = 10000;
+static unsigned int irqbal_max_moves __read_mostly = 1;
+
+module_param_named(interval_ms, irqbal_interval_ms, uint, 0644);
+MODULE_PARM_DESC(interval_ms, "Sampling interval");
+module_param_named(busy_pct, irqbal_busy_pct, uint, 0644);
+MODULE_PARM_DESC(busy_pct, "Task time share making a CPU saturated");
+module_param_named(headroom_pct, irqbal_headroom_pct, uint, 0644);
+MODULE_PARM_DESC(headroom_pct, "Minimum load difference for a move");
+module_param_named(min_rate, irqbal_min_rate, uint, 0644);
+MODULE_PARM_DESC(min_rate, "Minimum interrupts per second worth moving");
+module_param_named(cooldown_ms, irqbal_cooldown_ms, uint, 0644);
+MODULE_PARM_DESC(cooldown_ms, "Minimum time between two moves of an interrupt");
+module_param_named(max_moves, irqbal_max_moves, uint, 0644);
+MODULE_PARM_DESC(max_moves, "Maximum moves per interval");
+
+struct irqbal_cpu {
+	u64		task;		/* cumulative ns at the last sample */
+	u64		softirq;
+	u64		hardirq;
+	unsigned int	task_pct;	/* shares of the last interval */
+	unsigned int	softirq_pct;
+	unsigned int	hardirq_pct;
+	unsigned long	moved_in;
+	unsigned long	moved_out;
+};
+
+static DEFINE_PER_CPU(struct irqbal_cpu, irqbal_cpu);
+
+#define IRQBAL_LOG_SIZE	16
+
+struct irqbal_move {
+	unsigned long	when;		/* jiffies */
+	unsigned int	irq;
+	unsigned int	rate;
+	int		from;
+	int		to;
+	unsigned int	from_pct;
+	unsigned int	to_pct;
+};
+
+static struct irqbal_move irqbal_log[IRQBAL_LOG_SIZE];
+static unsigned long irqbal_nr_moves;
+static unsigned long irqbal_nr_failed;
+static u64 irqbal_last_sample;
+
+static DEFINE_MUTEX(irqbal_mutex);
+static void irqbal_workfn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(irqbal_work, irqbal_workfn);
+
+static inline unsigned int irqbal_pct(u64 delta, u64 period)
+{
+	return period ? min_t(u64, div64_u64(delta * 100, period), 100) : 0;
+}
+
+static inline unsigned int irqbal_load(struct irqbal_cpu *ic)
+{
+	return ic->task_pct + ic->softirq_pct + ic->hardirq_pct;
+}
+
+static void irqbal_sample_cpus(u64 period)
+{
+	struct kernel_cpustat kcs;
+	struct irq_desc *desc;
+	int cpu, irq;
+
+	/*
+	 * Rates are taken once per sample, so that every selection pass of
+	 * irqbal_balance() sees the same ones. The first sample after
+	 * enabling only takes the baseline, tot_count is a lifetime count.
+	 */
+	for_each_irq_desc(irq, desc) {
+		unsigned int count = READ_ONCE(desc->tot_count);
+
+		desc->balance_rate = irqbal_last_sample ?
+			div64_u64((u64)(count - desc->balance_count) *
+				  NSEC_PER_SEC, period) : 0;
+		desc->balance_count = count;
+	}
+
+	for_each_online_cpu(cpu) {
+		struct irqbal_cpu *ic = per_cpu_ptr(&irqbal_cpu, cpu);
+		u64 task, softirq, hardirq;
+
+		kcpustat_cpu_fetch(&kcs, cpu);
+		task = kcs.cpustat[CPUTIME_USER] + kcs.cpustat[CPUTIME_NICE] +
+		       kcs.cpustat[CPUTIME_SYSTEM];
+		softirq = kcs.cpustat[CPUTIME_SOFTIRQ];
+		hardirq = kcs.cpustat[CPUTIME_IRQ];
+
+		ic->task_pct = irqbal_pct(task - ic->task, period);
+		ic->softirq_pct = irqbal_pct(softirq - ic->softirq, period);
+		ic->hardirq_pct = irqbal_pct(hardirq - ic->hardirq, period);
+		ic->task = task;
+		ic->softirq = softirq;
+		ic->hardirq = hardirq;
+	}
+}
+
+/*
+ * Return the CPU the interrupt is delivered to if the balancer may move it,
+ * -1 otherwise. Sets @allowed to the CPUs it may be moved to.
+ */
+static int irqbal_movable(struct irq_desc *desc, struct cpumask *allowed)
+{
+	struct irq_data *data = irq_desc_get_irq_data(desc);
+	const struct cpumask *affinity = irq_data_get_affinity_mask(data);
+	const struct cpumask *effective;
+	int cpu;
+
+	if (!desc->action || irqd_is_per_cpu(data) ||
+	    !irq_can_set_affinity_usr(irq_desc_get_irq(desc)))
+		return -1;
+
+	effective = irq_data_get_effective_affinity_mask(data);
+	if (cpumask_weight(effective) != 1)
+		return -1;
+	cpu = cpumask_first(effective);
+
+	if (cpumask_weight(affinity) > 1) {
+		cpumask_and(allowed, affinity, cpu_online_mask);
+	} else if (cpu == desc->balance_cpu &&
+		   cpumask_test_cpu(cpu, affinity)) {
+		/* Moved here by us, stay within the mask it had before */
+		cpumask_and(allowed, desc->balance_mask, cpu_online_mask);
+	} else {
+		/* Pinned from user space or by the driver, hands off */
+		return -1;
+	}
+	cpumask_and(allowed, allowed, housekeeping_cpumask(HK_FLAG_MANAGED_IRQ));
+	return cpu;
+}
+
+/* Least loaded CPU of @allowed, preferring the node of the interrupt */
+static int irqbal_pick_target(struct irq_desc *desc, struct cpumask *allowed)
+{
+	int node = irq_desc_get_node(desc);
+	int cpu, best = -1, best_node = -1;
+	unsigned int load, min = UINT_MAX, min_node = UINT_MAX;
+
+	for_each_cpu(cpu, allowed) {
+		load = irqbal_load(per_cpu_ptr(&irqbal_cpu, cpu));
+		if (load < min) {
+			min = load;
+			best = cpu;
+		}
+		if (node != NUMA_NO_NODE && cpu_to_node(cpu) == node &&
+		    load < min_node) {
+			min_node = load;
+			best_node = cpu;
+		}
+	}
+	return best_node >= 0 ? best_node : best;
+}
+
+static void irqbal_log_move(struct irq_desc *desc, unsigned int rate,
+			    int from, int to)
+{
+	struct irqbal_move *m = &irqbal_log[irqbal_nr_moves % IRQBAL_LOG_SIZE];
+
+	m->when = jiffies;
+	m->irq = irq_desc_get_irq(desc);
+	m->rate = rate;
+	m->from = from;
+	m->to = to;
+	m->from_pct = irqbal_load(per_cpu_ptr(&irqbal_cpu, from));
+	m->to_pct = irqbal_load(per_cpu_ptr(&irqbal_cpu, to));
+	irqbal_nr_moves++;
+	per_cpu_ptr(&irqbal_cpu, from)->moved_out++;
+	per_cpu_ptr(&irqbal_cpu, to)->moved_in++;
+}
+
+static void irqbal_balance(void)
+{
+	cpumask_var_t allowed, done;
+	unsigned int moves = 0;
+	struct irq_desc *desc;
+	int irq;
+
+	if (!zalloc_cpumask_var(&allowed, GFP_KERNEL))
+		return;
+	if (!zalloc_cpumask_var(&done, GFP_KERNEL)) {
+		free_cpumask_var(allowed);
+		return;
+	}
+
+	/*
+	 * Each pass moves the busiest candidate off one saturated CPU. A CPU
+	 * which was a source or a target in this interval is not looked at
+	 * again until the next sample shows the effect of the move.
+	 */
+	while (moves < irqbal_max_moves) {
+		const struct cpumask *affinity;
+		struct irq_desc *best = NULL;
+		unsigned int best_rate = 0;
+		int from = -1, to;
+
+		for_each_irq_desc(irq, desc) {
+			unsigned int rate = desc->balance_rate;
+			int cpu;
+
+			if (rate < irqbal_min_rate || rate <= best_rate ||
+			    time_before(jiffies, desc->balance_next))
+				continue;
+
+			cpu = irqbal_movable(desc, allowed);
+			if (cpu < 0 || cpumask_test_cpu(cpu, done) ||
+			    per_cpu_ptr(&irqbal_cpu, cpu)->task_pct <
+			    irqbal_busy_pct)
+				continue;
+
+			best = desc;
+			best_rate = rate;
+			from = cpu;
+		}
+		if (!best)
+			break;
+
+		cpumask_set_cpu(from, done);
+		irqbal_movable(best, allowed);
+		cpumask_andnot(allowed, allowed, done);
+		to = irqbal_pick_target(best, allowed);
+		if (to < 0 ||
+		    irqbal_load(per_cpu_ptr(&irqbal_cpu, to)) + irqbal_headroom_pct >
+		    irqbal_load(per_cpu_ptr(&irqbal_cpu, from)))
+			continue;
+
+		best->balance_next = jiffies + msecs_to_jiffies(irqbal_cooldown_ms);
+		/* Remember the mask that later moves have to stay within */
+		affinity = irq_data_get_affinity_mask(&best->irq_data);
+		if (cpumask_weight(affinity) > 1)
+			cpumask_copy(best->balance_mask, affinity);
+		if (irq_set_affinity(irq_desc_get_irq(best), cpumask_of(to))) {
+			irqbal_nr_failed++;
+			continue;
+		}
+		best->balance_cpu = to;
+		cpumask_set_cpu(to, done);
+		irqbal_log_move(best, best_rate, from, to);
+		moves++;
+	}
+
+	free_cpumask_var(done);
+	free_cpumask_var(allowed);
+}
+
+static void irqbal_workfn(struct work_struct *work)
+{
+	u64 now = ktime_get_ns();
+
+	if (!READ_ONCE(irqbal_enabled))
+		return;
+
+	mutex_lock(&irqbal_mutex);
+	cpus_read_lock();
+	irq_lock_sparse();
+	irqbal_sample_cpus(now - irqbal_last_sample);
+	/* The first sample after enabling only sets the baseline */
+	if (irqbal_last_sample)
+		irqbal_balance();
+	irq_unlock_sparse();
+	cpus_read_unlock();
+	irqbal_last_sample = now;
+	mutex_unlock(&irqbal_mutex);
+
+	queue_delayed_work(system_unbound_wq, &irqbal_work,
+			   msecs_to_jiffies(max(irqbal_interval_ms, 10U)));
+}
+
+static int irqbal_set_enabled(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_bool(val, kp);
+
+	if (ret || !irqbal_enabled)
+		return ret;
+
+	/* Too early, irqbal_init() will start it */
+	if (system_state < SYSTEM_RUNNING)
+		return 0;
+
+	mutex_lock(&irqbal_mutex);
+	irqbal_last_sample = 0;
+	mutex_unlock(&irqbal_mutex);
+	mod_delayed_work(system_unbound_wq, &irqbal_work, 0);
+	return 0;
+}
+
+static const struct kernel_param_ops irqbal_enabled_ops = {
+	.set	= irqbal_set_enabled,
+	.get	= param_get_bool,
+};
+module_param_cb(enabled, &irqbal_enabled_ops, &irqbal_enabled, 0644);
+MODULE_PARM_DESC(enabled, "Enable the in-kernel interrupt balancer");
+
+static int irqbal_show(struct seq_file *m, void *v)
+{
+	unsigned long nr, i;
+	int cpu;
+
+	mutex_lock(&irqbal_mutex);
+	seq_printf(m, "enabled: %d\nmoves: %lu\nfailed: %lu\n",
+		   irqbal_enabled, irqbal_nr_moves, irqbal_nr_failed);
+
+	seq_puts(m, "\ncpu task% softirq% irq% moved_in moved_out\n");
+	for_each_online_cpu(cpu) {
+		struct irqbal_cpu *ic = per_cpu_ptr(&irqbal_cpu, cpu);
+
+		seq_printf(m, "%d %u %u %u %lu %lu\n", cpu, ic->task_pct,
+			   ic->softirq_pct, ic->hardirq_pct, ic->moved_in,
+			   ic->moved_out);
+	}
+
+	seq_puts(m, "\nage_ms irq rate from to from_load% to_load%\n");
+	nr = min_t(unsigned long, irqbal_nr_moves, IRQBAL_LOG_SIZE);
+	for (i = 0; i < nr; i++) {
+		struct irqbal_move *mv;
+
+		mv = &irqbal_log[(irqbal_nr_moves - 1 - i) % IRQBAL_LOG_SIZE];
+		seq_printf(m, "%u %u %u %d %d %u %u\n",
+			   jiffies_to_msecs(jiffies - mv->when), mv->irq,
+			   mv->rate, mv->from, mv->to, mv->from_pct, mv->to_pct);
+	}
+	mutex_unlock(&irqbal_mutex);
+	return 0;
+}
+
+static int __init irqbal_init(void)
+{
+	proc_create_single("irq/balance", 0444, NULL, irqbal_show);
+	if (irqbal_enabled)
+		queue_delayed_work(system_unbound_wq, &irqbal_work, 0);
+	return 0;
+}
+late_initcall(irqbal_init);
@@ -68,6 +68,19 @@ static int alloc_masks(struct irq_desc *desc, int node)
 
 #ifdef CONFIG_GENERIC_PENDING_IRQ
 	if (!zalloc_cpumask_var_node(&desc->pending_mask, GFP_KERNEL, node)) {
+#ifdef CONFIG_GENERIC_IRQ_EFFECTIVE_AFF_MASK
+		free_cpumask_var(desc->irq_common_data.effective_affinity);
+#endif
+		free_cpumask_var(desc->irq_common_data.affinity);
+		return -ENOMEM;
+	}
+#endif
+
+#ifdef CONFIG_IRQ_BALANCE
+	if (!zalloc_cpumask_var_node(&desc->balance_mask, GFP_KERNEL, node)) {
+#ifdef CONFIG_GENERIC_PENDING_IRQ
+		free_cpumask_var(desc->pending_mask);
+#endif
 #ifdef CONFIG_GENERIC_IRQ_EFFECTIVE_AFF_MASK
 		free_cpumask_var(desc->irq_common_data.effective_affinity);
 #endif
@@ -120,6 +133,12 @@ static void desc_set_defaults(unsigned int irq, struct irq_desc *desc, int node,
 	desc->irq_count = 0;
 	desc->irqs_unhandled = 0;
 	desc->tot_count = 0;
+#ifdef CONFIG_IRQ_BALANCE
+	desc->balance_count = 0;
+	desc->balance_rate = 0;
+	desc->balance_cpu = -1;
+	desc->balance_next = jiffies;
+#endif
 	desc->name = NULL;
 	desc->owner = owner;
 	for_each_possible_cpu(cpu)
@@ -362,6 +381,9 @@ static void delete_irq_desc(unsigned int irq)
 #ifdef CONFIG_SMP
 static void free_masks(struct irq_desc *desc)
 {
+#ifdef CONFIG_IRQ_BALANCE
+	free_cpumask_var(desc->balance_mask);
+#endif
 #ifdef CONFIG_GENERIC_PENDING_IRQ
 	free_cpumask_var(desc->pending_mask);
 #endif
@@ -26,8 +26,6 @@
 #undef  LOCK_EVENT
 #define LOCK_EVENT(name)	[LOCKEVENT_ ## name] = #name,
 
-#define LOCK_EVENTS_DIR		"lock_event_counts"
-
 /*
  * When CONFIG_LOCK_EVENT_COUNTS is enabled, event counts of different
  * types of locks will be reported under the <debugfs>/lock_event_counts/
@@ -103,6 +101,7 @@ static ssize_t lockevent_write(struct file *file, const char __user *user_buf,
 		for (i = 0 ; i < lockevent_num; i++)
 			WRITE_ONCE(ptr[i], 0);
 	}
+	rwsem_class_stats_reset();
 	return count;
 }
 
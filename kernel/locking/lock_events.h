@@ -50,6 +50,14 @@ static inline void __lockevent_add(enum lock_events event, int inc)
 
 #define lockevent_add(ev, c)	__lockevent_add(LOCKEVENT_ ##ev, c)
 
+#define LOCK_EVENTS_DIR		"lock_event_counts"
+
+#ifdef CONFIG_RWSEM_CLASS_STATS
+extern void rwsem_class_stats_reset(void);
+#else
+static inline void rwsem_class_stats_reset(void) { }
+#endif
+
 #else  /* CONFIG_LOCK_EVENT_COUNTS */
 
 #define lockevent_inc(ev)
@@ -35,6 +35,14 @@ LOCK_EVENT(pv_wait_head)	/* # of vCPU wait's at the queue head	   */
 LOCK_EVENT(pv_wait_node)	/* # of vCPU wait's at non-head queue node */
 #endif /* CONFIG_PARAVIRT_SPINLOCKS */
 
+#ifdef CONFIG_NUMA_AWARE_SPINLOCKS
+/*
+ * Locking events for CNA qspinlock.
+ */
+LOCK_EVENT(lock_cna_move)	/* # of waiters moved to the secondary queue */
+LOCK_EVENT(lock_cna_flush)	/* # of secondary queue flushes (fairness)   */
+#endif /* CONFIG_NUMA_AWARE_SPINLOCKS */
+
 /*
  * Locking events for qspinlock
  *
@@ -59,6 +67,9 @@ LOCK_EVENT(rwsem_wake_writer)	/* # of writer wakeups			*/
 LOCK_EVENT(rwsem_opt_rlock)	/* # of opt-acquired read locks		*/
 LOCK_EVENT(rwsem_opt_wlock)	/* # of opt-acquired write locks	*/
 LOCK_EVENT(rwsem_opt_fail)	/* # of failed optspins			*/
+LOCK_EVENT(rwsem_opt_fail_resched) /* # of optspins skipped, need_resched */
+LOCK_EVENT(rwsem_opt_fail_nospin) /* # of optspins skipped, nonspinnable */
+LOCK_EVENT(rwsem_opt_fail_owner) /* # of optspins skipped, owner off-cpu */
 LOCK_EVENT(rwsem_opt_nospin)	/* # of disabled optspins		*/
 LOCK_EVENT(rwsem_opt_norspin)	/* # of disabled reader-only optspins	*/
 LOCK_EVENT(rwsem_opt_rlock2)	/* # of opt-acquired 2ndary read locks	*/
@@ -69,3 +80,4 @@ LOCK_EVENT(rwsem_rlock_handoff)	/* # of read lock handoffs		*/
 LOCK_EVENT(rwsem_wlock)		/* # of write locks acquired		*/
 LOCK_EVENT(rwsem_wlock_fail)	/* # of failed write lock acquisitions	*/
 LOCK_EVENT(rwsem_wlock_handoff)	/* # of write lock handoffs		*/
+LOCK_EVENT(rwsem_class_overflow) /* # of rwsem class table misses	*/
@@ -37,6 +37,8 @@ torture_param(int, nwriters_stress, -1,
 	     "Number of write-locking stress-test threads");
 torture_param(int, nreaders_stress, -1,
 	     "Number of read-locking stress-test threads");
+torture_param(int, long_hold, 100,
+	     "Do occasional long hold of spinlock (ms), 0=disable");
 torture_param(int, onoff_holdoff, 0, "Time after boot before CPU hotplugs (s)");
 torture_param(int, onoff_interval, 0,
 	     "Time between CPU hotplugs (s), 0=disable");
@@ -61,6 +63,14 @@ static struct task_struct **reader_tasks;
 static bool lock_is_write_held;
 static bool lock_is_read_held;
 
+/*
+ * NUMA node of the last writer and number of times the lock passed to a
+ * writer on another node, both protected by the write lock. Shows how
+ * well a NUMA-aware lock keeps the lock on one node.
+ */
+static int lock_write_node = NUMA_NO_NODE;
+static long n_lock_node_handoffs;
+
 struct lock_stress_stats {
 	long n_lock_fail;
 	long n_lock_acquired;
@@ -151,14 +161,14 @@ static int torture_spin_lock_write_lock(void) __acquires(torture_spinlock)
 static void torture_spin_lock_write_delay(struct torture_random_state *trsp)
 {
 	const unsigned long shortdelay_us = 2;
-	const unsigned long longdelay_ms = 100;
 
 	/* We want a short delay mostly to emulate likely code, and
 	 * we want a long delay occasionally to force massive contention.
+	 * The latter is optional, it skews lock throughput comparisons.
 	 */
-	if (!(torture_random(trsp) %
-	      (cxt.nrealwriters_stress * 2000 * longdelay_ms)))
-		mdelay(longdelay_ms);
+	if (long_hold && !(torture_random(trsp) %
+			   (cxt.nrealwriters_stress * 2000 * long_hold)))
+		mdelay(long_hold);
 	if (!(torture_random(trsp) %
 	      (cxt.nrealwriters_stress * 2 * shortdelay_us)))
 		udelay(shortdelay_us);
@@ -630,6 +640,11 @@ static int lock_torture_writer(void *arg)
 			lwsp->n_lock_fail++; /* rare, but... */
 
 		lwsp->n_lock_acquired++;
+		if (lock_write_node != numa_node_id()) {
+			if (lock_write_node != NUMA_NO_NODE)
+				n_lock_node_handoffs++;
+			lock_write_node = numa_node_id();
+		}
 		cxt.cur_ops->write_delay(&rand);
 		lock_is_write_held = false;
 		cxt.cur_ops->writeunlock();
@@ -732,6 +747,10 @@ static void lock_torture_stats_print(void)
 	pr_alert("%s", buf);
 	kfree(buf);
 
+	if (nr_node_ids > 1)
+		pr_alert("Writes:  Cross-node handoffs: %ld\n",
+			 READ_ONCE(n_lock_node_handoffs));
+
 	if (cxt.cur_ops->readlock) {
 		buf = kmalloc(size, GFP_KERNEL);
 		if (!buf) {
@@ -770,11 +789,11 @@ lock_torture_print_module_parms(struct lock_torture_ops *cur_ops,
 				const char *tag)
 {
 	pr_alert("%s" TORTURE_FLAG
-		 "--- %s%s: nwriters_stress=%d nreaders_stress=%d stat_interval=%d verbose=%d shuffle_interval=%d stutter=%d shutdown_secs=%d onoff_interval=%d onoff_holdoff=%d\n",
+		 "--- %s%s: nwriters_stress=%d nreaders_stress=%d stat_interval=%d verbose=%d shuffle_interval=%d stutter=%d shutdown_secs=%d onoff_interval=%d onoff_holdoff=%d long_hold=%d\n",
 		 torture_type, tag, cxt.debug_lock ? " [debug]": "",
 		 cxt.nrealwriters_stress, cxt.nrealreaders_stress, stat_interval,
 		 verbose, shuffle_interval, stutter, shutdown_secs,
-		 onoff_interval, onoff_holdoff);
+		 onoff_interval, onoff_holdoff, long_hold);
 }
 
 static void lock_torture_cleanup(void)
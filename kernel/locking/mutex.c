@@ -101,6 +101,24 @@ static inline unsigned long __owner_flags(unsigned long owner)
 	return owner & MUTEX_FLAGS;
 }
 
+/*
+ * Before blocking, lend our slot to a preempted owner so that it can get
+ * on with releasing the lock; see sched_proxy_donate().
+ */
+static void mutex_proxy_donate(struct mutex *lock)
+{
+	struct task_struct *owner;
+
+	if (!IS_ENABLED(CONFIG_SCHED_PROXY_EXEC))
+		return;
+
+	rcu_read_lock();
+	owner = __mutex_owner(lock);
+	if (owner && owner != current)
+		sched_proxy_donate(owner);
+	rcu_read_unlock();
+}
+
 /*
  * Trylock variant that retuns the owning task on failure.
  */
@@ -1042,6 +1060,7 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 		}
 
 		spin_unlock(&lock->wait_lock);
+		mutex_proxy_donate(lock);
 		schedule_preempt_disabled();
 
 		/*
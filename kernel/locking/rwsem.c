@@ -27,6 +27,9 @@
 #include <linux/export.h>
 #include <linux/rwsem.h>
 #include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/hash.h>
+#include <linux/seq_file.h>
 
 #include "lock_events.h"
 
@@ -300,6 +303,26 @@ rwsem_owner_flags(struct rw_semaphore *sem, unsigned long *pflags)
 	return (struct task_struct *)(owner & ~RWSEM_OWNER_FLAGS_MASK);
 }
 
+/*
+ * Before blocking, lend our slot to a preempted writer owner so that it can
+ * get on with releasing the lock; see sched_proxy_donate(). Reader owners
+ * are not tracked precisely enough to do the same for them.
+ */
+static void rwsem_proxy_donate(struct rw_semaphore *sem)
+{
+	struct task_struct *owner;
+	unsigned long flags;
+
+	if (!IS_ENABLED(CONFIG_SCHED_PROXY_EXEC))
+		return;
+
+	rcu_read_lock();
+	owner = rwsem_owner_flags(sem, &flags);
+	if (owner && owner != current && !(flags & RWSEM_READER_OWNED))
+		sched_proxy_donate(owner);
+	rcu_read_unlock();
+}
+
 /*
  * Guide to the rw_semaphore's count field.
  *
@@ -340,6 +363,9 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	osq_lock_init(&sem->osq);
 #endif
+#ifdef CONFIG_RWSEM_CLASS_STATS
+	sem->stat_name = name;
+#endif
 }
 EXPORT_SYMBOL(__init_rwsem);
 
@@ -358,6 +384,209 @@ struct rwsem_waiter {
 #define rwsem_first_waiter(sem) \
 	list_first_entry(&sem->wait_list, struct rwsem_waiter, list)
 
+/* Lock type index of the per class statistics */
+enum {
+	RWSEM_STAT_READ,
+	RWSEM_STAT_WRITE,
+	RWSEM_STAT_NR,
+};
+
+#ifdef CONFIG_RWSEM_CLASS_STATS
+/*
+ * Per lock class contention statistics.
+ *
+ * A class is identified by the name given to init_rwsem()/DECLARE_RWSEM(),
+ * i.e. by the address of a string literal, so all inodes' i_rwsem's share
+ * one entry, as do all the mmap_lock's. Entries are allocated lazily, the
+ * first time a lock of that class enters a slowpath, from a fixed size
+ * open addressed table and are never freed. The name is copied into the
+ * entry, since it may live in a module that goes away before the entry
+ * does. Only contended acquisitions are accounted, the fast paths are not
+ * touched.
+ *
+ * The statistics are reported in <debugfs>/lock_event_counts/rwsem_classes
+ * and cleared together with the other lock event counts.
+ */
+#define RWSEM_CLASS_HASH_BITS	9
+#define RWSEM_CLASS_HASH_SIZE	(1 << RWSEM_CLASS_HASH_BITS)
+#define RWSEM_CLASS_PROBES	8
+#define RWSEM_STAT_BUCKETS	16	/* log2(usecs) wait time buckets */
+#define RWSEM_CLASS_NAME_LEN	48
+
+struct rwsem_class_stat {
+	const char	*key;		/* sem->stat_name, never dereferenced */
+	int		named;		/* name[] is valid */
+	char		name[RWSEM_CLASS_NAME_LEN];
+	atomic_long_t	waits[RWSEM_STAT_NR];
+	atomic_long_t	wait_ns[RWSEM_STAT_NR];
+	atomic_long_t	spins[RWSEM_STAT_NR];
+	atomic_long_t	spins_taken[RWSEM_STAT_NR];
+	atomic_long_t	handoffs[RWSEM_STAT_NR];
+	atomic_long_t	hist[RWSEM_STAT_NR][RWSEM_STAT_BUCKETS];
+};
+
+static struct rwsem_class_stat rwsem_class_stats[RWSEM_CLASS_HASH_SIZE];
+
+static struct rwsem_class_stat *rwsem_class_stat(struct rw_semaphore *sem)
+{
+	const char *name = READ_ONCE(sem->stat_name);
+	unsigned long idx;
+	int i;
+
+	if (!name)
+		return NULL;
+
+	idx = hash_ptr(name, RWSEM_CLASS_HASH_BITS);
+	for (i = 0; i < RWSEM_CLASS_PROBES; i++) {
+		struct rwsem_class_stat *stat = &rwsem_class_stats[idx];
+		const char *old = READ_ONCE(stat->key);
+
+		if (!old) {
+			old = cmpxchg(&stat->key, NULL, name);
+			if (!old) {
+				strscpy(stat->name, name, sizeof(stat->name));
+				smp_store_release(&stat->named, 1);
+				return stat;
+			}
+		}
+		if (old == name)
+			return stat;
+		idx = (idx + 1) & (RWSEM_CLASS_HASH_SIZE - 1);
+	}
+	lockevent_inc(rwsem_class_overflow);
+	return NULL;
+}
+
+static inline u64 rwsem_stat_clock(void)
+{
+	return local_clock();
+}
+
+static void rwsem_stat_wait(struct rw_semaphore *sem, int type, u64 start)
+{
+	struct rwsem_class_stat *stat = rwsem_class_stat(sem);
+	u64 delta = local_clock() - start;
+	unsigned long us = delta / NSEC_PER_USEC;
+	int bucket = us ? min(ilog2(us) + 1, RWSEM_STAT_BUCKETS - 1) : 0;
+
+	if (!stat)
+		return;
+	atomic_long_inc(&stat->waits[type]);
+	atomic_long_add(delta, &stat->wait_ns[type]);
+	atomic_long_inc(&stat->hist[type][bucket]);
+}
+
+static void rwsem_stat_spin(struct rw_semaphore *sem, int type, bool taken)
+{
+	struct rwsem_class_stat *stat = rwsem_class_stat(sem);
+
+	if (!stat)
+		return;
+	atomic_long_inc(&stat->spins[type]);
+	if (taken)
+		atomic_long_inc(&stat->spins_taken[type]);
+}
+
+static void rwsem_stat_handoff(struct rw_semaphore *sem, int type)
+{
+	struct rwsem_class_stat *stat = rwsem_class_stat(sem);
+
+	if (stat)
+		atomic_long_inc(&stat->handoffs[type]);
+}
+
+/*
+ * Called from the lock_event_counts .reset_counts handler. The class
+ * slots themselves are kept, only their counts are cleared.
+ */
+void rwsem_class_stats_reset(void)
+{
+	int i, t, b;
+
+	for (i = 0; i < RWSEM_CLASS_HASH_SIZE; i++) {
+		struct rwsem_class_stat *stat = &rwsem_class_stats[i];
+
+		if (!READ_ONCE(stat->key))
+			continue;
+		for (t = 0; t < RWSEM_STAT_NR; t++) {
+			atomic_long_set(&stat->waits[t], 0);
+			atomic_long_set(&stat->wait_ns[t], 0);
+			atomic_long_set(&stat->spins[t], 0);
+			atomic_long_set(&stat->spins_taken[t], 0);
+			atomic_long_set(&stat->handoffs[t], 0);
+			for (b = 0; b < RWSEM_STAT_BUCKETS; b++)
+				atomic_long_set(&stat->hist[t][b], 0);
+		}
+	}
+}
+
+/*
+ * One line per class and lock type:
+ *
+ *   class type waits wait_ns spins spins_taken handoffs hist[0] .. hist[15]
+ *
+ * hist[0] counts waits shorter than 1us, hist[i] waits shorter than 2^i us
+ * and the last bucket everything longer.
+ */
+static int rwsem_classes_show(struct seq_file *m, void *v)
+{
+	static const char * const type_names[RWSEM_STAT_NR] = {
+		[RWSEM_STAT_READ]	= "read",
+		[RWSEM_STAT_WRITE]	= "write",
+	};
+	int i, t, b;
+
+	seq_puts(m, "# class type waits wait_ns spins spins_taken handoffs hist[log2 usecs]\n");
+	for (i = 0; i < RWSEM_CLASS_HASH_SIZE; i++) {
+		struct rwsem_class_stat *stat = &rwsem_class_stats[i];
+
+		if (!smp_load_acquire(&stat->named))
+			continue;
+		for (t = 0; t < RWSEM_STAT_NR; t++) {
+			seq_printf(m, "%s %s %ld %ld %ld %ld %ld", stat->name,
+				   type_names[t],
+				   atomic_long_read(&stat->waits[t]),
+				   atomic_long_read(&stat->wait_ns[t]),
+				   atomic_long_read(&stat->spins[t]),
+				   atomic_long_read(&stat->spins_taken[t]),
+				   atomic_long_read(&stat->handoffs[t]));
+			for (b = 0; b < RWSEM_STAT_BUCKETS; b++)
+				seq_printf(m, " %ld",
+					   atomic_long_read(&stat->hist[t][b]));
+			seq_putc(m, '\n');
+		}
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rwsem_classes);
+
+static int __init rwsem_class_stats_init(void)
+{
+	struct dentry *dir = debugfs_lookup(LOCK_EVENTS_DIR, NULL);
+
+	if (!dir)
+		return 0;
+	debugfs_create_file("rwsem_classes", 0400, dir, NULL,
+			    &rwsem_classes_fops);
+	dput(dir);
+	return 0;
+}
+late_initcall(rwsem_class_stats_init);
+
+#else /* !CONFIG_RWSEM_CLASS_STATS */
+
+static inline u64 rwsem_stat_clock(void)
+{
+	return 0;
+}
+
+static inline void
+rwsem_stat_wait(struct rw_semaphore *sem, int type, u64 start) { }
+static inline void
+rwsem_stat_spin(struct rw_semaphore *sem, int type, bool taken) { }
+static inline void rwsem_stat_handoff(struct rw_semaphore *sem, int type) { }
+#endif /* CONFIG_RWSEM_CLASS_STATS */
+
 enum rwsem_wake_type {
 	RWSEM_WAKE_ANY,		/* Wake whatever's at head of wait list */
 	RWSEM_WAKE_READERS,	/* Wake readers only */
@@ -455,6 +684,7 @@ static void rwsem_mark_wake(struct rw_semaphore *sem,
 			    time_after(jiffies, waiter->timeout)) {
 				adjustment -= RWSEM_FLAG_HANDOFF;
 				lockevent_inc(rwsem_rlock_handoff);
+				rwsem_stat_handoff(sem, RWSEM_STAT_READ);
 			}
 
 			atomic_long_add(-adjustment, &sem->count);
@@ -661,6 +891,7 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem,
 
 	if (need_resched()) {
 		lockevent_inc(rwsem_opt_fail);
+		lockevent_inc(rwsem_opt_fail_resched);
 		return false;
 	}
 
@@ -670,9 +901,14 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem,
 	/*
 	 * Don't check the read-owner as the entry may be stale.
 	 */
-	if ((flags & nonspinnable) ||
-	    (owner && !(flags & RWSEM_READER_OWNED) && !owner_on_cpu(owner)))
+	if (flags & nonspinnable) {
+		lockevent_inc(rwsem_opt_fail_nospin);
 		ret = false;
+	} else if (owner && !(flags & RWSEM_READER_OWNED) &&
+		   !owner_on_cpu(owner)) {
+		lockevent_inc(rwsem_opt_fail_owner);
+		ret = false;
+	}
 	rcu_read_unlock();
 	preempt_enable();
 
@@ -912,6 +1148,7 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem, bool wlock)
 done:
 	preempt_enable();
 	lockevent_cond_inc(rwsem_opt_fail, !taken);
+	rwsem_stat_spin(sem, wlock ? RWSEM_STAT_WRITE : RWSEM_STAT_READ, taken);
 	return taken;
 }
 
@@ -1004,6 +1241,7 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, int state)
 	struct rwsem_waiter waiter;
 	DEFINE_WAKE_Q(wake_q);
 	bool wake = false;
+	u64 start = rwsem_stat_clock();
 
 	/*
 	 * Save the current read-owner of rwsem, if available, and the
@@ -1035,9 +1273,11 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, int state)
 			raw_spin_unlock_irq(&sem->wait_lock);
 			wake_up_q(&wake_q);
 		}
+		rwsem_stat_wait(sem, RWSEM_STAT_READ, start);
 		return sem;
 	} else if (rwsem_reader_phase_trylock(sem, waiter.last_rowner)) {
 		/* rwsem_reader_phase_trylock() implies ACQUIRE on success */
+		rwsem_stat_wait(sem, RWSEM_STAT_READ, start);
 		return sem;
 	}
 
@@ -1061,6 +1301,7 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, int state)
 			raw_spin_unlock_irq(&sem->wait_lock);
 			rwsem_set_reader_owned(sem);
 			lockevent_inc(rwsem_rlock_fast);
+			rwsem_stat_wait(sem, RWSEM_STAT_READ, start);
 			return sem;
 		}
 		adjustment += RWSEM_FLAG_WAITERS;
@@ -1105,12 +1346,14 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, int state)
 			/* Ordered by sem->wait_lock against rwsem_mark_wake(). */
 			break;
 		}
+		rwsem_proxy_donate(sem);
 		schedule();
 		lockevent_inc(rwsem_sleep_reader);
 	}
 
 	__set_current_state(TASK_RUNNING);
 	lockevent_inc(rwsem_rlock);
+	rwsem_stat_wait(sem, RWSEM_STAT_READ, start);
 	return sem;
 
 out_nolock:
@@ -1150,11 +1393,13 @@ rwsem_down_write_slowpath(struct rw_semaphore *sem, int state)
 	struct rwsem_waiter waiter;
 	struct rw_semaphore *ret = sem;
 	DEFINE_WAKE_Q(wake_q);
+	u64 start = rwsem_stat_clock();
 
 	/* do optimistic spinning and steal lock if possible */
 	if (rwsem_can_spin_on_owner(sem, RWSEM_WR_NONSPINNABLE) &&
 	    rwsem_optimistic_spin(sem, true)) {
 		/* rwsem_optimistic_spin() implies ACQUIRE on success */
+		rwsem_stat_wait(sem, RWSEM_STAT_WRITE, start);
 		return sem;
 	}
 
@@ -1241,6 +1486,7 @@ rwsem_down_write_slowpath(struct rw_semaphore *sem, int state)
 			if (signal_pending_state(state, current))
 				goto out_nolock;
 
+			rwsem_proxy_donate(sem);
 			schedule();
 			lockevent_inc(rwsem_sleep_writer);
 			set_current_state(state);
@@ -1267,6 +1513,7 @@ rwsem_down_write_slowpath(struct rw_semaphore *sem, int state)
 			    time_after(jiffies, waiter.timeout))) {
 				wstate = WRITER_HANDOFF;
 				lockevent_inc(rwsem_wlock_handoff);
+				rwsem_stat_handoff(sem, RWSEM_STAT_WRITE);
 				break;
 			}
 		}
@@ -1278,6 +1525,7 @@ rwsem_down_write_slowpath(struct rw_semaphore *sem, int state)
 	rwsem_disable_reader_optspin(sem, disable_rspin);
 	raw_spin_unlock_irq(&sem->wait_lock);
 	lockevent_inc(rwsem_wlock);
+	rwsem_stat_wait(sem, RWSEM_STAT_WRITE, start);
 
 	return ret;
 
@@ -3037,9 +3037,207 @@ void call_rcu(struct rcu_head *head, rcu_callback_t func)
 }
 EXPORT_SYMBOL_GPL(call_rcu);
 
+#ifdef CONFIG_RCU_LAZY
+/*
+ * Lazy callbacks are parked on a per-CPU list and only handed to RCU once
+ * jiffies_lazy_flush has elapsed, qlazy of them have piled up on that CPU,
+ * memory runs low or rcu_barrier() needs them. Zero jiffies_lazy_flush
+ * makes call_rcu_lazy() behave like call_rcu().
+ */
+static ulong jiffies_lazy_flush = 10 * HZ;
+module_param(jiffies_lazy_flush, ulong, 0444);
+static long qlazy = 10000;
+module_param(qlazy, long, 0444);
+
+/**
+ * struct rcu_lazy_cpu - per-CPU list of callbacks not yet handed to RCU
+ * @lock: Synchronize access to this structure
+ * @head: First parked callback
+ * @tail: Where to link the next parked callback
+ * @count: Number of parked callbacks
+ * @inflight: Number of flushes between taking the list and queueing it
+ * @timer: Flush the list jiffies_lazy_flush after it became non-empty
+ */
+struct rcu_lazy_cpu {
+	raw_spinlock_t lock;
+	struct rcu_head *head;
+	struct rcu_head **tail;
+	long count;
+	atomic_t inflight;
+	struct timer_list timer;
+};
+
+static DEFINE_PER_CPU(struct rcu_lazy_cpu, rcu_lazy) = {
+	.lock = __RAW_SPIN_LOCK_UNLOCKED(rcu_lazy.lock),
+};
+
+/*
+ * Hand all callbacks parked on @rlp to RCU, returning how many there were.
+ *
+ * The list is taken under the lock but queued after dropping it, so that
+ * interrupts are not held off for up to qlazy __call_rcu()s. Until they
+ * are all queued, rlp->inflight tells rcu_barrier() to wait for them.
+ */
+static long rcu_lazy_flush(struct rcu_lazy_cpu *rlp)
+{
+	struct rcu_head *head, *next;
+	unsigned long flags;
+	long count;
+
+	raw_spin_lock_irqsave(&rlp->lock, flags);
+	head = rlp->head;
+	count = rlp->count;
+	if (head)
+		atomic_inc(&rlp->inflight);
+	rlp->head = NULL;
+	rlp->tail = &rlp->head;
+	WRITE_ONCE(rlp->count, 0);
+	raw_spin_unlock_irqrestore(&rlp->lock, flags);
+
+	if (!head)
+		return 0;
+
+	for (; head; head = next) {
+		next = head->next;
+		__call_rcu(head, head->func);
+	}
+
+	smp_mb__before_atomic(); /* Callbacks queued before the decrement. */
+	atomic_dec(&rlp->inflight);
+
+	return count;
+}
+
+static void rcu_lazy_flush_all(void)
+{
+	struct rcu_lazy_cpu *rlp;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rlp = per_cpu_ptr(&rcu_lazy, cpu);
+		rcu_lazy_flush(rlp);
+
+		/* A flush by someone else may still be queueing its list. */
+		while (atomic_read(&rlp->inflight))
+			schedule_timeout_uninterruptible(1);
+	}
+	smp_mb(); /* Queued callbacks seen by the caller's cblist checks. */
+}
+
+static void rcu_lazy_timer(struct timer_list *t)
+{
+	struct rcu_lazy_cpu *rlp = from_timer(rlp, t, timer);
+
+	rcu_lazy_flush(rlp);
+}
+
+/**
+ * call_rcu_lazy() - Queue a non-urgent RCU callback.
+ * @head: structure to be used for queueing the RCU updates.
+ * @func: actual callback function to be invoked after the grace period
+ *
+ * Like call_rcu(), except that the grace period may be started up to
+ * rcutree.jiffies_lazy_flush jiffies later. Only use this for callbacks
+ * whose sole purpose is freeing memory, such as kfree()-style callbacks:
+ * nothing may wait for their invocation other than rcu_barrier().
+ */
+void call_rcu_lazy(struct rcu_head *head, rcu_callback_t func)
+{
+	struct rcu_lazy_cpu *rlp;
+	unsigned long flags;
+	bool flush;
+
+	if (rcu_scheduler_active != RCU_SCHEDULER_RUNNING ||
+	    !jiffies_lazy_flush) {
+		__call_rcu(head, func);
+		return;
+	}
+
+	head->func = func;
+	head->next = NULL;
+
+	local_irq_save(flags);
+	rlp = this_cpu_ptr(&rcu_lazy);
+	raw_spin_lock(&rlp->lock);
+	*rlp->tail = head;
+	rlp->tail = &head->next;
+	WRITE_ONCE(rlp->count, rlp->count + 1);
+	flush = rlp->count >= qlazy;
+	if (!flush && !timer_pending(&rlp->timer))
+		mod_timer(&rlp->timer, jiffies + jiffies_lazy_flush);
+	raw_spin_unlock_irqrestore(&rlp->lock, flags);
+
+	if (flush)
+		rcu_lazy_flush(rlp);
+}
+EXPORT_SYMBOL_GPL(call_rcu_lazy);
+
+static unsigned long
+rcu_lazy_shrink_count(struct shrinker *shrink, struct shrink_control *sc)
+{
+	unsigned long count = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		count += READ_ONCE(per_cpu_ptr(&rcu_lazy, cpu)->count);
+
+	return count;
+}
+
+static unsigned long
+rcu_lazy_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
+{
+	unsigned long freed = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct rcu_lazy_cpu *rlp = per_cpu_ptr(&rcu_lazy, cpu);
+
+		if (!READ_ONCE(rlp->count))
+			continue;
+
+		freed += rcu_lazy_flush(rlp);
+		if (freed >= sc->nr_to_scan)
+			break;
+	}
+
+	return freed == 0 ? SHRINK_STOP : freed;
+}
+
+static struct shrinker rcu_lazy_shrinker = {
+	.count_objects = rcu_lazy_shrink_count,
+	.scan_objects = rcu_lazy_shrink_scan,
+	.batch = 0,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static void __init rcu_lazy_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct rcu_lazy_cpu *rlp = per_cpu_ptr(&rcu_lazy, cpu);
+
+		rlp->tail = &rlp->head;
+		timer_setup(&rlp->timer, rcu_lazy_timer, 0);
+	}
+	if (register_shrinker(&rcu_lazy_shrinker))
+		pr_err("Failed to register call_rcu_lazy() shrinker!\n");
+}
+#else
+static inline void rcu_lazy_flush_all(void) { }
+static inline void rcu_lazy_init(void) { }
+#endif /* CONFIG_RCU_LAZY */
+
 
 /* Maximum number of jiffies to wait before draining a batch. */
+#ifdef CONFIG_RCU_LAZY
+#define KFREE_DRAIN_JIFFIES (5 * HZ)
+#else
 #define KFREE_DRAIN_JIFFIES (HZ / 50)
+#endif
+/* How long to wait for the previous batch before trying again. */
+#define KFREE_RETRY_JIFFIES (HZ / 50)
 #define KFREE_N_BATCHES 2
 #define FREE_N_CHANNELS 2
 
@@ -3343,7 +3541,7 @@ static inline void kfree_rcu_drain_unlock(struct kfree_rcu_cpu *krcp,
 
 	// Previous RCU batch still in progress, try again later.
 	krcp->monitor_todo = true;
-	schedule_delayed_work(&krcp->monitor_work, KFREE_DRAIN_JIFFIES);
+	schedule_delayed_work(&krcp->monitor_work, KFREE_RETRY_JIFFIES);
 	raw_spin_unlock_irqrestore(&krcp->lock, flags);
 }
 
@@ -3512,11 +3710,16 @@ void kvfree_call_rcu(struct rcu_head *head, rcu_callback_t func)
 
 	WRITE_ONCE(krcp->count, krcp->count + 1);
 
-	// Set timer to drain after KFREE_DRAIN_JIFFIES.
-	if (rcu_scheduler_active == RCU_SCHEDULER_RUNNING &&
-	    !krcp->monitor_todo) {
-		krcp->monitor_todo = true;
-		schedule_delayed_work(&krcp->monitor_work, KFREE_DRAIN_JIFFIES);
+	// Set timer to drain after KFREE_DRAIN_JIFFIES, and with lazy
+	// draining, right away once a full page of pointers has piled up.
+	if (rcu_scheduler_active == RCU_SCHEDULER_RUNNING) {
+		if (!krcp->monitor_todo) {
+			krcp->monitor_todo = true;
+			schedule_delayed_work(&krcp->monitor_work, KFREE_DRAIN_JIFFIES);
+		} else if (IS_ENABLED(CONFIG_RCU_LAZY) &&
+			   krcp->count == KVFREE_BULK_MAX_ENTR) {
+			mod_delayed_work(system_wq, &krcp->monitor_work, 0);
+		}
 	}
 
 unlock_return:
@@ -3855,6 +4058,9 @@ void rcu_barrier(void)
 	rcu_seq_start(&rcu_state.barrier_sequence);
 	rcu_barrier_trace(TPS("Inc1"), -1, rcu_state.barrier_sequence);
 
+	/* Lazy callbacks must be queued for the barrier to wait for them. */
+	rcu_lazy_flush_all();
+
 	/*
 	 * Initialize the count to two rather than to zero in order
 	 * to avoid a too-soon return to zero in case of an immediate
@@ -4512,6 +4718,7 @@ void __init rcu_init(void)
 	rcu_early_boot_tests();
 
 	kfree_rcu_batch_init();
+	rcu_lazy_init();
 	rcu_bootup_announce();
 	rcu_init_geometry();
 	rcu_init_one();
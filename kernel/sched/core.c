@@ -1566,7 +1566,7 @@ static inline void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 		update_rq_clock(rq);
 
 	if (!(flags & ENQUEUE_RESTORE)) {
-		sched_info_queued(rq, p);
+		sched_info_queued(rq, p, flags & ENQUEUE_WAKEUP);
 		psi_enqueue(p, flags & ENQUEUE_WAKEUP);
 	}
 
@@ -4004,6 +4004,9 @@ void scheduler_tick(void)
 
 	rq_unlock(rq, &rf);
 
+	if (curr->flags & PF_WQ_WORKER)
+		wq_worker_tick(curr);
+
 	perf_event_task_tick();
 
 #ifdef CONFIG_SMP
@@ -6258,6 +6261,58 @@ int __sched yield_to(struct task_struct *p, bool preempt)
 }
 EXPORT_SYMBOL_GPL(yield_to);
 
+#ifdef CONFIG_SCHED_PROXY_EXEC
+/**
+ * sched_proxy_donate - lend the current task's slot to a lock owner
+ * @owner: the task holding the lock current is about to block on
+ *
+ * Called by the sleeping lock slowpaths right before current blocks. If
+ * @owner is a preempted (runnable but not running) CFS task, make it the
+ * next entity its runqueue will pick and kick that CPU, so the lock is
+ * released on the waiter's behalf instead of whenever the owner's own
+ * share of the CPU comes around again. A throttled bandwidth hierarchy
+ * above @owner is unthrottled until it runs out of runtime again.
+ *
+ * The caller must guarantee @owner stays valid, typically by holding
+ * rcu_read_lock() and having read it from the lock's owner field.
+ */
+void sched_proxy_donate(struct task_struct *owner)
+{
+	struct task_struct *curr = current;
+	struct rq_flags rf;
+	struct rq *rq;
+
+	if (!sched_feat(PROXY_EXEC))
+		return;
+
+	if (curr->sched_class != &fair_sched_class ||
+	    READ_ONCE(owner->sched_class) != &fair_sched_class)
+		return;
+
+	/* Running or sleeping owners have nothing to gain from us. */
+	if (READ_ONCE(owner->on_cpu) || READ_ONCE(owner->state))
+		return;
+
+	rq = task_rq_lock(owner, &rf);
+	if (owner->sched_class != &fair_sched_class ||
+	    task_running(rq, owner) || owner->state)
+		goto out_unlock;
+
+	/*
+	 * Make the owner's CPU reschedule; the owner is charged for what
+	 * it runs through its vruntime. Leave higher classes alone. If the
+	 * owner is queued on our own CPU this merely sets the flag for the
+	 * schedule() we are about to do.
+	 */
+	if (proxy_donate_fair(rq, owner) &&
+	    rq->curr->sched_class == &fair_sched_class)
+		resched_curr(rq);
+
+out_unlock:
+	task_rq_unlock(rq, owner, &rf);
+}
+#endif /* CONFIG_SCHED_PROXY_EXEC */
+
 int io_schedule_prepare(void)
 {
 	int old_iowait = current->in_iowait;
@@ -7050,6 +7105,10 @@ int in_sched_functions(unsigned long addr)
 struct task_group root_task_group;
 LIST_HEAD(task_groups);
 
+#ifdef CONFIG_SCHEDSTATS
+static DEFINE_PER_CPU(struct sched_lat_hist, root_lat_hist);
+#endif
+
 /* Cacheline aligned slab cache for task_group */
 static struct kmem_cache *task_group_cache __read_mostly;
 #endif
@@ -7124,6 +7183,9 @@ void __init sched_init(void)
 #ifdef CONFIG_CGROUP_SCHED
 	task_group_cache = KMEM_CACHE(task_group, 0);
 
+#ifdef CONFIG_SCHEDSTATS
+	root_task_group.lat_hist = &root_lat_hist;
+#endif
 	list_add(&root_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&root_task_group.children);
 	INIT_LIST_HEAD(&root_task_group.siblings);
@@ -7193,6 +7255,10 @@ void __init sched_init(void)
 
 		rq_csd_init(rq, &rq->nohz_csd, nohz_csd_func);
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+		rq_csd_init(rq, &rq->cfsb_csd, __cfsb_csd_unthrottle);
+		INIT_LIST_HEAD(&rq->cfsb_csd_list);
+#endif
 #endif /* CONFIG_SMP */
 		hrtick_rq_init(rq);
 		atomic_set(&rq->nr_iowait, 0);
@@ -7439,6 +7505,9 @@ static inline void alloc_uclamp_sched_group(struct task_group *tg,
 
 static void sched_free_group(struct task_group *tg)
 {
+#ifdef CONFIG_SCHEDSTATS
+	free_percpu(tg->lat_hist);
+#endif
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
 	autogroup_free(tg);
@@ -7460,6 +7529,12 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+#ifdef CONFIG_SCHEDSTATS
+	tg->lat_hist = alloc_percpu(struct sched_lat_hist);
+	if (!tg->lat_hist)
+		goto err;
+#endif
+
 	alloc_uclamp_sched_group(tg, parent);
 
 	return tg;
@@ -7892,7 +7967,8 @@ static const u64 max_cfs_runtime = MAX_BW * NSEC_PER_USEC;
 
 static int __cfs_schedulable(struct task_group *tg, u64 period, u64 runtime);
 
-static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota,
+				u64 burst)
 {
 	int i, ret = 0, runtime_enabled, runtime_was_enabled;
 	struct cfs_bandwidth *cfs_b = &tg->cfs_bandwidth;
@@ -7922,6 +7998,14 @@ static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
 	if (quota != RUNTIME_INF && quota > max_cfs_runtime)
 		return -EINVAL;
 
+	/*
+	 * The burst is unused quota carried over from earlier periods; it
+	 * can never exceed one period's worth of quota.
+	 */
+	if (quota != RUNTIME_INF && (burst > quota ||
+				     burst + quota > max_cfs_runtime))
+		return -EINVAL;
+
 	/*
 	 * Prevent race between setting of cfs_rq->runtime_enabled and
 	 * unthrottle_offline_cfs_rqs().
@@ -7943,7 +8027,15 @@ static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
 	raw_spin_lock_irq(&cfs_b->lock);
 	cfs_b->period = ns_to_ktime(period);
 	cfs_b->quota = quota;
+	cfs_b->burst = burst;
 
+	/*
+	 * Start afresh rather than carrying over runtime from the old limit,
+	 * and reset the snapshot with it so that the refill below is not
+	 * accounted as a burst.
+	 */
+	cfs_b->runtime = 0;
+	cfs_b->runtime_snap = 0;
 	__refill_cfs_bandwidth_runtime(cfs_b);
 
 	/* Restart the period timer (if active) to handle new period expiry: */
@@ -7976,9 +8068,10 @@ static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
 
 static int tg_set_cfs_quota(struct task_group *tg, long cfs_quota_us)
 {
-	u64 quota, period;
+	u64 quota, period, burst;
 
 	period = ktime_to_ns(tg->cfs_bandwidth.period);
+	burst = tg->cfs_bandwidth.burst;
 	if (cfs_quota_us < 0)
 		quota = RUNTIME_INF;
 	else if ((u64)cfs_quota_us <= U64_MAX / NSEC_PER_USEC)
@@ -7986,7 +8079,7 @@ static int tg_set_cfs_quota(struct task_group *tg, long cfs_quota_us)
 	else
 		return -EINVAL;
 
-	return tg_set_cfs_bandwidth(tg, period, quota);
+	return tg_set_cfs_bandwidth(tg, period, quota, burst);
 }
 
 static long tg_get_cfs_quota(struct task_group *tg)
@@ -8004,15 +8097,16 @@ static long tg_get_cfs_quota(struct task_group *tg)
 
 static int tg_set_cfs_period(struct task_group *tg, long cfs_period_us)
 {
-	u64 quota, period;
+	u64 quota, period, burst;
 
 	if ((u64)cfs_period_us > U64_MAX / NSEC_PER_USEC)
 		return -EINVAL;
 
 	period = (u64)cfs_period_us * NSEC_PER_USEC;
 	quota = tg->cfs_bandwidth.quota;
+	burst = tg->cfs_bandwidth.burst;
 
-	return tg_set_cfs_bandwidth(tg, period, quota);
+	return tg_set_cfs_bandwidth(tg, period, quota, burst);
 }
 
 static long tg_get_cfs_period(struct task_group *tg)
@@ -8025,6 +8119,30 @@ static long tg_get_cfs_period(struct task_group *tg)
 	return cfs_period_us;
 }
 
+static int tg_set_cfs_burst(struct task_group *tg, long cfs_burst_us)
+{
+	u64 quota, period, burst;
+
+	if ((u64)cfs_burst_us > U64_MAX / NSEC_PER_USEC)
+		return -EINVAL;
+
+	burst = (u64)cfs_burst_us * NSEC_PER_USEC;
+	period = ktime_to_ns(tg->cfs_bandwidth.period);
+	quota = tg->cfs_bandwidth.quota;
+
+	return tg_set_cfs_bandwidth(tg, period, quota, burst);
+}
+
+static long tg_get_cfs_burst(struct task_group *tg)
+{
+	u64 burst_us;
+
+	burst_us = tg->cfs_bandwidth.burst;
+	do_div(burst_us, NSEC_PER_USEC);
+
+	return burst_us;
+}
+
 static s64 cpu_cfs_quota_read_s64(struct cgroup_subsys_state *css,
 				  struct cftype *cft)
 {
@@ -8049,6 +8167,18 @@ static int cpu_cfs_period_write_u64(struct cgroup_subsys_state *css,
 	return tg_set_cfs_period(css_tg(css), cfs_period_us);
 }
 
+static u64 cpu_cfs_burst_read_u64(struct cgroup_subsys_state *css,
+				  struct cftype *cft)
+{
+	return tg_get_cfs_burst(css_tg(css));
+}
+
+static int cpu_cfs_burst_write_u64(struct cgroup_subsys_state *css,
+				   struct cftype *cftype, u64 cfs_burst_us)
+{
+	return tg_set_cfs_burst(css_tg(css), cfs_burst_us);
+}
+
 struct cfs_schedulable_data {
 	struct task_group *tg;
 	u64 period, quota;
@@ -8140,6 +8270,8 @@ static int cpu_cfs_stat_show(struct seq_file *sf, void *v)
 	seq_printf(sf, "nr_periods %d\n", cfs_b->nr_periods);
 	seq_printf(sf, "nr_throttled %d\n", cfs_b->nr_throttled);
 	seq_printf(sf, "throttled_time %llu\n", cfs_b->throttled_time);
+	seq_printf(sf, "nr_bursts %d\n", cfs_b->nr_burst);
+	seq_printf(sf, "burst_time %llu\n", cfs_b->burst_time);
 
 	if (schedstat_enabled() && tg != &root_task_group) {
 		u64 ws = 0;
@@ -8156,6 +8288,47 @@ static int cpu_cfs_stat_show(struct seq_file *sf, void *v)
 #endif /* CONFIG_CFS_BANDWIDTH */
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * Histograms of runqueue wait times of the tasks in the group and all its
+ * descendants. The first line gives the lower bound in usecs of each bucket.
+ */
+static int cpu_latency_hist_show(struct seq_file *sf, void *v)
+{
+	struct cgroup_subsys_state *css = seq_css(sf), *pos;
+	struct sched_lat_hist sum = { };
+	int cpu, i;
+
+	rcu_read_lock();
+	css_for_each_descendant_pre(pos, css) {
+		struct task_group *tg = css_tg(pos);
+
+		for_each_possible_cpu(cpu) {
+			struct sched_lat_hist *hist = per_cpu_ptr(tg->lat_hist, cpu);
+
+			for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++) {
+				sum.wakeup[i] += READ_ONCE(hist->wakeup[i]);
+				sum.runq[i] += READ_ONCE(hist->runq[i]);
+			}
+		}
+	}
+	rcu_read_unlock();
+
+	seq_puts(sf, "usecs");
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+		seq_printf(sf, " %lu", i ? 1UL << i : 0UL);
+	seq_puts(sf, "\nwakeup");
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+		seq_printf(sf, " %llu", sum.wakeup[i]);
+	seq_puts(sf, "\nrunq");
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+		seq_printf(sf, " %llu", sum.runq[i]);
+	seq_putc(sf, '\n');
+
+	return 0;
+}
+#endif /* CONFIG_SCHEDSTATS */
+
 #ifdef CONFIG_RT_GROUP_SCHED
 static int cpu_rt_runtime_write(struct cgroup_subsys_state *css,
 				struct cftype *cft, s64 val)
@@ -8201,11 +8374,22 @@ static struct cftype cpu_legacy_files[] = {
 		.read_u64 = cpu_cfs_period_read_u64,
 		.write_u64 = cpu_cfs_period_write_u64,
 	},
+	{
+		.name = "cfs_burst_us",
+		.read_u64 = cpu_cfs_burst_read_u64,
+		.write_u64 = cpu_cfs_burst_write_u64,
+	},
 	{
 		.name = "stat",
 		.seq_show = cpu_cfs_stat_show,
 	},
 #endif
+#ifdef CONFIG_SCHEDSTATS
+	{
+		.name = "latency_hist",
+		.seq_show = cpu_latency_hist_show,
+	},
+#endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
 		.name = "rt_runtime_us",
@@ -8242,16 +8426,20 @@ static int cpu_extra_stat_show(struct seq_file *sf,
 	{
 		struct task_group *tg = css_tg(css);
 		struct cfs_bandwidth *cfs_b = &tg->cfs_bandwidth;
-		u64 throttled_usec;
+		u64 throttled_usec, burst_usec;
 
 		throttled_usec = cfs_b->throttled_time;
 		do_div(throttled_usec, NSEC_PER_USEC);
+		burst_usec = cfs_b->burst_time;
+		do_div(burst_usec, NSEC_PER_USEC);
 
 		seq_printf(sf, "nr_periods %d\n"
 			   "nr_throttled %d\n"
-			   "throttled_usec %llu\n",
+			   "throttled_usec %llu\n"
+			   "nr_bursts %d\n"
+			   "burst_usec %llu\n",
 			   cfs_b->nr_periods, cfs_b->nr_throttled,
-			   throttled_usec);
+			   throttled_usec, cfs_b->nr_burst, burst_usec);
 	}
 #endif
 	return 0;
@@ -8366,14 +8554,16 @@ static ssize_t cpu_max_write(struct kernfs_open_file *of,
 {
 	struct task_group *tg = css_tg(of_css(of));
 	u64 period = tg_get_cfs_period(tg);
+	u64 burst = tg->cfs_bandwidth.burst;
 	u64 quota;
 	int ret;
 
 	ret = cpu_period_quota_parse(buf, &period, &quota);
 	if (!ret)
-		ret = tg_set_cfs_bandwidth(tg, period, quota);
+		ret = tg_set_cfs_bandwidth(tg, period, quota, burst);
 	return ret ?: nbytes;
 }
+
 #endif
 
 static struct cftype cpu_files[] = {
@@ -8398,6 +8588,12 @@ static struct cftype cpu_files[] = {
 		.seq_show = cpu_max_show,
 		.write = cpu_max_write,
 	},
+	{
+		.name = "max.burst",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_cfs_burst_read_u64,
+		.write_u64 = cpu_cfs_burst_write_u64,
+	},
 #endif
 #ifdef CONFIG_UCLAMP_TASK_GROUP
 	{
@@ -8412,6 +8608,12 @@ static struct cftype cpu_files[] = {
 		.seq_show = cpu_uclamp_max_show,
 		.write = cpu_uclamp_max_write,
 	},
+#endif
+#ifdef CONFIG_SCHEDSTATS
+	{
+		.name = "latency_hist",
+		.seq_show = cpu_latency_hist_show,
+	},
 #endif
 	{ }	/* terminate */
 };
@@ -15,9 +15,18 @@
 
 #define IOWAIT_BOOST_MIN	(SCHED_CAPACITY_SCALE / 8)
 
+/* Values of the iowait_boost tunable */
+enum sugov_iowait_boost_mode {
+	SUGOV_IOWAIT_BOOST_OFF,
+	SUGOV_IOWAIT_BOOST_ON,
+	SUGOV_IOWAIT_BOOST_ADAPTIVE,
+};
+
 struct sugov_tunables {
 	struct gov_attr_set	attr_set;
 	unsigned int		rate_limit_us;
+	unsigned int		iowait_boost;
+	bool			util_hint;
 };
 
 struct sugov_policy {
@@ -51,6 +60,8 @@ struct sugov_cpu {
 
 	bool			iowait_boost_pending;
 	unsigned int		iowait_boost;
+	u64			iowait_last;
+	u64			iowait_period;
 	u64			last_update;
 
 	unsigned long		bw_dl;
@@ -312,10 +323,35 @@ static bool sugov_iowait_reset(struct sugov_cpu *sg_cpu, u64 time,
 
 	sg_cpu->iowait_boost = set_iowait_boost ? IOWAIT_BOOST_MIN : 0;
 	sg_cpu->iowait_boost_pending = set_iowait_boost;
+	sg_cpu->iowait_period = 0;
 
 	return true;
 }
 
+/**
+ * sugov_iowait_boost_stalled() - Check whether raising the IO boost pays off.
+ * @sg_cpu: the sugov data for the CPU to boost
+ * @time: the update time from the caller
+ *
+ * A boost that helps gets the task through its IO loop faster, so successive
+ * wakeups from IO come in at a shorter interval. In adaptive mode, the boost
+ * is only doubled while the last step shortened that interval by at least
+ * 1/8; otherwise it is held at its current level.
+ */
+static bool sugov_iowait_boost_stalled(struct sugov_cpu *sg_cpu, u64 time)
+{
+	u64 prev = sg_cpu->iowait_period;
+	u64 period = time - sg_cpu->iowait_last;
+
+	sg_cpu->iowait_last = time;
+	sg_cpu->iowait_period = period;
+
+	if (sg_cpu->sg_policy->tunables->iowait_boost != SUGOV_IOWAIT_BOOST_ADAPTIVE)
+		return false;
+
+	return prev && period > prev - (prev >> 3);
+}
+
 /**
  * sugov_iowait_boost() - Updates the IO boost status of a CPU.
  * @sg_cpu: the sugov data for the CPU to boost
@@ -335,6 +371,11 @@ static void sugov_iowait_boost(struct sugov_cpu *sg_cpu, u64 time,
 {
 	bool set_iowait_boost = flags & SCHED_CPUFREQ_IOWAIT;
 
+	if (sg_cpu->sg_policy->tunables->iowait_boost == SUGOV_IOWAIT_BOOST_OFF) {
+		sg_cpu->iowait_boost = 0;
+		return;
+	}
+
 	/* Reset boost if the CPU appears to have been idle enough */
 	if (sg_cpu->iowait_boost &&
 	    sugov_iowait_reset(sg_cpu, time, set_iowait_boost))
@@ -349,8 +390,10 @@ static void sugov_iowait_boost(struct sugov_cpu *sg_cpu, u64 time,
 		return;
 	sg_cpu->iowait_boost_pending = true;
 
-	/* Double the boost at each request */
+	/* Double the boost at each request, unless that stopped helping */
 	if (sg_cpu->iowait_boost) {
+		if (sugov_iowait_boost_stalled(sg_cpu, time))
+			return;
 		sg_cpu->iowait_boost =
 			min_t(unsigned int, sg_cpu->iowait_boost << 1, SCHED_CAPACITY_SCALE);
 		return;
@@ -358,6 +401,8 @@ static void sugov_iowait_boost(struct sugov_cpu *sg_cpu, u64 time,
 
 	/* First wakeup after IO: start with minimum boost */
 	sg_cpu->iowait_boost = IOWAIT_BOOST_MIN;
+	sg_cpu->iowait_last = time;
+	sg_cpu->iowait_period = 0;
 }
 
 /**
@@ -436,6 +481,18 @@ static inline void ignore_dl_rate_limit(struct sugov_cpu *sg_cpu, struct sugov_p
 		sg_policy->limits_changed = true;
 }
 
+/*
+ * Likewise when a task whose utilization history is well above the CPU's
+ * current utilization wakes up, so that the frequency is raised at the
+ * start of its burst rather than a rate limit period into it.
+ */
+static inline void ignore_hint_rate_limit(struct sugov_policy *sg_policy,
+					  unsigned int flags)
+{
+	if ((flags & SCHED_CPUFREQ_UTIL_HINT) && sg_policy->tunables->util_hint)
+		sg_policy->limits_changed = true;
+}
+
 static void sugov_update_single(struct update_util_data *hook, u64 time,
 				unsigned int flags)
 {
@@ -449,6 +506,7 @@ static void sugov_update_single(struct update_util_data *hook, u64 time,
 	sg_cpu->last_update = time;
 
 	ignore_dl_rate_limit(sg_cpu, sg_policy);
+	ignore_hint_rate_limit(sg_policy, flags);
 
 	if (!sugov_should_update_freq(sg_policy, time))
 		return;
@@ -519,6 +577,7 @@ sugov_update_shared(struct update_util_data *hook, u64 time, unsigned int flags)
 	sg_cpu->last_update = time;
 
 	ignore_dl_rate_limit(sg_cpu, sg_policy);
+	ignore_hint_rate_limit(sg_policy, flags);
 
 	if (sugov_should_update_freq(sg_policy, time)) {
 		next_f = sugov_next_freq_shared(sg_cpu, time);
@@ -604,8 +663,61 @@ rate_limit_us_store(struct gov_attr_set *attr_set, const char *buf, size_t count
 
 static struct governor_attr rate_limit_us = __ATTR_RW(rate_limit_us);
 
+static ssize_t iowait_boost_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return sprintf(buf, "%u\n", tunables->iowait_boost);
+}
+
+/*
+ * 0: never boost on wakeups from IO
+ * 1: double the boost on every frequent wakeup from IO
+ * 2: only keep doubling while it shortens the interval between wakeups
+ */
+static ssize_t
+iowait_boost_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+	unsigned int mode;
+
+	if (kstrtouint(buf, 10, &mode) || mode > SUGOV_IOWAIT_BOOST_ADAPTIVE)
+		return -EINVAL;
+
+	WRITE_ONCE(tunables->iowait_boost, mode);
+
+	return count;
+}
+
+static struct governor_attr iowait_boost = __ATTR_RW(iowait_boost);
+
+static ssize_t util_hint_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return sprintf(buf, "%u\n", tunables->util_hint);
+}
+
+static ssize_t
+util_hint_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+	bool enable;
+
+	if (kstrtobool(buf, &enable))
+		return -EINVAL;
+
+	WRITE_ONCE(tunables->util_hint, enable);
+
+	return count;
+}
+
+static struct governor_attr util_hint = __ATTR_RW(util_hint);
+
 static struct attribute *sugov_attrs[] = {
 	&rate_limit_us.attr,
+	&iowait_boost.attr,
+	&util_hint.attr,
 	NULL
 };
 ATTRIBUTE_GROUPS(sugov);
@@ -763,6 +875,8 @@ static int sugov_init(struct cpufreq_policy *policy)
 	}
 
 	tunables->rate_limit_us = cpufreq_policy_transition_delay_us(policy);
+	tunables->iowait_boost = SUGOV_IOWAIT_BOOST_ON;
+	tunables->util_hint = true;
 
 	policy->governor_data = sg_policy;
 	sg_policy->tunables = tunables;
@@ -3957,6 +3957,23 @@ static inline void util_est_enqueue(struct cfs_rq *cfs_rq,
 	trace_sched_util_est_cfs_tp(cfs_rq);
 }
 
+/*
+ * A task waking up with a utilization history well above what the CPU is
+ * currently running at is about to ramp it up; let cpufreq know so that it
+ * can raise the frequency ahead of PELT catching up.
+ */
+static inline bool util_est_wakeup_hint(struct rq *rq, struct task_struct *p)
+{
+	unsigned long util;
+
+	if (!sched_feat(UTIL_EST))
+		return false;
+
+	util = READ_ONCE(rq->cfs.avg.util_avg);
+
+	return _task_util_est(p) > util + (SCHED_CAPACITY_SCALE >> 3);
+}
+
 static inline void util_est_dequeue(struct cfs_rq *cfs_rq,
 				    struct task_struct *p)
 {
@@ -4117,6 +4134,12 @@ static inline int newidle_balance(struct rq *rq, struct rq_flags *rf)
 static inline void
 util_est_enqueue(struct cfs_rq *cfs_rq, struct task_struct *p) {}
 
+static inline bool
+util_est_wakeup_hint(struct rq *rq, struct task_struct *p)
+{
+	return false;
+}
+
 static inline void
 util_est_dequeue(struct cfs_rq *cfs_rq, struct task_struct *p) {}
 
@@ -4318,6 +4341,19 @@ static void __clear_buddies_skip(struct sched_entity *se)
 	}
 }
 
+#ifdef CONFIG_SCHED_PROXY_EXEC
+static void __clear_buddies_proxy(struct sched_entity *se)
+{
+	for_each_sched_entity(se) {
+		struct cfs_rq *cfs_rq = cfs_rq_of(se);
+		if (cfs_rq->proxy != se)
+			break;
+
+		cfs_rq->proxy = NULL;
+	}
+}
+#endif
+
 static void clear_buddies(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
 	if (cfs_rq->last == se)
@@ -4328,6 +4364,10 @@ static void clear_buddies(struct cfs_rq *cfs_rq, struct sched_entity *se)
 
 	if (cfs_rq->skip == se)
 		__clear_buddies_skip(se);
+#ifdef CONFIG_SCHED_PROXY_EXEC
+	if (cfs_rq->proxy == se)
+		__clear_buddies_proxy(se);
+#endif
 }
 
 static __always_inline void return_cfs_rq_runtime(struct cfs_rq *cfs_rq);
@@ -4501,6 +4541,15 @@ pick_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *curr)
 			se = second;
 	}
 
+#ifdef CONFIG_SCHED_PROXY_EXEC
+	if (cfs_rq->proxy) {
+		/*
+		 * A lock waiter gave up its slot for this one. The owner pays
+		 * for what it runs through its vruntime like any other entity.
+		 */
+		se = cfs_rq->proxy;
+	} else
+#endif
 	if (cfs_rq->next && wakeup_preempt_entity(cfs_rq->next, left) < 1) {
 		/*
 		 * Someone really wants this to run. If it's not unfair, run it.
@@ -4628,16 +4677,30 @@ static inline u64 sched_cfs_bandwidth_slice(void)
 }
 
 /*
- * Replenish runtime according to assigned quota. We use sched_clock_cpu
- * directly instead of rq->clock to avoid adding additional synchronization
- * around rq->lock.
+ * Replenish runtime according to assigned quota. Runtime left unused in
+ * the previous period is carried over, up to cfs_b->burst on top of the
+ * quota, so that bursty groups whose average usage is below quota are not
+ * throttled. We use sched_clock_cpu directly instead of rq->clock to avoid
+ * adding additional synchronization around rq->lock.
  *
  * requires cfs_b->lock
  */
 void __refill_cfs_bandwidth_runtime(struct cfs_bandwidth *cfs_b)
 {
-	if (cfs_b->quota != RUNTIME_INF)
-		cfs_b->runtime = cfs_b->quota;
+	s64 runtime;
+
+	if (unlikely(cfs_b->quota == RUNTIME_INF))
+		return;
+
+	cfs_b->runtime += cfs_b->quota;
+	runtime = cfs_b->runtime_snap - cfs_b->runtime;
+	if (runtime > 0) {
+		cfs_b->burst_time += runtime;
+		cfs_b->nr_burst++;
+	}
+
+	cfs_b->runtime = min(cfs_b->runtime, cfs_b->quota + cfs_b->burst);
+	cfs_b->runtime_snap = cfs_b->runtime;
 }
 
 static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
@@ -4928,22 +4991,114 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 		resched_curr(rq);
 }
 
-static void distribute_cfs_runtime(struct cfs_bandwidth *cfs_b)
+#ifdef CONFIG_SMP
+void __cfsb_csd_unthrottle(void *arg)
 {
-	struct cfs_rq *cfs_rq;
+	struct cfs_rq *cursor, *tmp;
+	struct rq *rq = arg;
+	struct rq_flags rf;
+
+	rq_lock(rq, &rf);
+
+	/*
+	 * Since we hold rq lock we're safe from concurrent manipulation of
+	 * the CSD list. However, this RCU critical section annotates the
+	 * fact that we pair with sched_free_group_rcu(), so that we cannot
+	 * race with group being freed in the window between removing it
+	 * from the list and advancing to the next entry in the list.
+	 */
+	rcu_read_lock();
+
+	list_for_each_entry_safe(cursor, tmp, &rq->cfsb_csd_list,
+				 throttled_csd_list) {
+		list_del_init(&cursor->throttled_csd_list);
+
+		if (cfs_rq_throttled(cursor))
+			unthrottle_cfs_rq(cursor);
+	}
+
+	rcu_read_unlock();
+
+	rq_unlock(rq, &rf);
+}
+
+/*
+ * Queue @cfs_rq on its CPU's list and let that CPU do the unthrottle, so
+ * that the period timer does not have to walk every throttled cfs_rq's
+ * hierarchy under remote rq locks. One IPI is sent per CPU per batch.
+ */
+static inline void __unthrottle_cfs_rq_async(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	bool first;
+
+	if (rq == this_rq()) {
+		unthrottle_cfs_rq(cfs_rq);
+		return;
+	}
+
+	/* Already enqueued */
+	if (SCHED_WARN_ON(!list_empty(&cfs_rq->throttled_csd_list)))
+		return;
+
+	first = list_empty(&rq->cfsb_csd_list);
+	list_add_tail(&cfs_rq->throttled_csd_list, &rq->cfsb_csd_list);
+	if (first)
+		smp_call_function_single_async(cpu_of(rq), &rq->cfsb_csd);
+}
+#else
+static inline void __unthrottle_cfs_rq_async(struct cfs_rq *cfs_rq)
+{
+	unthrottle_cfs_rq(cfs_rq);
+}
+#endif
+
+static void unthrottle_cfs_rq_async(struct cfs_rq *cfs_rq)
+{
+	lockdep_assert_held(&rq_of(cfs_rq)->lock);
+
+	if (SCHED_WARN_ON(!cfs_rq_throttled(cfs_rq) ||
+	    cfs_rq->runtime_remaining <= 0))
+		return;
+
+	__unthrottle_cfs_rq_async(cfs_rq);
+}
+
+/*
+ * Hand out runtime to throttled cfs_rqs. Returns true if some cfs_rq is
+ * still throttled and not already queued for an async unthrottle.
+ */
+static bool distribute_cfs_runtime(struct cfs_bandwidth *cfs_b)
+{
+	struct cfs_rq *local_unthrottle = NULL;
+	int this_cpu = smp_processor_id();
 	u64 runtime, remaining = 1;
+	bool throttled = false;
+	struct cfs_rq *cfs_rq;
+	struct rq_flags rf;
+	struct rq *rq;
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(cfs_rq, &cfs_b->throttled_cfs_rq,
 				throttled_list) {
-		struct rq *rq = rq_of(cfs_rq);
-		struct rq_flags rf;
+		rq = rq_of(cfs_rq);
+
+		if (!remaining) {
+			throttled = true;
+			break;
+		}
 
 		rq_lock_irqsave(rq, &rf);
 		if (!cfs_rq_throttled(cfs_rq))
 			goto next;
 
-		/* By the above check, this should never be true */
+#ifdef CONFIG_SMP
+		/* Already queued for async unthrottle */
+		if (!list_empty(&cfs_rq->throttled_csd_list))
+			goto next;
+#endif
+
+		/* By the above checks, this should never be true */
 		SCHED_WARN_ON(cfs_rq->runtime_remaining > 0);
 
 		raw_spin_lock(&cfs_b->lock);
@@ -4957,16 +5112,35 @@ static void distribute_cfs_runtime(struct cfs_bandwidth *cfs_b)
 		cfs_rq->runtime_remaining += runtime;
 
 		/* we check whether we're throttled above */
-		if (cfs_rq->runtime_remaining > 0)
-			unthrottle_cfs_rq(cfs_rq);
+		if (cfs_rq->runtime_remaining > 0) {
+			/*
+			 * Our own cfs_rq is unthrottled last, once we no longer
+			 * hold a remote rq lock.
+			 */
+			if (cpu_of(rq) != this_cpu ||
+			    SCHED_WARN_ON(local_unthrottle))
+				unthrottle_cfs_rq_async(cfs_rq);
+			else
+				local_unthrottle = cfs_rq;
+		} else {
+			throttled = true;
+		}
 
 next:
 		rq_unlock_irqrestore(rq, &rf);
+	}
 
-		if (!remaining)
-			break;
+	if (local_unthrottle) {
+		rq = cpu_rq(this_cpu);
+		rq_lock_irqsave(rq, &rf);
+		if (cfs_rq_throttled(local_unthrottle))
+			unthrottle_cfs_rq(local_unthrottle);
+		rq_unlock_irqrestore(rq, &rf);
 	}
+
 	rcu_read_unlock();
+
+	return throttled;
 }
 
 /*
@@ -5010,10 +5184,8 @@ static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun, u
 	while (throttled && cfs_b->runtime > 0) {
 		raw_spin_unlock_irqrestore(&cfs_b->lock, flags);
 		/* we can't nest cfs_b->lock while distributing bandwidth */
-		distribute_cfs_runtime(cfs_b);
+		throttled = distribute_cfs_runtime(cfs_b);
 		raw_spin_lock_irqsave(&cfs_b->lock, flags);
-
-		throttled = !list_empty(&cfs_b->throttled_cfs_rq);
 	}
 
 	/*
@@ -5291,6 +5463,9 @@ static void init_cfs_rq_runtime(struct cfs_rq *cfs_rq)
 {
 	cfs_rq->runtime_enabled = 0;
 	INIT_LIST_HEAD(&cfs_rq->throttled_list);
+#ifdef CONFIG_SMP
+	INIT_LIST_HEAD(&cfs_rq->throttled_csd_list);
+#endif
 }
 
 void start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
@@ -5313,6 +5488,34 @@ static void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
 
 	hrtimer_cancel(&cfs_b->period_timer);
 	hrtimer_cancel(&cfs_b->slack_timer);
+
+	/*
+	 * It is possible that we still have some cfs_rq's pending on a CSD
+	 * list, though this race is very rare. In order for this to occur, we
+	 * must have raced with the last task leaving the group while there
+	 * exist throttled cfs_rq(s), and the period_timer must have queued the
+	 * CSD item but the remote cpu has not yet processed it. To handle this,
+	 * we can simply flush all pending CSD work inline here. We're
+	 * guaranteed at this point that no additional cfs_rq of this group can
+	 * join a CSD list.
+	 */
+#ifdef CONFIG_SMP
+	{
+		unsigned long flags;
+		int i;
+
+		for_each_possible_cpu(i) {
+			struct rq *rq = cpu_rq(i);
+
+			if (list_empty(&rq->cfsb_csd_list))
+				continue;
+
+			local_irq_save(flags);
+			__cfsb_csd_unthrottle(rq);
+			local_irq_restore(flags);
+		}
+	}
+#endif
 }
 
 /*
@@ -5530,6 +5733,8 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	 */
 	if (p->in_iowait)
 		cpufreq_update_util(rq, SCHED_CPUFREQ_IOWAIT);
+	else if ((flags & ENQUEUE_WAKEUP) && util_est_wakeup_hint(rq, p))
+		cpufreq_update_util(rq, SCHED_CPUFREQ_UTIL_HINT);
 
 	for_each_sched_entity(se) {
 		if (se->on_rq)
@@ -7263,6 +7468,68 @@ static bool yield_to_task_fair(struct rq *rq, struct task_struct *p)
 	return true;
 }
 
+#ifdef CONFIG_SCHED_PROXY_EXEC
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * Unthrottle the cfs_rqs above @se without handing them any runtime. What
+ * the owner then runs is charged to runtime_remaining, which goes further
+ * negative and is paid back out of the next refill. The first update_curr()
+ * that finds no runtime reschedules, and put_prev_entity() throttles the
+ * hierarchy again, so the loan lasts about a tick.
+ */
+static bool proxy_unthrottle(struct sched_entity *se)
+{
+	struct cfs_rq *cfs_rq = cfs_rq_of(se);
+
+	for_each_sched_entity(se) {
+		if (cfs_rq_throttled(cfs_rq_of(se)))
+			unthrottle_cfs_rq(cfs_rq_of(se));
+	}
+
+	return !throttled_hierarchy(cfs_rq);
+}
+#else
+static inline bool proxy_unthrottle(struct sched_entity *se)
+{
+	return false;
+}
+#endif
+
+static void set_proxy_buddy(struct sched_entity *se)
+{
+	for_each_sched_entity(se) {
+		if (SCHED_WARN_ON(!se->on_rq))
+			return;
+		cfs_rq_of(se)->proxy = se;
+	}
+}
+
+/*
+ * Like yield_to_task_fair(), except that the donor is about to block and
+ * will be dequeued by schedule() anyway, so there is no need to skip it.
+ * @rq is the runqueue of @p and must be locked.
+ */
+bool proxy_donate_fair(struct rq *rq, struct task_struct *p)
+{
+	struct sched_entity *se = &p->se;
+
+	if (!se->on_rq)
+		return false;
+
+	if (throttled_hierarchy(cfs_rq_of(se)) && !proxy_unthrottle(se))
+		return false;
+
+	/*
+	 * Unlike the next buddy, which is dropped once it is more than
+	 * wakeup_gran() right of the leftmost entity, the proxy buddy is
+	 * picked whatever its vruntime. It is used up by that one pick.
+	 */
+	set_proxy_buddy(se);
+
+	return true;
+}
+#endif
+
 #ifdef CONFIG_SMP
 /**************************************************
  * Fair scheduling class load-balancing methods.
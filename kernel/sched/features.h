@@ -90,3 +90,11 @@ SCHED_FEAT(WA_BIAS, true)
  */
 SCHED_FEAT(UTIL_EST, true)
 SCHED_FEAT(UTIL_EST_FASTUP, true)
+
+#ifdef CONFIG_SCHED_PROXY_EXEC
+/*
+ * Let tasks blocking on a mutex or rwsem lend their slot to a preempted
+ * lock owner, see sched_proxy_donate().
+ */
+SCHED_FEAT(PROXY_EXEC, true)
+#endif
@@ -183,6 +183,7 @@ static void group_init(struct psi_group *group)
 {
 	int cpu;
 
+	group->enabled = true;
 	for_each_possible_cpu(cpu)
 		seqcount_init(&per_cpu_ptr(group->pcpu, cpu)->seq);
 	group->avg_last_update = sched_clock();
@@ -433,7 +434,7 @@ static void psi_avgs_work(struct work_struct *work)
 	if (now >= group->avg_next_update)
 		group->avg_next_update = update_averages(group, now);
 
-	if (nonidle) {
+	if (nonidle && READ_ONCE(group->enabled)) {
 		schedule_delayed_work(dwork, nsecs_to_jiffies(
 				group->avg_next_update - now) + 1);
 	}
@@ -639,13 +640,11 @@ static void poll_timer_fn(struct timer_list *t)
 	wake_up_interruptible(&group->poll_wait);
 }
 
-static void record_times(struct psi_group_cpu *groupc, int cpu,
+static void record_times(struct psi_group_cpu *groupc, u64 now,
 			 bool memstall_tick)
 {
 	u32 delta;
-	u64 now;
 
-	now = cpu_clock(cpu);
 	delta = now - groupc->state_start;
 	groupc->state_start = now;
 
@@ -686,9 +685,10 @@ static void record_times(struct psi_group_cpu *groupc, int cpu,
 }
 
 static void psi_group_change(struct psi_group *group, int cpu,
-			     unsigned int clear, unsigned int set,
+			     unsigned int clear, unsigned int set, u64 now,
 			     bool wake_clock)
 {
+	bool enabled = READ_ONCE(group->enabled);
 	struct psi_group_cpu *groupc;
 	u32 state_mask = 0;
 	unsigned int t, m;
@@ -703,10 +703,24 @@ static void psi_group_change(struct psi_group *group, int cpu,
 	 *
 	 * Then we update the task counts according to the state
 	 * change requested through the @clear and @set bits.
+	 *
+	 * If PSI was disabled on this group, the task counts are still
+	 * kept up to date so that accounting can be resumed later on,
+	 * but time recording and state aggregation are skipped.
 	 */
 	write_seqcount_begin(&groupc->seq);
 
-	record_times(groupc, cpu, false);
+	if (enabled)
+		record_times(groupc, now, false);
+	else if (unlikely(groupc->state_mask)) {
+		/*
+		 * On the first change after disabling PSI, conclude the
+		 * current state and flush its time, so that aggregation
+		 * does not see a live state that is never going to end.
+		 */
+		record_times(groupc, now, false);
+		groupc->state_mask = 0;
+	}
 
 	for (t = 0, m = clear; m; m &= ~(1 << t), t++) {
 		if (!(m & (1 << t)))
@@ -725,6 +739,11 @@ static void psi_group_change(struct psi_group *group, int cpu,
 		if (set & (1 << t))
 			groupc->tasks[t]++;
 
+	if (!enabled) {
+		write_seqcount_end(&groupc->seq);
+		return;
+	}
+
 	/* Calculate state mask representing active states */
 	for (s = 0; s < NR_PSI_STATES; s++) {
 		if (test_state(groupc->tasks, s))
@@ -786,6 +805,7 @@ void psi_task_change(struct task_struct *task, int clear, int set)
 	struct psi_group *group;
 	bool wake_clock = true;
 	void *iter = NULL;
+	u64 now;
 
 	if (!task->pid)
 		return;
@@ -803,8 +823,11 @@ void psi_task_change(struct task_struct *task, int clear, int set)
 		     wq_worker_last_func(task) == psi_avgs_work))
 		wake_clock = false;
 
+	/* One clock read serves the whole walk up the hierarchy */
+	now = cpu_clock(cpu);
+
 	while ((group = iterate_groups(task, &iter)))
-		psi_group_change(group, cpu, clear, set, wake_clock);
+		psi_group_change(group, cpu, clear, set, now, wake_clock);
 }
 
 void psi_task_switch(struct task_struct *prev, struct task_struct *next,
@@ -812,6 +835,7 @@ void psi_task_switch(struct task_struct *prev, struct task_struct *next,
 {
 	struct psi_group *group, *common = NULL;
 	int cpu = task_cpu(prev);
+	u64 now = cpu_clock(cpu);
 	void *iter;
 
 	if (next->pid) {
@@ -830,7 +854,7 @@ void psi_task_switch(struct task_struct *prev, struct task_struct *next,
 				break;
 			}
 
-			psi_group_change(group, cpu, 0, TSK_ONCPU, true);
+			psi_group_change(group, cpu, 0, TSK_ONCPU, now, true);
 		}
 	}
 
@@ -847,7 +871,7 @@ void psi_task_switch(struct task_struct *prev, struct task_struct *next,
 
 		iter = NULL;
 		while ((group = iterate_groups(prev, &iter)) && group != common)
-			psi_group_change(group, cpu, TSK_ONCPU, 0, true);
+			psi_group_change(group, cpu, TSK_ONCPU, 0, now, true);
 	}
 }
 
@@ -855,13 +879,17 @@ void psi_memstall_tick(struct task_struct *task, int cpu)
 {
 	struct psi_group *group;
 	void *iter = NULL;
+	u64 now = cpu_clock(cpu);
 
 	while ((group = iterate_groups(task, &iter))) {
 		struct psi_group_cpu *groupc;
 
+		if (!READ_ONCE(group->enabled))
+			continue;
+
 		groupc = per_cpu_ptr(group->pcpu, cpu);
 		write_seqcount_begin(&groupc->seq);
-		record_times(groupc, cpu, true);
+		record_times(groupc, now, true);
 		write_seqcount_end(&groupc->seq);
 	}
 }
@@ -950,6 +978,55 @@ void psi_cgroup_free(struct cgroup *cgroup)
 	WARN_ONCE(cgroup->psi.poll_states, "psi: trigger leak\n");
 }
 
+/**
+ * psi_cgroup_enable - turn pressure accounting of a cgroup on or off
+ * @cgroup: the cgroup
+ * @enable: new state
+ *
+ * Disabling stops time recording, state aggregation and the averaging
+ * worker for @cgroup, which takes it out of the cost of task state
+ * changes below it. Tasks are still counted, so when accounting is
+ * re-enabled each CPU's state is recomputed from those counts and time
+ * is recorded again from that point on.
+ *
+ * The switch is per group: descendants of @cgroup keep their own setting,
+ * and task state changes still walk @cgroup to keep its counts current.
+ *
+ * Must be called with cgroup_mutex held.
+ */
+void psi_cgroup_enable(struct cgroup *cgroup, bool enable)
+{
+	struct psi_group *group = &cgroup->psi;
+	int cpu;
+
+	if (static_branch_likely(&psi_disabled) || group->enabled == enable)
+		return;
+
+	WRITE_ONCE(group->enabled, enable);
+	if (!enable) {
+		/*
+		 * psi_group_change() no longer arms the worker, and the
+		 * worker does not rearm itself once it sees the group
+		 * disabled.
+		 */
+		cancel_delayed_work_sync(&group->avgs_work);
+		return;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+		struct rq_flags rf;
+
+		/*
+		 * Restart state_start from now, and use .clear = .set = 0
+		 * since no task state really changed.
+		 */
+		rq_lock_irq(rq, &rf);
+		psi_group_change(group, cpu, 0, 0, cpu_clock(cpu), true);
+		rq_unlock_irq(rq, &rf);
+	}
+}
+
 /**
  * cgroup_move_task - move task to a different cgroup
  * @task: the task
@@ -1007,7 +1084,7 @@ int psi_show(struct seq_file *m, struct psi_group *group, enum psi_res res)
 	int full;
 	u64 now;
 
-	if (static_branch_likely(&psi_disabled))
+	if (static_branch_likely(&psi_disabled) || !READ_ONCE(group->enabled))
 		return -EOPNOTSUPP;
 
 	/* Update averages before reporting them */
@@ -1077,7 +1154,7 @@ struct psi_trigger *psi_trigger_create(struct psi_group *group,
 	u32 threshold_us;
 	u32 window_us;
 
-	if (static_branch_likely(&psi_disabled))
+	if (static_branch_likely(&psi_disabled) || !READ_ONCE(group->enabled))
 		return ERR_PTR(-EOPNOTSUPP);
 
 	if (sscanf(buf, "some %u %u", &threshold_us, &window_us) == 2)
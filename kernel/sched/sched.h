@@ -358,6 +358,8 @@ struct cfs_bandwidth {
 	ktime_t			period;
 	u64			quota;
 	u64			runtime;
+	u64			burst;
+	u64			runtime_snap;
 	s64			hierarchical_quota;
 
 	u8			idle;
@@ -370,10 +372,28 @@ struct cfs_bandwidth {
 	/* Statistics: */
 	int			nr_periods;
 	int			nr_throttled;
+	int			nr_burst;
 	u64			throttled_time;
+	u64			burst_time;
 #endif
 };
 
+#if defined(CONFIG_SCHEDSTATS) && defined(CONFIG_CGROUP_SCHED)
+/*
+ * Per-CPU log2 histograms of the time tasks of a group spent waiting on a
+ * runqueue. Bucket i counts waits of [2^i, 2^(i+1)) usecs, the first bucket
+ * also takes anything shorter and the last one anything longer.
+ */
+#define SCHED_LAT_HIST_BUCKETS	24
+
+struct sched_lat_hist {
+	/* From being woken up to first running */
+	u64			wakeup[SCHED_LAT_HIST_BUCKETS];
+	/* Any wait on the runqueue, including after preemption */
+	u64			runq[SCHED_LAT_HIST_BUCKETS];
+};
+#endif
+
 /* Task group related information */
 struct task_group {
 	struct cgroup_subsys_state css;
@@ -424,6 +444,9 @@ struct task_group {
 	struct uclamp_se	uclamp[UCLAMP_CNT];
 #endif
 
+#ifdef CONFIG_SCHEDSTATS
+	struct sched_lat_hist __percpu *lat_hist;
+#endif
 };
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -469,6 +492,9 @@ extern void init_tg_cfs_entry(struct task_group *tg, struct cfs_rq *cfs_rq,
 extern void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b);
 
 extern void __refill_cfs_bandwidth_runtime(struct cfs_bandwidth *cfs_b);
+#ifdef CONFIG_SMP
+extern void __cfsb_csd_unthrottle(void *arg);
+#endif
 extern void start_cfs_bandwidth(struct cfs_bandwidth *cfs_b);
 extern void unthrottle_cfs_rq(struct cfs_rq *cfs_rq);
 
@@ -532,6 +558,10 @@ struct cfs_rq {
 	struct sched_entity	*next;
 	struct sched_entity	*last;
 	struct sched_entity	*skip;
+#ifdef CONFIG_SCHED_PROXY_EXEC
+	/* Lock owner a blocked waiter lent its slot to, picked unconditionally */
+	struct sched_entity	*proxy;
+#endif
 
 #ifdef	CONFIG_SCHED_DEBUG
 	unsigned int		nr_spread_over;
@@ -595,6 +625,9 @@ struct cfs_rq {
 	int			throttled;
 	int			throttle_count;
 	struct list_head	throttled_list;
+#ifdef CONFIG_SMP
+	struct list_head	throttled_csd_list;
+#endif
 #endif /* CONFIG_CFS_BANDWIDTH */
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 };
@@ -912,6 +945,11 @@ struct rq {
 
 #ifdef CONFIG_SMP
 	unsigned int		ttwu_pending;
+#endif
+#if defined(CONFIG_CFS_BANDWIDTH) && defined(CONFIG_SMP)
+	/* cfs_rqs to unthrottle on behalf of a remote period/slack timer */
+	call_single_data_t	cfsb_csd;
+	struct list_head	cfsb_csd_list;
 #endif
 	u64			nr_switches;
 
@@ -1894,6 +1932,10 @@ extern void set_cpus_allowed_common(struct task_struct *p, const struct cpumask
 
 #endif
 
+#ifdef CONFIG_SCHED_PROXY_EXEC
+extern bool proxy_donate_fair(struct rq *rq, struct task_struct *p);
+#endif
+
 #ifdef CONFIG_CPU_IDLE
 static inline void idle_set_state(struct rq *rq,
 				  struct cpuidle_state *idle_state)
@@ -12,6 +12,27 @@
  */
 #define SCHEDSTAT_VERSION 15
 
+#ifdef CONFIG_CGROUP_SCHED
+/*
+ * Account a wait of @delta nsecs on the runqueue of the current CPU to the
+ * task group of @t. Called with the runqueue lock held.
+ */
+void sched_lat_hist_record(struct task_struct *t, unsigned long long delta,
+			   bool wakeup)
+{
+	struct sched_lat_hist *hist = this_cpu_ptr(task_group(t)->lat_hist);
+	u64 usecs = div_u64(delta, NSEC_PER_USEC);
+	unsigned int idx;
+
+	idx = usecs ? min_t(unsigned int, fls64(usecs) - 1,
+			    SCHED_LAT_HIST_BUCKETS - 1) : 0;
+
+	hist->runq[idx]++;
+	if (wakeup)
+		hist->wakeup[idx]++;
+}
+#endif
+
 static int show_schedstat(struct seq_file *seq, void *v)
 {
 	int cpu;
@@ -30,6 +30,14 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 	if (rq)
 		rq->rq_sched_info.run_delay += delta;
 }
+
+#ifdef CONFIG_CGROUP_SCHED
+extern void sched_lat_hist_record(struct task_struct *t,
+				  unsigned long long delta, bool wakeup);
+#else
+static inline void sched_lat_hist_record(struct task_struct *t,
+					 unsigned long long delta, bool wakeup) { }
+#endif
 #define   schedstat_enabled()		static_branch_unlikely(&sched_schedstats)
 #define __schedstat_inc(var)		do { var++; } while (0)
 #define   schedstat_inc(var)		do { if (schedstat_enabled()) { var++; } } while (0)
@@ -44,6 +52,8 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 static inline void rq_sched_info_arrive  (struct rq *rq, unsigned long long delta) { }
 static inline void rq_sched_info_dequeued(struct rq *rq, unsigned long long delta) { }
 static inline void rq_sched_info_depart  (struct rq *rq, unsigned long long delta) { }
+static inline void sched_lat_hist_record(struct task_struct *t,
+					 unsigned long long delta, bool wakeup) { }
 # define   schedstat_enabled()		0
 # define __schedstat_inc(var)		do { } while (0)
 # define   schedstat_inc(var)		do { } while (0)
@@ -197,8 +207,10 @@ static void sched_info_arrive(struct rq *rq, struct task_struct *t)
 {
 	unsigned long long now = rq_clock(rq), delta = 0;
 
-	if (t->sched_info.last_queued)
+	if (t->sched_info.last_queued) {
 		delta = now - t->sched_info.last_queued;
+		sched_lat_hist_record(t, delta, t->sched_info.wakeup_queued);
+	}
 	sched_info_reset_dequeued(t);
 	t->sched_info.run_delay += delta;
 	t->sched_info.last_arrival = now;
@@ -212,11 +224,14 @@ static void sched_info_arrive(struct rq *rq, struct task_struct *t)
  * the timestamp if it is already not set.  It's assumed that
  * sched_info_dequeued() will clear that stamp when appropriate.
  */
-static inline void sched_info_queued(struct rq *rq, struct task_struct *t)
+static inline void sched_info_queued(struct rq *rq, struct task_struct *t,
+				     bool wakeup)
 {
 	if (sched_info_on()) {
-		if (!t->sched_info.last_queued)
+		if (!t->sched_info.last_queued) {
 			t->sched_info.last_queued = rq_clock(rq);
+			t->sched_info.wakeup_queued = wakeup;
+		}
 	}
 }
 
@@ -235,7 +250,7 @@ static inline void sched_info_depart(struct rq *rq, struct task_struct *t)
 	rq_sched_info_depart(rq, delta);
 
 	if (t->state == TASK_RUNNING)
-		sched_info_queued(rq, t);
+		sched_info_queued(rq, t, false);
 }
 
 /*
@@ -266,7 +281,7 @@ sched_info_switch(struct rq *rq, struct task_struct *prev, struct task_struct *n
 }
 
 #else /* !CONFIG_SCHED_INFO: */
-# define sched_info_queued(rq, t)	do { } while (0)
+# define sched_info_queued(rq, t, w)	do { } while (0)
 # define sched_info_reset_dequeued(t)	do { } while (0)
 # define sched_info_dequeued(rq, t)	do { } while (0)
 # define sched_info_depart(rq, t)	do { } while (0)
@@ -57,6 +57,20 @@
 #define HRTIMER_ACTIVE_SOFT	(HRTIMER_ACTIVE_HARD << MASK_SHIFT)
 #define HRTIMER_ACTIVE_ALL	(HRTIMER_ACTIVE_SOFT | HRTIMER_ACTIVE_HARD)
 
+/*
+ * Number of queued timers right-of a not yet expired timer which are
+ * checked for an already started slack window in one expiry pass.
+ */
+#define HRTIMER_COALESCE_SCAN	8
+
+/*
+ * Events due within this many nanoseconds after an expiry pass are
+ * expired in the same hrtimer interrupt instead of reprogramming the
+ * clock event device for them, which costs about as much as waiting.
+ */
+#define HRTIMER_BATCH_NS	1000
+#define HRTIMER_BATCH_MAX	4
+
 /*
  * The timer bases:
  *
@@ -1030,7 +1044,8 @@ static void __remove_hrtimer(struct hrtimer *timer,
  * remove hrtimer, called with base lock held
  */
 static inline int
-remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base, bool restart)
+remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base,
+	       bool restart, bool keep_local)
 {
 	u8 state = timer->state;
 
@@ -1044,9 +1059,13 @@ remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base, bool rest
 		 * skipped. The interrupt event on this CPU is fired and
 		 * reprogramming happens in the interrupt handler. This is a
 		 * rare case and less expensive than a smp call.
+		 *
+		 * @keep_local is set when the timer is requeued on this CPU
+		 * right away, the caller reprograms once it is enqueued.
 		 */
 		debug_deactivate(timer);
-		reprogram = base->cpu_base == this_cpu_ptr(&hrtimer_bases);
+		reprogram = base->cpu_base == this_cpu_ptr(&hrtimer_bases) &&
+			    !keep_local;
 
 		if (!restart)
 			state = HRTIMER_STATE_INACTIVE;
@@ -1102,10 +1121,23 @@ static int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 				    u64 delta_ns, const enum hrtimer_mode mode,
 				    struct hrtimer_clock_base *base)
 {
+	struct hrtimer_cpu_base *this_cpu_base = this_cpu_ptr(&hrtimer_bases);
 	struct hrtimer_clock_base *new_base;
+	bool keep_local, first;
+
+	/*
+	 * Restarting the first expiring timer of this CPU would reprogram
+	 * the clock event device twice, once for the removal and once for
+	 * the enqueue. Keep it on this CPU instead, skip the reprogramming
+	 * on removal and reevaluate the first expiring timer once after it
+	 * is queued again.
+	 */
+	keep_local = base->cpu_base == this_cpu_base &&
+		     this_cpu_base->next_timer == timer &&
+		     hrtimer_is_queued(timer) && !this_cpu_base->in_hrtirq;
 
 	/* Remove an active timer from the queue: */
-	remove_hrtimer(timer, base, true);
+	remove_hrtimer(timer, base, true, keep_local);
 
 	if (mode & HRTIMER_MODE_REL)
 		tim = ktime_add_safe(tim, base->get_time());
@@ -1115,9 +1147,18 @@ static int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 	hrtimer_set_expires_range_ns(timer, tim, delta_ns);
 
 	/* Switch the timer base, if necessary: */
-	new_base = switch_hrtimer_base(timer, base, mode & HRTIMER_MODE_PINNED);
+	if (keep_local)
+		new_base = base;
+	else
+		new_base = switch_hrtimer_base(timer, base,
+					       mode & HRTIMER_MODE_PINNED);
 
-	return enqueue_hrtimer(timer, new_base, mode);
+	first = enqueue_hrtimer(timer, new_base, mode);
+	if (!keep_local)
+		return first;
+
+	hrtimer_force_reprogram(this_cpu_base, 1);
+	return 0;
 }
 
 /**
@@ -1183,7 +1224,7 @@ int hrtimer_try_to_cancel(struct hrtimer *timer)
 	base = lock_hrtimer_base(timer, &flags);
 
 	if (!hrtimer_callback_running(timer))
-		ret = remove_hrtimer(timer, base, false);
+		ret = remove_hrtimer(timer, base, false, false);
 
 	unlock_hrtimer_base(timer, &flags);
 
@@ -1566,6 +1607,24 @@ static void __run_hrtimer(struct hrtimer_cpu_base *cpu_base,
 	base->running = NULL;
 }
 
+/*
+ * Find a timer right-of the not yet expired timer at @node whose slack
+ * window already started, looking at no more than @budget timers.
+ */
+static struct hrtimer *hrtimer_coalesce_next(struct timerqueue_node *node,
+					     ktime_t basenow,
+					     unsigned int *budget)
+{
+	while (*budget && (node = timerqueue_iterate_next(node))) {
+		struct hrtimer *timer = container_of(node, struct hrtimer, node);
+
+		(*budget)--;
+		if (basenow >= hrtimer_get_softexpires_tv64(timer))
+			return timer;
+	}
+	return NULL;
+}
+
 static void __hrtimer_run_queues(struct hrtimer_cpu_base *cpu_base, ktime_t now,
 				 unsigned long flags, unsigned int active_mask)
 {
@@ -1573,6 +1632,7 @@ static void __hrtimer_run_queues(struct hrtimer_cpu_base *cpu_base, ktime_t now,
 	unsigned int active = cpu_base->active_bases & active_mask;
 
 	for_each_active_base(base, cpu_base, active) {
+		unsigned int budget = HRTIMER_COALESCE_SCAN;
 		struct timerqueue_node *node;
 		ktime_t basenow;
 
@@ -1593,10 +1653,18 @@ static void __hrtimer_run_queues(struct hrtimer_cpu_base *cpu_base, ktime_t now,
 			 * BST we already have.
 			 * We don't add extra wakeups by delaying timers that
 			 * are right-of a not yet expired timer, because that
-			 * timer will have to trigger a wakeup anyway.
+			 * timer will have to trigger a wakeup anyway - unless
+			 * it is canceled before, which is common for timeouts.
+			 * So do look at a few of them and expire those whose
+			 * slack window overlaps this interrupt.
 			 */
-			if (basenow < hrtimer_get_softexpires_tv64(timer))
-				break;
+			if (basenow < hrtimer_get_softexpires_tv64(timer)) {
+				timer = hrtimer_coalesce_next(node, basenow,
+							      &budget);
+				if (!timer)
+					break;
+				cpu_base->nr_coalesced++;
+			}
 
 			__run_hrtimer(cpu_base, base, timer, &basenow, flags);
 			if (active_mask == HRTIMER_ACTIVE_SOFT)
@@ -1635,7 +1703,7 @@ void hrtimer_interrupt(struct clock_event_device *dev)
 	struct hrtimer_cpu_base *cpu_base = this_cpu_ptr(&hrtimer_bases);
 	ktime_t expires_next, now, entry_time, delta;
 	unsigned long flags;
-	int retries = 0;
+	int retries = 0, batched = 0;
 
 	BUG_ON(!cpu_base->hres_active);
 	cpu_base->nr_events++;
@@ -1664,6 +1732,20 @@ void hrtimer_interrupt(struct clock_event_device *dev)
 
 	/* Reevaluate the clock bases for the [soft] next expiry */
 	expires_next = hrtimer_update_next_event(cpu_base);
+
+	/*
+	 * Don't reprogram the device for an event which is due before the
+	 * interrupt could be left and reentered, expire it in this batch.
+	 * Bounded, so timers rearming themselves can't keep us here.
+	 */
+	if (ktime_sub(expires_next, now) < HRTIMER_BATCH_NS &&
+	    batched++ < HRTIMER_BATCH_MAX) {
+		while ((now = hrtimer_update_base(cpu_base)) < expires_next)
+			cpu_relax();
+		cpu_base->nr_batched++;
+		goto retry;
+	}
+
 	/*
 	 * Store the new expiry value so the migration code can verify
 	 * against it.
@@ -52,6 +52,7 @@
 #include <asm/io.h>
 
 #include "tick-internal.h"
+#include "timer_migration.h"
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/timer.h>
@@ -182,16 +183,26 @@ EXPORT_SYMBOL(jiffies_64);
 /*
  * The resulting wheel size. If NOHZ is configured we allocate two
  * wheels so we have a separate storage for the deferrable timers.
+ * With CONFIG_TIMER_MIGRATION a third wheel separates the non-pinned
+ * (global) timers, which idle CPUs hand over to the migration
+ * hierarchy, from the pinned ones in BASE_STD.
  */
 #define WHEEL_SIZE	(LVL_SIZE * LVL_DEPTH)
 
-#ifdef CONFIG_NO_HZ_COMMON
+#ifdef CONFIG_TIMER_MIGRATION
+# define NR_BASES	3
+# define BASE_STD	0
+# define BASE_GLOBAL	1
+# define BASE_DEF	2
+#elif defined(CONFIG_NO_HZ_COMMON)
 # define NR_BASES	2
 # define BASE_STD	0
+# define BASE_GLOBAL	0
 # define BASE_DEF	1
 #else
 # define NR_BASES	1
 # define BASE_STD	0
+# define BASE_GLOBAL	0
 # define BASE_DEF	0
 #endif
 
@@ -207,6 +218,7 @@ struct timer_base {
 	unsigned int		cpu;
 	bool			next_expiry_recalc;
 	bool			is_idle;
+	bool			expiry_active;
 	DECLARE_BITMAP(pending_map, WHEEL_SIZE);
 	struct hlist_head	vectors[WHEEL_SIZE];
 } ____cacheline_aligned;
@@ -560,6 +572,15 @@ trigger_dyntick_cpu(struct timer_base *base, struct timer_list *timer)
 		return;
 	}
 
+	/*
+	 * The base is being expired, e.g. by a migrator CPU on behalf of
+	 * the idle owner of a global base and the timer was re-armed from
+	 * its callback. The expiring CPU re-evaluates the first expiry of
+	 * the base when it is done, no need to wake the owner up.
+	 */
+	if (IS_ENABLED(CONFIG_TIMER_MIGRATION) && base->expiry_active)
+		return;
+
 	/*
 	 * We might have to IPI the remote CPU if the base is idle and the
 	 * timer is not deferrable. If the other CPU is on the way to idle
@@ -851,10 +872,13 @@ static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
 
 	/*
 	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
-	 * to use the deferrable base.
+	 * to use the deferrable base. Non-pinned timers go to the global
+	 * base which is handed over to the migration hierarchy when idle.
 	 */
 	if (IS_ENABLED(CONFIG_NO_HZ_COMMON) && (tflags & TIMER_DEFERRABLE))
 		base = per_cpu_ptr(&timer_bases[BASE_DEF], cpu);
+	else if (!(tflags & TIMER_PINNED))
+		base = per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu);
 	return base;
 }
 
@@ -864,10 +888,13 @@ static inline struct timer_base *get_timer_this_cpu_base(u32 tflags)
 
 	/*
 	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
-	 * to use the deferrable base.
+	 * to use the deferrable base. Non-pinned timers go to the global
+	 * base which is handed over to the migration hierarchy when idle.
 	 */
 	if (IS_ENABLED(CONFIG_NO_HZ_COMMON) && (tflags & TIMER_DEFERRABLE))
 		base = this_cpu_ptr(&timer_bases[BASE_DEF]);
+	else if (!(tflags & TIMER_PINNED))
+		base = this_cpu_ptr(&timer_bases[BASE_GLOBAL]);
 	return base;
 }
 
@@ -879,8 +906,14 @@ static inline struct timer_base *get_timer_base(u32 tflags)
 static inline struct timer_base *
 get_target_base(struct timer_base *base, unsigned tflags)
 {
+	/*
+	 * With the pull model, global timers are queued locally and idle
+	 * CPUs' timers are expired by the active ones, there is no need to
+	 * push them to a busy CPU at enqueue time.
+	 */
 #if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
-	if (static_branch_likely(&timers_migration_enabled) &&
+	if (!IS_ENABLED(CONFIG_TIMER_MIGRATION) &&
+	    static_branch_likely(&timers_migration_enabled) &&
 	    !(tflags & TIMER_PINNED))
 		return get_timer_cpu_base(tflags, get_nohz_timer_target());
 #endif
@@ -1613,6 +1646,68 @@ static u64 cmp_next_hrtimer_event(u64 basem, u64 expires)
 	return DIV_ROUND_UP_ULL(nextevt, TICK_NSEC) * TICK_NSEC;
 }
 
+/*
+ * Recalculate the next expiry of @base if needed and forward its clk. We
+ * can only do that when @basej is past base->clk otherwise we might
+ * rewind base->clk. Called with base->lock held.
+ */
+static unsigned long next_timer_interrupt_base(struct timer_base *base,
+					       unsigned long basej,
+					       bool *is_max_delta)
+{
+	unsigned long nextevt;
+
+	if (base->next_expiry_recalc)
+		base->next_expiry = __next_timer_interrupt(base);
+	nextevt = base->next_expiry;
+	*is_max_delta = (nextevt == base->clk + NEXT_TIMER_MAX_DELTA);
+
+	if (time_after(basej, base->clk)) {
+		if (time_after(nextevt, basej))
+			base->clk = basej;
+		else if (time_after(nextevt, base->clk))
+			base->clk = nextevt;
+	}
+	return nextevt;
+}
+
+#ifdef CONFIG_TIMER_MIGRATION
+/* Extend a jiffies value close to the current jiffies_64 to 64 bits */
+static u64 jiffies_to_jiffies64(unsigned long j)
+{
+	u64 now = get_jiffies_64();
+
+	return now + (long)(j - (unsigned long)now);
+}
+
+/*
+ * Hand the global timers of an idle CPU over to the migration hierarchy.
+ * Returns the tick aligned time of the first pinned timer or of the expiry
+ * the CPU has to handle on behalf of the hierarchy, whichever is earlier.
+ */
+static u64 tmigr_next_timer_interrupt(unsigned long nextevt_local,
+				      bool local_max, unsigned long nextevt_global,
+				      bool global_max, unsigned long basej,
+				      u64 basem)
+{
+	u64 expires = KTIME_MAX, tmigr_next, now;
+
+	tmigr_next = tmigr_cpu_deactivate(global_max ? TMIGR_NONE :
+					  jiffies_to_jiffies64(nextevt_global));
+
+	if (!local_max)
+		expires = basem + (u64)(nextevt_local - basej) * TICK_NSEC;
+
+	if (tmigr_next != TMIGR_NONE) {
+		now = jiffies_to_jiffies64(basej);
+		if (tmigr_next <= now)
+			return basem;
+		expires = min(expires, basem + (tmigr_next - now) * TICK_NSEC);
+	}
+	return expires;
+}
+#endif
+
 /**
  * get_next_timer_interrupt - return the time (clock mono) of the next timer
  * @basej:	base time jiffies
@@ -1620,13 +1715,17 @@ static u64 cmp_next_hrtimer_event(u64 basem, u64 expires)
  *
  * Returns the tick aligned clock monotonic time of the next pending
  * timer or KTIME_MAX if no timer is pending.
+ *
+ * With CONFIG_TIMER_MIGRATION the global timers of a CPU going idle are
+ * handed over to the migration hierarchy and only the pinned timers and
+ * the expiry it has to handle on behalf of the hierarchy are returned.
  */
 u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	struct timer_base *base_local, *base_global;
+	unsigned long nextevt, nextevt_local, nextevt_global;
+	bool local_max, global_max, is_max_delta, idle;
 	u64 expires = KTIME_MAX;
-	unsigned long nextevt;
-	bool is_max_delta;
 
 	/*
 	 * Pretend that there is no timer pending if the cpu is offline.
@@ -1635,27 +1734,33 @@ u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
 	if (cpu_is_offline(smp_processor_id()))
 		return expires;
 
-	raw_spin_lock(&base->lock);
-	if (base->next_expiry_recalc)
-		base->next_expiry = __next_timer_interrupt(base);
-	nextevt = base->next_expiry;
-	is_max_delta = (nextevt == base->clk + NEXT_TIMER_MAX_DELTA);
+	base_local = this_cpu_ptr(&timer_bases[BASE_STD]);
+	base_global = this_cpu_ptr(&timer_bases[BASE_GLOBAL]);
+
+	raw_spin_lock(&base_local->lock);
+	nextevt_local = next_timer_interrupt_base(base_local, basej, &local_max);
+	nextevt_global = nextevt_local;
+	global_max = local_max;
+	if (base_global != base_local) {
+		raw_spin_lock_nested(&base_global->lock, SINGLE_DEPTH_NESTING);
+		nextevt_global = next_timer_interrupt_base(base_global, basej,
+							   &global_max);
+	}
 
-	/*
-	 * We have a fresh next event. Check whether we can forward the
-	 * base. We can only do that when @basej is past base->clk
-	 * otherwise we might rewind base->clk.
-	 */
-	if (time_after(basej, base->clk)) {
-		if (time_after(nextevt, basej))
-			base->clk = basej;
-		else if (time_after(nextevt, base->clk))
-			base->clk = nextevt;
+	/* The earliest timer of both bases decides whether we go idle */
+	if (time_before(nextevt_global, nextevt_local)) {
+		nextevt = nextevt_global;
+		is_max_delta = global_max;
+	} else {
+		nextevt = nextevt_local;
+		is_max_delta = local_max;
 	}
 
+	idle = false;
 	if (time_before_eq(nextevt, basej)) {
 		expires = basem;
-		base->is_idle = false;
+		base_local->is_idle = false;
+		base_global->is_idle = false;
 	} else {
 		if (!is_max_delta)
 			expires = basem + (u64)(nextevt - basej) * TICK_NSEC;
@@ -1663,13 +1768,34 @@ u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
 		 * If we expect to sleep more than a tick, mark the base idle.
 		 * Also the tick is stopped so any added timer must forward
 		 * the base clk itself to keep granularity small. This idle
-		 * logic is only maintained for the BASE_STD base, deferrable
-		 * timers may still see large granularity skew (by design).
+		 * logic is only maintained for the BASE_STD and BASE_GLOBAL
+		 * bases, deferrable timers may still see large granularity
+		 * skew (by design).
 		 */
-		if ((expires - basem) > TICK_NSEC)
-			base->is_idle = true;
+		if ((expires - basem) > TICK_NSEC) {
+			base_local->is_idle = true;
+			base_global->is_idle = true;
+			idle = true;
+		}
 	}
-	raw_spin_unlock(&base->lock);
+
+	if (base_global != base_local)
+		raw_spin_unlock(&base_global->lock);
+	raw_spin_unlock(&base_local->lock);
+
+#ifdef CONFIG_TIMER_MIGRATION
+	if (idle) {
+		if (static_branch_likely(&timers_migration_enabled))
+			expires = tmigr_next_timer_interrupt(nextevt_local,
+							     local_max,
+							     nextevt_global,
+							     global_max,
+							     basej, basem);
+		else
+			/* Keep the global timers, but stop being a migrator */
+			tmigr_cpu_deactivate(TMIGR_NONE);
+	}
+#endif
 
 	return cmp_next_hrtimer_event(basem, expires);
 }
@@ -1681,15 +1807,18 @@ u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
  */
 void timer_clear_idle(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-
 	/*
 	 * We do this unlocked. The worst outcome is a remote enqueue sending
 	 * a pointless IPI, but taking the lock would just make the window for
 	 * sending the IPI a few instructions smaller for the cost of taking
 	 * the lock in the exit from idle path.
 	 */
-	base->is_idle = false;
+	__this_cpu_write(timer_bases[BASE_STD].is_idle, false);
+	if (BASE_GLOBAL != BASE_STD)
+		__this_cpu_write(timer_bases[BASE_GLOBAL].is_idle, false);
+
+	/* Take the global timers back from the migration hierarchy */
+	tmigr_cpu_activate();
 }
 #endif
 
@@ -1731,6 +1860,16 @@ static inline void __run_timers(struct timer_base *base)
 	timer_base_lock_expiry(base);
 	raw_spin_lock_irq(&base->lock);
 
+	/*
+	 * A global base may be expired remotely on behalf of its idle owner
+	 * while the owner wakes up and runs its softirq. Only one of them
+	 * may expire it, otherwise del_timer_sync() can't rely on
+	 * base->running_timer. The other one expires all due timers anyway.
+	 */
+	if (base->expiry_active)
+		goto out_unlock;
+	base->expiry_active = true;
+
 	while (time_after_eq(jiffies, base->clk) &&
 	       time_after_eq(jiffies, base->next_expiry)) {
 		levels = collect_expired_timers(base, heads);
@@ -1746,10 +1885,42 @@ static inline void __run_timers(struct timer_base *base)
 		while (levels--)
 			expire_timers(base, heads + levels);
 	}
+	base->expiry_active = false;
+out_unlock:
 	raw_spin_unlock_irq(&base->lock);
 	timer_base_unlock_expiry(base);
 }
 
+#ifdef CONFIG_TIMER_MIGRATION
+/**
+ * timer_expire_remote - expire the global timers of an idle CPU
+ * @cpu:	the idle CPU
+ *
+ * Called from the timer softirq of the migrator CPU in charge of @cpu.
+ * Returns the next expiry of the global timers of @cpu in jiffies_64
+ * units or TMIGR_NONE.
+ */
+u64 timer_expire_remote(unsigned int cpu)
+{
+	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu);
+	unsigned long flags;
+	u64 next;
+
+	__run_timers(base);
+
+	raw_spin_lock_irqsave(&base->lock, flags);
+	if (base->next_expiry_recalc)
+		base->next_expiry = __next_timer_interrupt(base);
+	if (base->next_expiry == base->clk + NEXT_TIMER_MAX_DELTA)
+		next = TMIGR_NONE;
+	else
+		next = jiffies_to_jiffies64(base->next_expiry);
+	raw_spin_unlock_irqrestore(&base->lock, flags);
+
+	return next;
+}
+#endif
+
 /*
  * This function runs timers and the timer-tq in bottom half context.
  */
@@ -1758,6 +1929,11 @@ static __latent_entropy void run_timer_softirq(struct softirq_action *h)
 	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
 
 	__run_timers(base);
+	if (IS_ENABLED(CONFIG_TIMER_MIGRATION)) {
+		__run_timers(this_cpu_ptr(&timer_bases[BASE_GLOBAL]));
+		/* Expire the global timers of the idle CPUs we are in charge of */
+		tmigr_handle_remote();
+	}
 	if (IS_ENABLED(CONFIG_NO_HZ_COMMON))
 		__run_timers(this_cpu_ptr(&timer_bases[BASE_DEF]));
 }
@@ -1768,17 +1944,21 @@ static __latent_entropy void run_timer_softirq(struct softirq_action *h)
 void run_local_timers(void)
 {
 	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	int i;
 
 	hrtimer_run_queues();
-	/* Raise the softirq only if required. */
-	if (time_before(jiffies, base->next_expiry)) {
-		if (!IS_ENABLED(CONFIG_NO_HZ_COMMON))
-			return;
-		/* CPU is awake, so check the deferrable base. */
-		base++;
-		if (time_before(jiffies, base->next_expiry))
-			return;
+	/*
+	 * Raise the softirq only if required. The CPU is awake, so check
+	 * the global and deferrable bases as well.
+	 */
+	for (i = 0; i < NR_BASES; i++, base++) {
+		if (time_after_eq(jiffies, READ_ONCE(base->next_expiry)))
+			goto raise;
 	}
+	/* Idle CPUs' global timers this CPU has to expire as migrator */
+	if (!tmigr_requires_handle_remote())
+		return;
+raise:
 	raise_softirq(TIMER_SOFTIRQ);
 }
 
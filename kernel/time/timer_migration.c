@@ -0,0 +1,506 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Pull model migration of the global timers of idle CPUs
+ *
+ * Non-pinned ("global") timer wheel timers don't have to expire on the CPU
+ * they were queued on.  When a CPU stops its tick, it hands the next expiry
+ * of its global timers to the hierarchy below and a CPU which is still
+ * active expires them remotely, so that the idle CPU isn't woken up and
+ * can stay in a deep C-state.
+ *
+ * The hierarchy has two levels.  CPUs are grouped by NUMA node into level
+ * 0 groups of up to TMIGR_CHILDREN_PER_GROUP CPUs and all level 0 groups
+ * are children of a single root group.  Each group tracks how many of its
+ * children are active, elects one active child as its migrator and keeps
+ * the earliest expiry of its idle children:
+ *
+ *  - The migrator CPU of a level 0 group expires the due global timers of
+ *    the idle CPUs of its group from its tick.
+ *  - The migrator CPU of the root's migrator group additionally handles
+ *    the idle CPUs of fully idle groups.
+ *  - The last CPU to go idle programs its wakeup for the earliest global
+ *    expiry of the whole system and handles it when it fires.
+ *
+ * The root lock is only taken when a group transitions between idle and
+ * active or when the earliest expiry of an idle group changes, which keeps
+ * the idle entry and exit paths mostly local to the group.
+ *
+ * Lock order: level 0 group->lock -> root->lock.  Timer base locks are
+ * never held while taking them.
+ */
+#include <linux/cpuhotplug.h>
+#include <linux/cpumask.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched/nohz.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/topology.h>
+
+#include "timer_migration.h"
+
+struct tmigr_group {
+	raw_spinlock_t		lock;
+	struct tmigr_group	*parent;	/* I: NULL for the root */
+	unsigned int		nr_active;	/* L: active children */
+	int			migrator;	/* L: child in charge, -1 if none */
+	u64			next_expiry;	/* L: earliest expiry of idle children */
+	int			node;		/* I: NUMA node of level 0 groups */
+	int			idx;		/* I: index in the root's children */
+	unsigned int		nr_children;	/* L: number of children */
+	union {
+		int			cpus[TMIGR_CHILDREN_PER_GROUP];
+		struct tmigr_group	**groups;	/* root only */
+	};
+
+	/* R: the state of a level 0 group as accounted in the root */
+	bool			root_idle;
+	u64			root_expiry;
+};
+
+struct tmigr_cpu {
+	struct tmigr_group	*group;		/* I: level 0 group */
+	bool			online;		/* L: part of the hierarchy */
+	bool			idle;		/* L: timers handed to the hierarchy */
+	u64			next_expiry;	/* L: global timer expiry while idle */
+	unsigned int		seq;		/* L: bumped on every state change */
+};
+
+static DEFINE_PER_CPU(struct tmigr_cpu, tmigr_cpu);
+static struct tmigr_group *tmigr_root;
+static DEFINE_MUTEX(tmigr_mutex);
+
+/* earliest expiry of the idle online CPUs of a level 0 group */
+static u64 tmigr_group_next_expiry(struct tmigr_group *group)
+{
+	u64 next = TMIGR_NONE;
+	int i;
+
+	for (i = 0; i < group->nr_children; i++) {
+		struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, group->cpus[i]);
+
+		if (tmc->online && tmc->idle)
+			next = min(next, tmc->next_expiry);
+	}
+	return next;
+}
+
+static int tmigr_group_pick_migrator(struct tmigr_group *group)
+{
+	int i;
+
+	for (i = 0; i < group->nr_children; i++) {
+		struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, group->cpus[i]);
+
+		if (tmc->online && !tmc->idle)
+			return group->cpus[i];
+	}
+	return -1;
+}
+
+/* earliest expiry of the idle level 0 groups */
+static u64 tmigr_root_next_expiry(struct tmigr_group *root)
+{
+	u64 next = TMIGR_NONE;
+	int i;
+
+	for (i = 0; i < root->nr_children; i++) {
+		struct tmigr_group *group = root->groups[i];
+
+		if (group->root_idle)
+			next = min(next, group->root_expiry);
+	}
+	return next;
+}
+
+static int tmigr_root_pick_migrator(struct tmigr_group *root)
+{
+	int i;
+
+	for (i = 0; i < root->nr_children; i++) {
+		if (!root->groups[i]->root_idle)
+			return i;
+	}
+	return -1;
+}
+
+/* propagate the state of @group to the root if the root cares */
+static void tmigr_root_update(struct tmigr_group *group)
+{
+	struct tmigr_group *root = group->parent;
+	bool idle = !group->nr_active;
+	u64 next = group->next_expiry;
+	bool recalc;
+
+	lockdep_assert_held(&group->lock);
+
+	if (idle == group->root_idle && (!idle || next == group->root_expiry))
+		return;
+
+	raw_spin_lock(&root->lock);
+
+	if (idle != group->root_idle) {
+		if (idle) {
+			WRITE_ONCE(root->nr_active, root->nr_active - 1);
+			WRITE_ONCE(group->root_idle, true);
+			if (root->migrator == group->idx)
+				WRITE_ONCE(root->migrator,
+					   tmigr_root_pick_migrator(root));
+		} else {
+			WRITE_ONCE(root->nr_active, root->nr_active + 1);
+			WRITE_ONCE(group->root_idle, false);
+			if (root->migrator < 0)
+				WRITE_ONCE(root->migrator, group->idx);
+		}
+	}
+
+	/* recalculate only if the old expiry of @group may have been the first */
+	recalc = group->root_expiry == root->next_expiry &&
+		 (!idle || next > group->root_expiry);
+	WRITE_ONCE(group->root_expiry, next);
+
+	if (recalc)
+		WRITE_ONCE(root->next_expiry, tmigr_root_next_expiry(root));
+	else if (idle && next < root->next_expiry)
+		WRITE_ONCE(root->next_expiry, next);
+
+	raw_spin_unlock(&root->lock);
+}
+
+static void tmigr_group_update(struct tmigr_group *group)
+{
+	WRITE_ONCE(group->next_expiry, tmigr_group_next_expiry(group));
+	tmigr_root_update(group);
+}
+
+static void __tmigr_cpu_activate(struct tmigr_cpu *tmc, int cpu)
+{
+	struct tmigr_group *group = tmc->group;
+
+	lockdep_assert_held(&group->lock);
+
+	WRITE_ONCE(tmc->idle, false);
+	tmc->seq++;
+	WRITE_ONCE(group->nr_active, group->nr_active + 1);
+	if (group->migrator < 0)
+		WRITE_ONCE(group->migrator, cpu);
+	tmigr_group_update(group);
+}
+
+/*
+ * Returns the expiry @cpu has to wake up for on behalf of the hierarchy,
+ * TMIGR_NONE if there still are active CPUs to take care of it.
+ */
+static u64 __tmigr_cpu_deactivate(struct tmigr_cpu *tmc, int cpu, u64 nextexp)
+{
+	struct tmigr_group *group = tmc->group;
+	struct tmigr_group *root = group->parent;
+	u64 ret;
+
+	lockdep_assert_held(&group->lock);
+
+	if (!tmc->idle) {
+		WRITE_ONCE(tmc->idle, true);
+		WRITE_ONCE(group->nr_active, group->nr_active - 1);
+		if (group->migrator == cpu)
+			WRITE_ONCE(group->migrator,
+				   tmigr_group_pick_migrator(group));
+	}
+	tmc->next_expiry = nextexp;
+	tmc->seq++;
+	tmigr_group_update(group);
+
+	if (group->nr_active)
+		return TMIGR_NONE;
+
+	/*
+	 * Whoever goes idle last sees all the other idle CPUs' expiries
+	 * accounted in the root and becomes responsible for the first one.
+	 */
+	raw_spin_lock(&root->lock);
+	ret = root->nr_active ? TMIGR_NONE : root->next_expiry;
+	raw_spin_unlock(&root->lock);
+
+	return ret;
+}
+
+/**
+ * tmigr_cpu_deactivate - hand the global timers of a CPU to the hierarchy
+ * @nextexp: next expiry of the CPU's global timers in jiffies_64,
+ *	     TMIGR_NONE if there is none or the CPU keeps handling them
+ *
+ * Called with interrupts disabled when the CPU is about to stop its tick.
+ * May be called repeatedly while the CPU stays idle to update @nextexp.
+ *
+ * Return: the expiry the CPU has to wake up for on behalf of the hierarchy,
+ * which includes its own @nextexp, or TMIGR_NONE.
+ */
+u64 tmigr_cpu_deactivate(u64 nextexp)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	u64 ret;
+
+	if (!tmc->group || !tmc->online)
+		return nextexp;
+
+	raw_spin_lock(&tmc->group->lock);
+	ret = __tmigr_cpu_deactivate(tmc, smp_processor_id(), nextexp);
+	raw_spin_unlock(&tmc->group->lock);
+
+	return ret;
+}
+
+/**
+ * tmigr_cpu_activate - take the global timers of a CPU back
+ *
+ * Called with interrupts disabled when the CPU leaves idle.
+ */
+void tmigr_cpu_activate(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+
+	if (!tmc->group || !tmc->online || !tmc->idle)
+		return;
+
+	raw_spin_lock(&tmc->group->lock);
+	__tmigr_cpu_activate(tmc, smp_processor_id());
+	raw_spin_unlock(&tmc->group->lock);
+}
+
+/* the migrator, or an idle CPU woken up on behalf of its idle group */
+static bool tmigr_group_duty(struct tmigr_cpu *tmc, struct tmigr_group *group,
+			     int cpu)
+{
+	return READ_ONCE(group->migrator) == cpu ||
+	       (READ_ONCE(tmc->idle) && !READ_ONCE(group->nr_active));
+}
+
+static bool tmigr_root_duty(struct tmigr_cpu *tmc, struct tmigr_group *group,
+			    int cpu)
+{
+	struct tmigr_group *root = group->parent;
+
+	if (READ_ONCE(root->migrator) == group->idx &&
+	    READ_ONCE(group->migrator) == cpu)
+		return true;
+
+	return READ_ONCE(tmc->idle) && !READ_ONCE(root->nr_active);
+}
+
+/**
+ * tmigr_requires_handle_remote - check for due timers of idle CPUs
+ *
+ * Called from the tick.  Return: %true if this CPU is in charge of idle
+ * CPUs whose global timers are due, so the timer softirq has to run.
+ */
+bool tmigr_requires_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group = tmc->group;
+	int cpu = smp_processor_id();
+	u64 now;
+
+	if (!group || !READ_ONCE(tmc->online))
+		return false;
+
+	now = get_jiffies_64();
+
+	if (tmigr_group_duty(tmc, group, cpu) &&
+	    READ_ONCE(group->next_expiry) <= now)
+		return true;
+
+	return tmigr_root_duty(tmc, group, cpu) &&
+	       READ_ONCE(group->parent->next_expiry) <= now;
+}
+
+/* expire the due global timers of the idle CPUs of @group */
+static void tmigr_handle_group(struct tmigr_group *group, u64 now)
+{
+	int this_cpu = smp_processor_id();
+	unsigned int i;
+
+	for (i = 0; i < READ_ONCE(group->nr_children); i++) {
+		int cpu = group->cpus[i];
+		struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+		unsigned int seq;
+		bool due;
+		u64 next;
+
+		/* our own global timers are run by the local softirq */
+		if (cpu == this_cpu)
+			continue;
+
+		raw_spin_lock_irq(&group->lock);
+		due = tmc->online && tmc->idle && tmc->next_expiry <= now;
+		seq = tmc->seq;
+		raw_spin_unlock_irq(&group->lock);
+
+		if (!due)
+			continue;
+
+		next = timer_expire_remote(cpu);
+
+		/* @cpu may have woken up or republished in the meantime */
+		raw_spin_lock_irq(&group->lock);
+		if (tmc->idle && tmc->seq == seq) {
+			tmc->next_expiry = next;
+			tmc->seq++;
+			tmigr_group_update(group);
+		}
+		raw_spin_unlock_irq(&group->lock);
+	}
+}
+
+/**
+ * tmigr_handle_remote - expire the due global timers of idle CPUs
+ *
+ * Called from the timer softirq after the local timers have run.
+ */
+void tmigr_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group = tmc->group;
+	int cpu = smp_processor_id();
+	struct tmigr_group *root;
+	unsigned int i;
+	u64 now;
+
+	if (!group || !READ_ONCE(tmc->online))
+		return;
+
+	now = get_jiffies_64();
+
+	if (tmigr_group_duty(tmc, group, cpu) &&
+	    READ_ONCE(group->next_expiry) <= now)
+		tmigr_handle_group(group, now);
+
+	root = group->parent;
+	if (!tmigr_root_duty(tmc, group, cpu) ||
+	    READ_ONCE(root->next_expiry) > now)
+		return;
+
+	for (i = 0; i < smp_load_acquire(&root->nr_children); i++) {
+		struct tmigr_group *child = root->groups[i];
+
+		if (child != group && READ_ONCE(child->root_idle) &&
+		    READ_ONCE(child->root_expiry) <= now)
+			tmigr_handle_group(child, now);
+	}
+}
+
+/* find or create the level 0 group @cpu belongs to */
+static struct tmigr_group *tmigr_get_group(unsigned int cpu)
+{
+	struct tmigr_group *root = tmigr_root;
+	int node = cpu_to_node(cpu);
+	struct tmigr_group *group;
+	unsigned int i;
+
+	lockdep_assert_held(&tmigr_mutex);
+
+	for (i = 0; i < root->nr_children; i++) {
+		group = root->groups[i];
+		if (group->node == node &&
+		    group->nr_children < TMIGR_CHILDREN_PER_GROUP)
+			goto found;
+	}
+
+	group = kzalloc_node(sizeof(*group), GFP_KERNEL, node);
+	if (!group)
+		return NULL;
+
+	raw_spin_lock_init(&group->lock);
+	group->parent = root;
+	group->migrator = -1;
+	group->next_expiry = TMIGR_NONE;
+	group->node = node;
+	group->root_idle = true;
+	group->root_expiry = TMIGR_NONE;
+
+	raw_spin_lock_irq(&root->lock);
+	group->idx = root->nr_children;
+	root->groups[group->idx] = group;
+	smp_store_release(&root->nr_children, group->idx + 1);
+	raw_spin_unlock_irq(&root->lock);
+found:
+	raw_spin_lock_irq(&group->lock);
+	group->cpus[group->nr_children] = cpu;
+	WRITE_ONCE(group->nr_children, group->nr_children + 1);
+	raw_spin_unlock_irq(&group->lock);
+
+	return group;
+}
+
+static int tmigr_cpu_online(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+
+	if (!tmc->group) {
+		mutex_lock(&tmigr_mutex);
+		tmc->group = tmigr_get_group(cpu);
+		mutex_unlock(&tmigr_mutex);
+		if (!tmc->group)
+			return -ENOMEM;
+	}
+
+	raw_spin_lock_irq(&tmc->group->lock);
+	WRITE_ONCE(tmc->online, true);
+	tmc->idle = true;
+	__tmigr_cpu_activate(tmc, cpu);
+	raw_spin_unlock_irq(&tmc->group->lock);
+
+	return 0;
+}
+
+static int tmigr_cpu_offline(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+	u64 next;
+	int target;
+
+	/*
+	 * The outgoing CPU's own timers are migrated by timers_dead_cpu(),
+	 * only drop its share of the hierarchy's duties.
+	 */
+	raw_spin_lock_irq(&tmc->group->lock);
+	next = __tmigr_cpu_deactivate(tmc, cpu, TMIGR_NONE);
+	WRITE_ONCE(tmc->online, false);
+	raw_spin_unlock_irq(&tmc->group->lock);
+
+	/* we were the last active CPU, make an idle one take over */
+	if (next != TMIGR_NONE) {
+		target = cpumask_any_but(cpu_online_mask, cpu);
+		if (target < nr_cpu_ids)
+			wake_up_nohz_cpu(target);
+	}
+
+	return 0;
+}
+
+static int __init tmigr_init(void)
+{
+	struct tmigr_group *root;
+	int ret;
+
+	root = kzalloc(sizeof(*root), GFP_KERNEL);
+	if (!root)
+		return -ENOMEM;
+
+	root->groups = kcalloc(nr_cpu_ids, sizeof(root->groups[0]), GFP_KERNEL);
+	if (!root->groups) {
+		kfree(root);
+		return -ENOMEM;
+	}
+
+	raw_spin_lock_init(&root->lock);
+	root->migrator = -1;
+	root->next_expiry = TMIGR_NONE;
+	root->node = NUMA_NO_NODE;
+	tmigr_root = root;
+
+	ret = cpuhp_setup_state(CPUHP_AP_ONLINE_DYN, "tmigr:online",
+				tmigr_cpu_online, tmigr_cpu_offline);
+	return ret < 0 ? ret : 0;
+}
+early_initcall(tmigr_init);
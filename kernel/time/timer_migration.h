@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _KERNEL_TIME_MIGRATION_H
+#define _KERNEL_TIME_MIGRATION_H
+
+/* No global timer pending, expiries are in jiffies_64 units */
+#define TMIGR_NONE		U64_MAX
+
+/* CPUs per level 0 group, a group never spans NUMA nodes */
+#define TMIGR_CHILDREN_PER_GROUP	8
+
+#ifdef CONFIG_TIMER_MIGRATION
+extern u64 timer_expire_remote(unsigned int cpu);
+extern u64 tmigr_cpu_deactivate(u64 nextexp);
+extern void tmigr_cpu_activate(void);
+extern bool tmigr_requires_handle_remote(void);
+extern void tmigr_handle_remote(void);
+#else
+static inline u64 tmigr_cpu_deactivate(u64 nextexp)
+{
+	return nextexp;
+}
+static inline void tmigr_cpu_activate(void) { }
+static inline bool tmigr_requires_handle_remote(void)
+{
+	return false;
+}
+static inline void tmigr_handle_remote(void) { }
+#endif
+
+#endif
@@ -33,6 +33,7 @@
 #include <linux/sort.h>
 #include <linux/list.h>
 #include <linux/hash.h>
+#include <linux/mm.h>
 #include <linux/rcupdate.h>
 #include <linux/kprobes.h>
 
@@ -4951,10 +4952,12 @@ ftrace_match_addr(struct ftrace_hash *hash, unsigned long ip, int remove)
 
 static int
 ftrace_set_hash(struct ftrace_ops *ops, unsigned char *buf, int len,
-		unsigned long ip, int remove, int reset, int enable)
+		unsigned long *ips, unsigned int cnt,
+		int remove, int reset, int enable)
 {
 	struct ftrace_hash **orig_hash;
 	struct ftrace_hash *hash;
+	unsigned int i;
 	int ret;
 
 	if (unlikely(ftrace_disabled))
@@ -4981,8 +4984,8 @@ ftrace_set_hash(struct ftrace_ops *ops, unsigned char *buf, int len,
 		ret = -EINVAL;
 		goto out_regex_unlock;
 	}
-	if (ip) {
-		ret = ftrace_match_addr(hash, ip, remove);
+	for (i = 0; i < cnt; i++) {
+		ret = ftrace_match_addr(hash, ips[i], remove);
 		if (ret < 0)
 			goto out_regex_unlock;
 	}
@@ -4999,10 +5002,10 @@ ftrace_set_hash(struct ftrace_ops *ops, unsigned char *buf, int len,
 }
 
 static int
-ftrace_set_addr(struct ftrace_ops *ops, unsigned long ip, int remove,
-		int reset, int enable)
+ftrace_set_addr(struct ftrace_ops *ops, unsigned long *ips, unsigned int cnt,
+		int remove, int reset, int enable)
 {
-	return ftrace_set_hash(ops, NULL, 0, ip, remove, reset, enable);
+	return ftrace_set_hash(ops, NULL, 0, ips, cnt, remove, reset, enable);
 }
 
 #ifdef CONFIG_DYNAMIC_FTRACE_WITH_DIRECT_CALLS
@@ -5250,6 +5253,216 @@ int unregister_ftrace_direct(unsigned long ip, unsigned long addr)
 }
 EXPORT_SYMBOL_GPL(unregister_ftrace_direct);
 
+/**
+ * register_ftrace_direct_ips - Call custom trampolines directly from many sites
+ * @ips: The addresses of the nops at the beginning of the functions
+ * @addrs: The addresses of the trampolines to call at the respective @ips
+ * @cnt: The number of elements in @ips and @addrs
+ *
+ * This is register_ftrace_direct() for @cnt functions at once. The direct
+ * hash is grown at most once and the ftrace filter is updated with all
+ * the functions in a single call, so the call sites are patched in one
+ * pass instead of once per function. Either all of the direct calls are
+ * registered, or none of them are.
+ *
+ * On return, @ips point to the exact ftrace records.
+ *
+ * Returns:
+ *  0 on success
+ *  -EBUSY - Another direct function is already attached to one of @ips,
+ *           or the same ip is passed twice
+ *  -ENODEV - One of @ips does not point to a ftrace nop location
+ *  -ENOMEM - There was an allocation failure.
+ */
+int register_ftrace_direct_ips(unsigned long *ips, unsigned long *addrs,
+			       unsigned int cnt)
+{
+	struct ftrace_direct_func **directs;
+	struct ftrace_func_entry **entries;
+	struct ftrace_hash *free_hash = NULL;
+	struct ftrace_direct_func *direct;
+	struct ftrace_func_entry *entry;
+	bool need_sync = false;
+	struct dyn_ftrace *rec;
+	unsigned int i, added = 0;
+	int ret = -ENOMEM;
+
+	entries = kvcalloc(cnt, sizeof(*entries), GFP_KERNEL);
+	directs = kvcalloc(cnt, sizeof(*directs), GFP_KERNEL);
+	if (!entries || !directs)
+		goto out_free;
+
+	mutex_lock(&direct_mutex);
+
+	if (ftrace_hash_empty(direct_functions) ||
+	    direct_functions->count + cnt > 2 * (1 << direct_functions->size_bits)) {
+		struct ftrace_hash *new_hash;
+		int size = direct_functions->count + cnt;
+
+		if (size < 32)
+			size = 32;
+
+		new_hash = dup_hash(direct_functions, size);
+		if (!new_hash)
+			goto out_unlock;
+
+		free_hash = direct_functions;
+		direct_functions = new_hash;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		ret = -ENODEV;
+		rec = lookup_rec(ips[i], ips[i]);
+		if (!rec)
+			goto out_remove;
+
+		ips[i] = rec->ip;
+
+		/* Also catches the same ip passed twice in @ips */
+		ret = -EBUSY;
+		if (ftrace_find_rec_direct(ips[i]))
+			goto out_remove;
+		if (WARN_ON(rec->flags & FTRACE_FL_DIRECT))
+			goto out_remove;
+
+		ret = -ENOMEM;
+		entry = kmalloc(sizeof(*entry), GFP_KERNEL);
+		if (!entry)
+			goto out_remove;
+
+		direct = ftrace_find_direct_func(addrs[i]);
+		if (!direct) {
+			direct = ftrace_alloc_direct_func(addrs[i]);
+			if (!direct) {
+				kfree(entry);
+				goto out_remove;
+			}
+		}
+		direct->count++;
+
+		entry->ip = ips[i];
+		entry->direct = addrs[i];
+		__add_hash_entry(direct_functions, entry);
+		entries[added++] = entry;
+	}
+
+	ret = ftrace_set_filter_ips(&direct_ops, ips, cnt, 0, 0);
+	if (ret)
+		goto out_remove;
+
+	if (!(direct_ops.flags & FTRACE_OPS_FL_ENABLED)) {
+		ret = register_ftrace_function(&direct_ops);
+		if (ret) {
+			ftrace_set_filter_ips(&direct_ops, ips, cnt, 1, 0);
+			goto out_remove;
+		}
+	}
+	goto out_unlock;
+
+ out_remove:
+	for (i = 0; i < added; i++) {
+		entry = entries[i];
+		remove_hash_entry(direct_functions, entry);
+		direct = ftrace_find_direct_func(entry->direct);
+		kfree(entry);
+		if (--direct->count)
+			continue;
+		list_del_rcu(&direct->next);
+		ftrace_direct_func_count--;
+		directs[i] = direct;
+		need_sync = true;
+	}
+ out_unlock:
+	mutex_unlock(&direct_mutex);
+
+	if (free_hash || need_sync)
+		synchronize_rcu_tasks();
+	if (free_hash)
+		free_ftrace_hash(free_hash);
+	for (i = 0; i < added; i++)
+		kfree(directs[i]);
+ out_free:
+	kvfree(directs);
+	kvfree(entries);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(register_ftrace_direct_ips);
+
+/**
+ * unregister_ftrace_direct_ips - Remove direct calls from many sites
+ * @ips: The addresses of the nops the trampolines are called from
+ * @addrs: The addresses of the trampolines called at the respective @ips
+ * @cnt: The number of elements in @ips and @addrs
+ *
+ * This is unregister_ftrace_direct() for @cnt functions at once, with a
+ * single update of the ftrace filter and a single RCU tasks grace period
+ * for all of them.
+ *
+ * Returns:
+ *  0 on success
+ *  -ENODEV - One of @ips has no direct call attached; nothing is removed
+ */
+int unregister_ftrace_direct_ips(unsigned long *ips, unsigned long *addrs,
+				 unsigned int cnt)
+{
+	struct ftrace_direct_func **directs;
+	struct ftrace_func_entry **entries;
+	struct ftrace_direct_func *direct;
+	unsigned int i;
+	int ret = -ENOMEM;
+
+	entries = kvcalloc(cnt, sizeof(*entries), GFP_KERNEL);
+	directs = kvcalloc(cnt, sizeof(*directs), GFP_KERNEL);
+	if (!entries || !directs)
+		goto out_free;
+
+	mutex_lock(&direct_mutex);
+
+	ret = -ENODEV;
+	for (i = 0; i < cnt; i++) {
+		entries[i] = find_direct_entry(&ips[i], NULL);
+		if (!entries[i]) {
+			mutex_unlock(&direct_mutex);
+			goto out_free;
+		}
+	}
+
+	if (direct_functions->count == cnt)
+		unregister_ftrace_function(&direct_ops);
+
+	ret = ftrace_set_filter_ips(&direct_ops, ips, cnt, 1, 0);
+
+	WARN_ON(ret);
+
+	for (i = 0; i < cnt; i++) {
+		remove_hash_entry(direct_functions, entries[i]);
+
+		direct = ftrace_find_direct_func(addrs[i]);
+		if (WARN_ON(!direct))
+			continue;
+		direct->count--;
+		WARN_ON(direct->count < 0);
+		if (!direct->count) {
+			list_del_rcu(&direct->next);
+			ftrace_direct_func_count--;
+			directs[i] = direct;
+		}
+	}
+
+	mutex_unlock(&direct_mutex);
+
+	synchronize_rcu_tasks();
+	for (i = 0; i < cnt; i++) {
+		kfree(directs[i]);
+		kfree(entries[i]);
+	}
+ out_free:
+	kvfree(directs);
+	kvfree(entries);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(unregister_ftrace_direct_ips);
+
 static struct ftrace_ops stub_ops = {
 	.func		= ftrace_stub,
 };
@@ -5413,10 +5626,29 @@ int ftrace_set_filter_ip(struct ftrace_ops *ops, unsigned long ip,
 			 int remove, int reset)
 {
 	ftrace_ops_init(ops);
-	return ftrace_set_addr(ops, ip, remove, reset, 1);
+	return ftrace_set_addr(ops, &ip, ip ? 1 : 0, remove, reset, 1);
 }
 EXPORT_SYMBOL_GPL(ftrace_set_filter_ip);
 
+/**
+ * ftrace_set_filter_ips - set functions to filter on in ftrace by addresses
+ * @ops - the ops to set the filter with
+ * @ips - the array of addresses to add to or remove from the filter.
+ * @cnt - the number of addresses in @ips
+ * @remove - non zero to remove ips from the filter
+ * @reset - non zero to reset all filters before applying this filter.
+ *
+ * Like ftrace_set_filter_ip(), but the whole array is applied with a
+ * single update of the filter, so the call sites are patched in one pass.
+ */
+int ftrace_set_filter_ips(struct ftrace_ops *ops, unsigned long *ips,
+			  unsigned int cnt, int remove, int reset)
+{
+	ftrace_ops_init(ops);
+	return ftrace_set_addr(ops, ips, cnt, remove, reset, 1);
+}
+EXPORT_SYMBOL_GPL(ftrace_set_filter_ips);
+
 /**
  * ftrace_ops_set_global_filter - setup ops to use global filters
  * @ops - the ops which will use the global filters
@@ -5438,7 +5670,7 @@ static int
 ftrace_set_regex(struct ftrace_ops *ops, unsigned char *buf, int len,
 		 int reset, int enable)
 {
-	return ftrace_set_hash(ops, buf, len, 0, 0, reset, enable);
+	return ftrace_set_hash(ops, buf, len, NULL, 0, 0, reset, enable);
 }
 
 /**
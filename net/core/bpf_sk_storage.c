@@ -61,6 +61,7 @@ void bpf_sk_storage_free(struct sock *sk)
 	struct bpf_local_storage *sk_storage;
 	bool free_sk_storage = false;
 	struct hlist_node *n;
+	unsigned long flags;
 
 	rcu_read_lock();
 	sk_storage = rcu_dereference(sk->sk_bpf_storage);
@@ -78,7 +79,7 @@ void bpf_sk_storage_free(struct sock *sk)
 	 * when unlinking elem from the sk_storage->list and
 	 * the map's bucket->list.
 	 */
-	raw_spin_lock_bh(&sk_storage->lock);
+	raw_spin_lock_irqsave(&sk_storage->lock, flags);
 	hlist_for_each_entry_safe(selem, n, &sk_storage->list, snode) {
 		/* Always unlink from map before unlinking from
 		 * sk_storage.
@@ -87,7 +88,7 @@ void bpf_sk_storage_free(struct sock *sk)
 		free_sk_storage = bpf_selem_unlink_storage_nolock(sk_storage,
 								  selem, true);
 	}
-	raw_spin_unlock_bh(&sk_storage->lock);
+	raw_spin_unlock_irqrestore(&sk_storage->lock, flags);
 	rcu_read_unlock();
 
 	if (free_sk_storage)
@@ -100,7 +101,7 @@ static void sk_storage_map_free(struct bpf_map *map)
 
 	smap = (struct bpf_local_storage_map *)map;
 	bpf_local_storage_cache_idx_free(&sk_cache, smap->cache_idx);
-	bpf_local_storage_map_free(smap);
+	bpf_local_storage_map_free(smap, NULL);
 }
 
 static struct bpf_map *sk_storage_map_alloc(union bpf_attr *attr)
@@ -6679,6 +6679,38 @@ static void init_gro_hash(struct napi_struct *napi)
 	napi->gro_bitmask = 0;
 }
 
+/**
+ * napi_gro_init - prepare a napi_struct for GRO outside of NAPI polling
+ * @napi: NAPI context, only its GRO state is used
+ *
+ * For callers that feed packets to napi_gro_receive() from their own
+ * context, e.g. a kthread, instead of from a poll routine. @napi is never
+ * scheduled nor added to a device, and the caller completes GRO itself
+ * with napi_gro_flush_list(). Must not be used concurrently.
+ */
+void napi_gro_init(struct napi_struct *napi)
+{
+	init_gro_hash(napi);
+	INIT_LIST_HEAD(&napi->rx_list);
+	napi->rx_count = 0;
+}
+EXPORT_SYMBOL(napi_gro_init);
+
+/**
+ * napi_gro_flush_list - complete GRO and pass the packets up as a list
+ * @napi: NAPI context set up by napi_gro_init()
+ * @flush_old: only complete the packets held since an earlier jiffy
+ *
+ * This is what napi_complete_done() does for a polled NAPI instance.
+ * Must be called with BHs disabled.
+ */
+void napi_gro_flush_list(struct napi_struct *napi, bool flush_old)
+{
+	napi_gro_flush(napi, flush_old);
+	gro_normal_list(napi);
+}
+EXPORT_SYMBOL(napi_gro_flush_list);
+
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
@@ -2257,10 +2257,7 @@ static void *listening_get_next(struct seq_file *seq, void *cur)
 	struct hlist_nulls_node *node;
 	struct sock *sk = cur;
 
-	if (st->bpf_seq_afinfo)
-		afinfo = st->bpf_seq_afinfo;
-	else
-		afinfo = PDE_DATA(file_inode(seq->file));
+	afinfo = PDE_DATA(file_inode(seq->file));
 
 	if (!sk) {
 get_head:
@@ -2322,10 +2319,7 @@ static void *established_get_first(struct seq_file *seq)
 	struct net *net = seq_file_net(seq);
 	void *rc = NULL;
 
-	if (st->bpf_seq_afinfo)
-		afinfo = st->bpf_seq_afinfo;
-	else
-		afinfo = PDE_DATA(file_inode(seq->file));
+	afinfo = PDE_DATA(file_inode(seq->file));
 
 	st->offset = 0;
 	for (; st->bucket <= tcp_hashinfo.ehash_mask; ++st->bucket) {
@@ -2361,10 +2355,7 @@ static void *established_get_next(struct seq_file *seq, void *cur)
 	struct tcp_iter_state *st = seq->private;
 	struct net *net = seq_file_net(seq);
 
-	if (st->bpf_seq_afinfo)
-		afinfo = st->bpf_seq_afinfo;
-	else
-		afinfo = PDE_DATA(file_inode(seq->file));
+	afinfo = PDE_DATA(file_inode(seq->file));
 
 	++st->num;
 	++st->offset;
@@ -2653,14 +2644,35 @@ static int tcp4_seq_show(struct seq_file *seq, void *v)
 }
 
 #ifdef CONFIG_BPF_SYSCALL
+/* The bpf iterator does not hold a bucket lock while the program runs.
+ * The sockets of one bucket are batched under the lock with a reference
+ * held on each, and shown after it is dropped. What is left of a batch
+ * when a read() ends is kept for the next read(), so a walk over many
+ * reads neither rescans the table from the start nor skips or repeats
+ * sockets.
+ */
+struct bpf_tcp_iter_state {
+	struct tcp_iter_state state;
+	unsigned int cur_sk;
+	unsigned int end_sk;
+	unsigned int max_sk;
+	struct sock **batch;
+	/* Skip up to and including this socket in the first bucket batched */
+	u64 seek_cookie;
+};
+
 struct bpf_iter__tcp {
 	__bpf_md_ptr(struct bpf_iter_meta *, meta);
 	__bpf_md_ptr(struct sock_common *, sk_common);
 	uid_t uid __aligned(8);
+	int bucket __aligned(8);
 };
 
+#define BPF_TCP_ITER_INIT_BATCH	16
+
 static int tcp_prog_seq_show(struct bpf_prog *prog, struct bpf_iter_meta *meta,
-			     struct sock_common *sk_common, uid_t uid)
+			     struct sock_common *sk_common, uid_t uid,
+			     int bucket)
 {
 	struct bpf_iter__tcp ctx;
 
@@ -2668,14 +2680,174 @@ static int tcp_prog_seq_show(struct bpf_prog *prog, struct bpf_iter_meta *meta,
 	ctx.meta = meta;
 	ctx.sk_common = sk_common;
 	ctx.uid = uid;
+	ctx.bucket = bucket;
 	return bpf_iter_run_prog(prog, &ctx);
 }
 
+static int bpf_iter_tcp_realloc_batch(struct bpf_tcp_iter_state *iter,
+				      unsigned int new_batch_sz)
+{
+	struct sock **new_batch;
+
+	new_batch = kvmalloc_array(new_batch_sz, sizeof(*new_batch),
+				   GFP_USER | __GFP_NOWARN);
+	if (!new_batch)
+		return -ENOMEM;
+
+	kvfree(iter->batch);
+	iter->batch = new_batch;
+	iter->max_sk = new_batch_sz;
+	return 0;
+}
+
+static void bpf_iter_tcp_put_batch(struct bpf_tcp_iter_state *iter)
+{
+	while (iter->cur_sk < iter->end_sk)
+		sock_gen_put(iter->batch[iter->cur_sk++]);
+}
+
+/* Called with the bucket lock held. Takes a reference on the sockets of
+ * the chain starting at sk, as many as fit in the batch, and returns how
+ * many there are.
+ */
+static unsigned int bpf_iter_tcp_fill(struct seq_file *seq, struct sock *sk)
+{
+	struct bpf_tcp_iter_state *iter = seq->private;
+	struct net *net = seq_file_net(seq);
+	struct hlist_nulls_node *node;
+	unsigned int expected = 0;
+	struct sock *start = sk;
+
+	if (iter->seek_cookie) {
+		sk_nulls_for_each_from(sk, node) {
+			if (atomic64_read(&sk->sk_cookie) == iter->seek_cookie) {
+				start = sk_nulls_next(sk);
+				break;
+			}
+		}
+	}
+
+	sk = start;
+	sk_nulls_for_each_from(sk, node) {
+		if (!net_eq(sock_net(sk), net))
+			continue;
+		if (expected++ < iter->max_sk) {
+			sock_hold(sk);
+			iter->batch[iter->end_sk++] = sk;
+		}
+	}
+
+	return expected;
+}
+
+/* Batch the first bucket from st->bucket on that has sockets of this netns */
+static unsigned int bpf_iter_tcp_fill_bucket(struct seq_file *seq)
+{
+	struct bpf_tcp_iter_state *iter = seq->private;
+	struct tcp_iter_state *st = &iter->state;
+	struct inet_listen_hashbucket *ilb;
+	unsigned int expected;
+	spinlock_t *lock;
+
+	if (st->state == TCP_SEQ_STATE_LISTENING) {
+		for (; st->bucket < INET_LHTABLE_SIZE; st->bucket++) {
+			ilb = &tcp_hashinfo.listening_hash[st->bucket];
+			if (hlist_nulls_empty(&ilb->nulls_head))
+				continue;
+
+			spin_lock(&ilb->lock);
+			expected = bpf_iter_tcp_fill(seq,
+					sk_nulls_head(&ilb->nulls_head));
+			spin_unlock(&ilb->lock);
+			if (expected)
+				return expected;
+		}
+		st->state = TCP_SEQ_STATE_ESTABLISHED;
+		st->bucket = 0;
+	}
+
+	for (; st->bucket <= tcp_hashinfo.ehash_mask; st->bucket++) {
+		if (empty_bucket(st))
+			continue;
+
+		lock = inet_ehash_lockp(&tcp_hashinfo, st->bucket);
+		spin_lock_bh(lock);
+		expected = bpf_iter_tcp_fill(seq,
+				sk_nulls_head(&tcp_hashinfo.ehash[st->bucket].chain));
+		spin_unlock_bh(lock);
+		if (expected)
+			return expected;
+	}
+
+	return 0;
+}
+
+static struct sock *bpf_iter_tcp_batch(struct seq_file *seq)
+{
+	struct bpf_tcp_iter_state *iter = seq->private;
+	unsigned int expected;
+	bool resized = false;
+
+again:
+	iter->cur_sk = 0;
+	iter->end_sk = 0;
+	expected = bpf_iter_tcp_fill_bucket(seq);
+	if (!expected)
+		return NULL;
+
+	/* Retry the bucket once with a batch that fits it. If that cannot
+	 * be allocated, or the bucket grew again meanwhile, the sockets that
+	 * do not fit are skipped.
+	 */
+	if (iter->end_sk < expected && !resized) {
+		bpf_iter_tcp_put_batch(iter);
+		bpf_iter_tcp_realloc_batch(iter, expected * 3 / 2);
+		resized = true;
+		goto again;
+	}
+
+	iter->seek_cookie = 0;
+	return iter->batch[0];
+}
+
+static void *bpf_iter_tcp_seq_start(struct seq_file *seq, loff_t *pos)
+{
+	struct bpf_tcp_iter_state *iter = seq->private;
+
+	if (!*pos)
+		return SEQ_START_TOKEN;
+
+	/* Carry on with the batch the previous read() stopped in */
+	if (iter->cur_sk < iter->end_sk)
+		return iter->batch[iter->cur_sk];
+
+	return bpf_iter_tcp_batch(seq);
+}
+
+static void *bpf_iter_tcp_seq_next(struct seq_file *seq, void *v, loff_t *pos)
+{
+	struct bpf_tcp_iter_state *iter = seq->private;
+	struct tcp_iter_state *st = &iter->state;
+
+	++*pos;
+	if (v != SEQ_START_TOKEN) {
+		sock_gen_put(iter->batch[iter->cur_sk++]);
+		if (iter->cur_sk < iter->end_sk)
+			return iter->batch[iter->cur_sk];
+		st->bucket++;
+	}
+
+	return bpf_iter_tcp_batch(seq);
+}
+
 static int bpf_iter_tcp_seq_show(struct seq_file *seq, void *v)
 {
+	struct bpf_tcp_iter_state *iter = seq->private;
+	struct tcp_iter_state *st = &iter->state;
 	struct bpf_iter_meta meta;
 	struct bpf_prog *prog;
 	struct sock *sk = v;
+	int bucket;
 	uid_t uid;
 
 	if (v == SEQ_START_TOKEN)
@@ -2692,9 +2864,14 @@ static int bpf_iter_tcp_seq_show(struct seq_file *seq, void *v)
 		uid = from_kuid_munged(seq_user_ns(seq), sock_i_uid(sk));
 	}
 
+	/* The listening buckets are numbered first, then the ehash ones */
+	bucket = st->bucket;
+	if (st->state == TCP_SEQ_STATE_ESTABLISHED)
+		bucket += INET_LHTABLE_SIZE;
+
 	meta.seq = seq;
 	prog = bpf_iter_get_info(&meta, false);
-	return tcp_prog_seq_show(prog, &meta, v, uid);
+	return tcp_prog_seq_show(prog, &meta, v, uid, bucket);
 }
 
 static void bpf_iter_tcp_seq_stop(struct seq_file *seq, void *v)
@@ -2706,16 +2883,14 @@ static void bpf_iter_tcp_seq_stop(struct seq_file *seq, void *v)
 		meta.seq = seq;
 		prog = bpf_iter_get_info(&meta, true);
 		if (prog)
-			(void)tcp_prog_seq_show(prog, &meta, v, 0);
+			(void)tcp_prog_seq_show(prog, &meta, v, 0, 0);
 	}
-
-	tcp_seq_stop(seq, v);
 }
 
 static const struct seq_operations bpf_iter_tcp_seq_ops = {
 	.show		= bpf_iter_tcp_seq_show,
-	.start		= tcp_seq_start,
-	.next		= tcp_seq_next,
+	.start		= bpf_iter_tcp_seq_start,
+	.next		= bpf_iter_tcp_seq_next,
 	.stop		= bpf_iter_tcp_seq_stop,
 };
 #endif
@@ -2949,31 +3124,43 @@ static struct pernet_operations __net_initdata tcp_sk_ops = {
 
 #if defined(CONFIG_BPF_SYSCALL) && defined(CONFIG_PROC_FS)
 DEFINE_BPF_ITER_FUNC(tcp, struct bpf_iter_meta *meta,
-		     struct sock_common *sk_common, uid_t uid)
+		     struct sock_common *sk_common, uid_t uid, int bucket)
 
 static int bpf_iter_init_tcp(void *priv_data, struct bpf_iter_aux_info *aux)
 {
-	struct tcp_iter_state *st = priv_data;
-	struct tcp_seq_afinfo *afinfo;
+	struct bpf_tcp_iter_state *iter = priv_data;
+	struct tcp_iter_state *st = &iter->state;
+	u32 bucket = aux->sock.bucket;
 	int ret;
 
-	afinfo = kmalloc(sizeof(*afinfo), GFP_USER | __GFP_NOWARN);
-	if (!afinfo)
-		return -ENOMEM;
-
-	afinfo->family = AF_UNSPEC;
-	st->bpf_seq_afinfo = afinfo;
 	ret = bpf_iter_init_seq_net(priv_data, aux);
 	if (ret)
-		kfree(afinfo);
-	return ret;
+		return ret;
+
+	ret = bpf_iter_tcp_realloc_batch(iter, BPF_TCP_ITER_INIT_BATCH);
+	if (ret) {
+		bpf_iter_fini_seq_net(priv_data);
+		return ret;
+	}
+
+	if (bucket < INET_LHTABLE_SIZE) {
+		st->state = TCP_SEQ_STATE_LISTENING;
+		st->bucket = bucket;
+	} else {
+		st->state = TCP_SEQ_STATE_ESTABLISHED;
+		st->bucket = min_t(u32, bucket - INET_LHTABLE_SIZE,
+				   tcp_hashinfo.ehash_mask + 1);
+	}
+	iter->seek_cookie = aux->sock.cookie;
+	return 0;
 }
 
 static void bpf_iter_fini_tcp(void *priv_data)
 {
-	struct tcp_iter_state *st = priv_data;
+	struct bpf_tcp_iter_state *iter = priv_data;
 
-	kfree(st->bpf_seq_afinfo);
+	bpf_iter_tcp_put_batch(iter);
+	kvfree(iter->batch);
 	bpf_iter_fini_seq_net(priv_data);
 }
 
@@ -2981,11 +3168,13 @@ static const struct bpf_iter_seq_info tcp_seq_info = {
 	.seq_ops		= &bpf_iter_tcp_seq_ops,
 	.init_seq_private	= bpf_iter_init_tcp,
 	.fini_seq_private	= bpf_iter_fini_tcp,
-	.seq_priv_size		= sizeof(struct tcp_iter_state),
+	.seq_priv_size		= sizeof(struct bpf_tcp_iter_state),
 };
 
 static struct bpf_iter_reg tcp_reg_info = {
 	.target			= "tcp",
+	.attach_target		= bpf_iter_attach_sock,
+	.show_fdinfo		= bpf_iter_sock_show_fdinfo,
 	.ctx_arg_info_size	= 1,
 	.ctx_arg_info		= {
 		{ offsetof(struct bpf_iter__tcp, sk_common),
@@ -2866,10 +2866,7 @@ static struct sock *udp_get_first(struct seq_file *seq, int start)
 	struct udp_iter_state *state = seq->private;
 	struct net *net = seq_file_net(seq);
 
-	if (state->bpf_seq_afinfo)
-		afinfo = state->bpf_seq_afinfo;
-	else
-		afinfo = PDE_DATA(file_inode(seq->file));
+	afinfo = PDE_DATA(file_inode(seq->file));
 
 	for (state->bucket = start; state->bucket <= afinfo->udp_table->mask;
 	     ++state->bucket) {
@@ -2899,10 +2896,7 @@ static struct sock *udp_get_next(struct seq_file *seq, struct sock *sk)
 	struct udp_iter_state *state = seq->private;
 	struct net *net = seq_file_net(seq);
 
-	if (state->bpf_seq_afinfo)
-		afinfo = state->bpf_seq_afinfo;
-	else
-		afinfo = PDE_DATA(file_inode(seq->file));
+	afinfo = PDE_DATA(file_inode(seq->file));
 
 	do {
 		sk = sk_next(sk);
@@ -2956,10 +2950,7 @@ void udp_seq_stop(struct seq_file *seq, void *v)
 	struct udp_seq_afinfo *afinfo;
 	struct udp_iter_state *state = seq->private;
 
-	if (state->bpf_seq_afinfo)
-		afinfo = state->bpf_seq_afinfo;
-	else
-		afinfo = PDE_DATA(file_inode(seq->file));
+	afinfo = PDE_DATA(file_inode(seq->file));
 
 	if (state->bucket <= afinfo->udp_table->mask)
 		spin_unlock_bh(&afinfo->udp_table->hash[state->bucket].lock);
@@ -3005,6 +2996,20 @@ int udp4_seq_show(struct seq_file *seq, void *v)
 }
 
 #ifdef CONFIG_BPF_SYSCALL
+/* Like the tcp iterator, the sockets of one hash slot are batched under
+ * its lock and shown after it is dropped, and what is left of a batch
+ * when a read() ends is kept for the next read().
+ */
+struct bpf_udp_iter_state {
+	struct udp_iter_state state;
+	unsigned int cur_sk;
+	unsigned int end_sk;
+	unsigned int max_sk;
+	struct sock **batch;
+	/* Skip up to and including this socket in the first slot batched */
+	u64 seek_cookie;
+};
+
 struct bpf_iter__udp {
 	__bpf_md_ptr(struct bpf_iter_meta *, meta);
 	__bpf_md_ptr(struct udp_sock *, udp_sk);
@@ -3012,6 +3017,8 @@ struct bpf_iter__udp {
 	int bucket __aligned(8);
 };
 
+#define BPF_UDP_ITER_INIT_BATCH	16
+
 static int udp_prog_seq_show(struct bpf_prog *prog, struct bpf_iter_meta *meta,
 			     struct udp_sock *udp_sk, uid_t uid, int bucket)
 {
@@ -3025,6 +3032,131 @@ static int udp_prog_seq_show(struct bpf_prog *prog, struct bpf_iter_meta *meta,
 	return bpf_iter_run_prog(prog, &ctx);
 }
 
+static int bpf_iter_udp_realloc_batch(struct bpf_udp_iter_state *iter,
+				      unsigned int new_batch_sz)
+{
+	struct sock **new_batch;
+
+	new_batch = kvmalloc_array(new_batch_sz, sizeof(*new_batch),
+				   GFP_USER | __GFP_NOWARN);
+	if (!new_batch)
+		return -ENOMEM;
+
+	kvfree(iter->batch);
+	iter->batch = new_batch;
+	iter->max_sk = new_batch_sz;
+	return 0;
+}
+
+static void bpf_iter_udp_put_batch(struct bpf_udp_iter_state *iter)
+{
+	while (iter->cur_sk < iter->end_sk)
+		sock_put(iter->batch[iter->cur_sk++]);
+}
+
+/* Batch the first slot from state->bucket on that has sockets of this
+ * netns. Returns how many sockets it has, which may be more than fit.
+ */
+static unsigned int bpf_iter_udp_fill_bucket(struct seq_file *seq)
+{
+	struct bpf_udp_iter_state *iter = seq->private;
+	struct udp_iter_state *state = &iter->state;
+	struct net *net = seq_file_net(seq);
+	struct sock *sk, *start;
+	unsigned int expected;
+
+	for (; state->bucket <= udp_table.mask; state->bucket++) {
+		struct udp_hslot *hslot = &udp_table.hash[state->bucket];
+
+		if (hlist_empty(&hslot->head))
+			continue;
+
+		expected = 0;
+		spin_lock_bh(&hslot->lock);
+		start = sk_head(&hslot->head);
+		if (iter->seek_cookie) {
+			sk_for_each(sk, &hslot->head) {
+				if (atomic64_read(&sk->sk_cookie) ==
+				    iter->seek_cookie) {
+					start = sk_next(sk);
+					break;
+				}
+			}
+		}
+		sk = start;
+		sk_for_each_from(sk) {
+			if (!net_eq(sock_net(sk), net))
+				continue;
+			if (expected++ < iter->max_sk) {
+				sock_hold(sk);
+				iter->batch[iter->end_sk++] = sk;
+			}
+		}
+		spin_unlock_bh(&hslot->lock);
+
+		if (expected)
+			return expected;
+	}
+
+	return 0;
+}
+
+static struct sock *bpf_iter_udp_batch(struct seq_file *seq)
+{
+	struct bpf_udp_iter_state *iter = seq->private;
+	unsigned int expected;
+	bool resized = false;
+
+again:
+	iter->cur_sk = 0;
+	iter->end_sk = 0;
+	expected = bpf_iter_udp_fill_bucket(seq);
+	if (!expected)
+		return NULL;
+
+	/* Retry the slot once with a batch that fits it, see
+	 * bpf_iter_tcp_batch().
+	 */
+	if (iter->end_sk < expected && !resized) {
+		bpf_iter_udp_put_batch(iter);
+		bpf_iter_udp_realloc_batch(iter, expected * 3 / 2);
+		resized = true;
+		goto again;
+	}
+
+	iter->seek_cookie = 0;
+	return iter->batch[0];
+}
+
+static void *bpf_iter_udp_seq_start(struct seq_file *seq, loff_t *pos)
+{
+	struct bpf_udp_iter_state *iter = seq->private;
+
+	if (!*pos)
+		return SEQ_START_TOKEN;
+
+	/* Carry on with the batch the previous read() stopped in */
+	if (iter->cur_sk < iter->end_sk)
+		return iter->batch[iter->cur_sk];
+
+	return bpf_iter_udp_batch(seq);
+}
+
+static void *bpf_iter_udp_seq_next(struct seq_file *seq, void *v, loff_t *pos)
+{
+	struct bpf_udp_iter_state *iter = seq->private;
+
+	++*pos;
+	if (v != SEQ_START_TOKEN) {
+		sock_put(iter->batch[iter->cur_sk++]);
+		if (iter->cur_sk < iter->end_sk)
+			return iter->batch[iter->cur_sk];
+		iter->state.bucket++;
+	}
+
+	return bpf_iter_udp_batch(seq);
+}
+
 static int bpf_iter_udp_seq_show(struct seq_file *seq, void *v)
 {
 	struct udp_iter_state *state = seq->private;
@@ -3053,13 +3185,11 @@ static void bpf_iter_udp_seq_stop(struct seq_file *seq, void *v)
 		if (prog)
 			(void)udp_prog_seq_show(prog, &meta, v, 0, 0);
 	}
-
-	udp_seq_stop(seq, v);
 }
 
 static const struct seq_operations bpf_iter_udp_seq_ops = {
-	.start		= udp_seq_start,
-	.next		= udp_seq_next,
+	.start		= bpf_iter_udp_seq_start,
+	.next		= bpf_iter_udp_seq_next,
 	.stop		= bpf_iter_udp_seq_stop,
 	.show		= bpf_iter_udp_seq_show,
 };
@@ -3188,28 +3318,30 @@ DEFINE_BPF_ITER_FUNC(udp, struct bpf_iter_meta *meta,
 
 static int bpf_iter_init_udp(void *priv_data, struct bpf_iter_aux_info *aux)
 {
-	struct udp_iter_state *st = priv_data;
-	struct udp_seq_afinfo *afinfo;
+	struct bpf_udp_iter_state *iter = priv_data;
 	int ret;
 
-	afinfo = kmalloc(sizeof(*afinfo), GFP_USER | __GFP_NOWARN);
-	if (!afinfo)
-		return -ENOMEM;
-
-	afinfo->family = AF_UNSPEC;
-	afinfo->udp_table = &udp_table;
-	st->bpf_seq_afinfo = afinfo;
 	ret = bpf_iter_init_seq_net(priv_data, aux);
 	if (ret)
-		kfree(afinfo);
-	return ret;
+		return ret;
+
+	ret = bpf_iter_udp_realloc_batch(iter, BPF_UDP_ITER_INIT_BATCH);
+	if (ret) {
+		bpf_iter_fini_seq_net(priv_data);
+		return ret;
+	}
+
+	iter->state.bucket = min_t(u32, aux->sock.bucket, udp_table.mask + 1);
+	iter->seek_cookie = aux->sock.cookie;
+	return 0;
 }
 
 static void bpf_iter_fini_udp(void *priv_data)
 {
-	struct udp_iter_state *st = priv_data;
+	struct bpf_udp_iter_state *iter = priv_data;
 
-	kfree(st->bpf_seq_afinfo);
+	bpf_iter_udp_put_batch(iter);
+	kvfree(iter->batch);
 	bpf_iter_fini_seq_net(priv_data);
 }
 
@@ -3217,11 +3349,13 @@ static const struct bpf_iter_seq_info udp_seq_info = {
 	.seq_ops		= &bpf_iter_udp_seq_ops,
 	.init_seq_private	= bpf_iter_init_udp,
 	.fini_seq_private	= bpf_iter_fini_udp,
-	.seq_priv_size		= sizeof(struct udp_iter_state),
+	.seq_priv_size		= sizeof(struct bpf_udp_iter_state),
 };
 
 static struct bpf_iter_reg udp_reg_info = {
 	.target			= "udp",
+	.attach_target		= bpf_iter_attach_sock,
+	.show_fdinfo		= bpf_iter_sock_show_fdinfo,
 	.ctx_arg_info_size	= 1,
 	.ctx_arg_info		= {
 		{ offsetof(struct bpf_iter__udp, udp_sk),
@@ -72,6 +72,7 @@ class HeaderParser(object):
         self.reader = open(filename, 'r')
         self.line = ''
         self.helpers = []
+        self.helper_ids = {}
 
     def parse_helper(self):
         proto    = self.parse_proto()
@@ -157,8 +158,22 @@ class HeaderParser(object):
             except NoHelperFound:
                 break
 
+        self.parse_helper_ids()
         self.reader.close()
 
+    def parse_helper_ids(self):
+        # Helper IDs are positions in __BPF_FUNC_MAPPER, not in the list of
+        # descriptions: the mapper may reserve IDs for undocumented helpers.
+        self.reader.seek(0)
+        text = self.reader.read()
+        offset = text.find('#define __BPF_FUNC_MAPPER(FN)')
+        if offset == -1:
+            raise Exception('Could not find __BPF_FUNC_MAPPER')
+        offset = text.find('\n', offset)
+        end = text.find('/* */', offset)
+        names = re.findall(r'FN\((\w+)\)', text[offset:end])
+        self.helper_ids = { 'bpf_' + n: i for i, n in enumerate(names) }
+
 ###############################################################################
 
 class Printer(object):
@@ -400,7 +415,11 @@ class PrinterHelpers(Printer):
     A printer for dumping collected information about helpers as C header to
     be included from BPF program.
     @helpers: array of Helper objects to print to standard output
+    @helper_ids: dictionary mapping helper names to their BPF_FUNC_* IDs
     """
+    def __init__(self, helpers, helper_ids):
+        self.helpers = helpers
+        self.helper_ids = helper_ids
 
     type_fwds = [
             'struct bpf_fib_lookup',
@@ -569,7 +588,7 @@ class PrinterHelpers(Printer):
             comma = ', '
             print(one_arg, end='')
 
-        print(') = (void *) %d;' % len(self.seen_helpers))
+        print(') = (void *) %d;' % self.helper_ids[proto['name']])
         print('')
 
 ###############################################################################
@@ -601,7 +620,7 @@ headerParser.run()
 
 # Print formatted output to standard output.
 if args.header:
-    printer = PrinterHelpers(headerParser.helpers)
+    printer = PrinterHelpers(headerParser.helpers, headerParser.helper_ids)
 else:
     printer = PrinterRST(headerParser.helpers)
 printer.print_all()
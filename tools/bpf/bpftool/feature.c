@@ -718,8 +718,12 @@ static void section_map_types(const char *define_prefix, __u32 ifindex)
 			    "/*** eBPF map types ***/",
 			    define_prefix);
 
-	for (i = BPF_MAP_TYPE_UNSPEC + 1; i < map_type_name_size; i++)
+	for (i = BPF_MAP_TYPE_UNSPEC + 1; i < map_type_name_size; i++) {
+		/* skip the hole below the local map types */
+		if (!map_type_name[i])
+			continue;
 		probe_map_type(i, define_prefix, ifindex);
+	}
 
 	print_end_section();
 }
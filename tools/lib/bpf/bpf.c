@@ -76,7 +76,7 @@ static inline int sys_bpf_prog_load(union bpf_attr *attr, unsigned int size)
 	return fd;
 }
 
-int bpf_create_map_xattr(const struct bpf_create_map_attr *create_attr)
+int libbpf__bpf_create_map_xattr(const struct bpf_create_map_params *create_attr)
 {
 	union bpf_attr attr;
 
@@ -100,10 +100,35 @@ int bpf_create_map_xattr(const struct bpf_create_map_attr *create_attr)
 			create_attr->btf_vmlinux_value_type_id;
 	else
 		attr.inner_map_fd = create_attr->inner_map_fd;
+	attr.map_extra = create_attr->map_extra;
 
 	return sys_bpf(BPF_MAP_CREATE, &attr, sizeof(attr));
 }
 
+int bpf_create_map_xattr(const struct bpf_create_map_attr *create_attr)
+{
+	struct bpf_create_map_params p = {};
+
+	p.map_type = create_attr->map_type;
+	p.key_size = create_attr->key_size;
+	p.value_size = create_attr->value_size;
+	p.max_entries = create_attr->max_entries;
+	p.map_flags = create_attr->map_flags;
+	p.name = create_attr->name;
+	p.numa_node = create_attr->numa_node;
+	p.btf_fd = create_attr->btf_fd;
+	p.btf_key_type_id = create_attr->btf_key_type_id;
+	p.btf_value_type_id = create_attr->btf_value_type_id;
+	p.map_ifindex = create_attr->map_ifindex;
+	if (p.map_type == BPF_MAP_TYPE_STRUCT_OPS)
+		p.btf_vmlinux_value_type_id =
+			create_attr->btf_vmlinux_value_type_id;
+	else
+		p.inner_map_fd = create_attr->inner_map_fd;
+
+	return libbpf__bpf_create_map_xattr(&p);
+}
+
 int bpf_create_map_node(enum bpf_map_type map_type, const char *name,
 			int key_size, int value_size, int max_entries,
 			__u32 map_flags, int node)
@@ -586,7 +611,7 @@ int bpf_link_create(int prog_fd, int target_fd,
 		    enum bpf_attach_type attach_type,
 		    const struct bpf_link_create_opts *opts)
 {
-	__u32 target_btf_id, iter_info_len;
+	__u32 target_btf_id, iter_info_len, btf_ids_cnt;
 	union bpf_attr attr;
 
 	if (!OPTS_VALID(opts, bpf_link_create_opts))
@@ -594,8 +619,9 @@ int bpf_link_create(int prog_fd, int target_fd,
 
 	iter_info_len = OPTS_GET(opts, iter_info_len, 0);
 	target_btf_id = OPTS_GET(opts, target_btf_id, 0);
+	btf_ids_cnt = OPTS_GET(opts, btf_ids_cnt, 0);
 
-	if (iter_info_len && target_btf_id)
+	if (!!iter_info_len + !!target_btf_id + !!btf_ids_cnt > 1)
 		return -EINVAL;
 
 	memset(&attr, 0, sizeof(attr));
@@ -610,6 +636,10 @@ int bpf_link_create(int prog_fd, int target_fd,
 		attr.link_create.iter_info_len = iter_info_len;
 	} else if (target_btf_id) {
 		attr.link_create.target_btf_id = target_btf_id;
+	} else if (btf_ids_cnt) {
+		attr.link_create.tracing_multi.btf_ids =
+			ptr_to_u64(OPTS_GET(opts, btf_ids, (void *)0));
+		attr.link_create.tracing_multi.btf_ids_cnt = btf_ids_cnt;
 	}
 
 	return sys_bpf(BPF_LINK_CREATE, &attr, sizeof(attr));
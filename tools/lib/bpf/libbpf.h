@@ -451,6 +451,8 @@ LIBBPF_API int bpf_map__set_map_flags(struct bpf_map *map, __u32 flags);
 /* get/set map NUMA node */
 LIBBPF_API __u32 bpf_map__numa_node(const struct bpf_map *map);
 LIBBPF_API int bpf_map__set_numa_node(struct bpf_map *map, __u32 numa_node);
+LIBBPF_API __u64 bpf_map__map_extra(const struct bpf_map *map);
+LIBBPF_API int bpf_map__set_map_extra(struct bpf_map *map, __u64 map_extra);
 /* get/set map key size */
 LIBBPF_API __u32 bpf_map__key_size(const struct bpf_map *map);
 LIBBPF_API int bpf_map__set_key_size(struct bpf_map *map, __u32 size);
@@ -0,0 +1,251 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <argp.h>
+#include <limits.h>
+#include <linux/kernel.h>
+#include "bench.h"
+#include "bloom_filter_bench.skel.h"
+
+static struct ctx {
+	struct bloom_filter_bench *skel;
+} ctx;
+
+static struct {
+	__u32 nr_entries;
+	__u8 nr_hash_funcs;
+	__u8 hit_pct;
+} args = {
+	.nr_entries = 1000000,
+	.nr_hash_funcs = 3,
+	.hit_pct = 0,
+};
+
+enum {
+	ARG_NR_ENTRIES = 3000,
+	ARG_NR_HASH_FUNCS = 3001,
+	ARG_HIT_PCT = 3002,
+};
+
+static const struct argp_option opts[] = {
+	{ "nr_entries", ARG_NR_ENTRIES, "NR_ENTRIES", 0,
+	  "Set number of expected unique entries in the bloom filter"},
+	{ "nr_hash_funcs", ARG_NR_HASH_FUNCS, "NR_HASH_FUNCS", 0,
+	  "Set number of hash functions in the bloom filter"},
+	{ "hit_pct", ARG_HIT_PCT, "PCT", 0,
+	  "Set percentage of lookups for values which are present"},
+	{},
+};
+
+static error_t parse_arg(int key, char *arg, struct argp_state *state)
+{
+	long ret;
+
+	switch (key) {
+	case ARG_NR_ENTRIES:
+		ret = strtol(arg, NULL, 10);
+		if (ret < 1 || ret > UINT_MAX) {
+			fprintf(stderr, "Invalid nr_entries count.");
+			argp_usage(state);
+		}
+		args.nr_entries = ret;
+		break;
+	case ARG_NR_HASH_FUNCS:
+		ret = strtol(arg, NULL, 10);
+		if (ret < 1 || ret > 15) {
+			fprintf(stderr,
+				"The bloom filter must use 1 to 15 hash functions.");
+			argp_usage(state);
+		}
+		args.nr_hash_funcs = ret;
+		break;
+	case ARG_HIT_PCT:
+		ret = strtol(arg, NULL, 10);
+		if (ret < 0 || ret > 100) {
+			fprintf(stderr, "Invalid hit percentage.");
+			argp_usage(state);
+		}
+		args.hit_pct = ret;
+		break;
+	default:
+		return ARGP_ERR_UNKNOWN;
+	}
+
+	return 0;
+}
+
+/* exported into benchmark runner */
+const struct argp bench_bloom_map_argp = {
+	.options = opts,
+	.parser = parse_arg,
+};
+
+static void validate(void)
+{
+	if (env.consumer_cnt != 1) {
+		fprintf(stderr,
+			"The bloom filter benchmarks do not support multi-consumer use\n");
+		exit(1);
+	}
+}
+
+static inline void trigger_bpf_program(void)
+{
+	syscall(__NR_getpgid);
+}
+
+static void *producer(void *input)
+{
+	while (true)
+		trigger_bpf_program();
+
+	return NULL;
+}
+
+static void *consumer(void *input)
+{
+	return NULL;
+}
+
+static __u64 rand_u64(void)
+{
+	return (__u64)rand() << 32 | rand();
+}
+
+static void populate_maps(void)
+{
+	int bloom_fd = bpf_map__fd(ctx.skel->maps.bloom_map);
+	int hashmap_fd = bpf_map__fd(ctx.skel->maps.hashmap);
+	__u64 *lookup_vals = ctx.skel->bss->lookup_vals;
+	__u32 nr_lookups = ARRAY_SIZE(ctx.skel->bss->lookup_vals);
+	__u32 i, j, nr_hits;
+	__u64 val, tmp;
+	int err;
+
+	nr_hits = nr_lookups * args.hit_pct / 100;
+	if (nr_hits > args.nr_entries)
+		nr_hits = args.nr_entries;
+
+	for (i = 0; i < nr_lookups; i++)
+		lookup_vals[i] = rand_u64();
+
+	/* The first nr_hits lookup values are the ones inserted */
+	for (i = 0; i < args.nr_entries; i++) {
+		val = i < nr_hits ? lookup_vals[i] : rand_u64();
+
+		err = bpf_map_update_elem(bloom_fd, NULL, &val, BPF_ANY);
+		if (err) {
+			fprintf(stderr, "failed to add value to the bloom filter: %d\n",
+				-errno);
+			exit(1);
+		}
+		err = bpf_map_update_elem(hashmap_fd, &val, &val, BPF_ANY);
+		if (err) {
+			fprintf(stderr, "failed to add value to the hashmap: %d\n",
+				-errno);
+			exit(1);
+		}
+	}
+
+	/* Interleave hits and misses */
+	for (i = nr_lookups - 1; i > 0; i--) {
+		j = rand() % (i + 1);
+		tmp = lookup_vals[i];
+		lookup_vals[i] = lookup_vals[j];
+		lookup_vals[j] = tmp;
+	}
+}
+
+static void setup_skeleton(void)
+{
+	int err;
+
+	setup_libbpf();
+
+	ctx.skel = bloom_filter_bench__open();
+	if (!ctx.skel) {
+		fprintf(stderr, "failed to open skeleton\n");
+		exit(1);
+	}
+
+	bpf_map__set_max_entries(ctx.skel->maps.bloom_map, args.nr_entries);
+	bpf_map__set_map_extra(ctx.skel->maps.bloom_map, args.nr_hash_funcs);
+	bpf_map__set_max_entries(ctx.skel->maps.hashmap, args.nr_entries);
+
+	err = bloom_filter_bench__load(ctx.skel);
+	if (err) {
+		fprintf(stderr, "failed to load skeleton\n");
+		exit(1);
+	}
+
+	populate_maps();
+}
+
+static void attach_bpf(struct bpf_program *prog)
+{
+	struct bpf_link *link;
+
+	link = bpf_program__attach(prog);
+	if (IS_ERR(link)) {
+		fprintf(stderr, "failed to attach program!\n");
+		exit(1);
+	}
+}
+
+static void bloom_lookup_setup(void)
+{
+	setup_skeleton();
+	attach_bpf(ctx.skel->progs.bloom_lookup);
+}
+
+static void hashmap_lookup_setup(void)
+{
+	setup_skeleton();
+	attach_bpf(ctx.skel->progs.hashmap_lookup);
+}
+
+static void hashmap_with_bloom_lookup_setup(void)
+{
+	setup_skeleton();
+	attach_bpf(ctx.skel->progs.hashmap_with_bloom_lookup);
+}
+
+static void measure(struct bench_res *res)
+{
+	res->hits = atomic_swap(&ctx.skel->bss->hits, 0);
+	/* Lookups which the bloom filter let through to the hashmap but
+	 * which then missed there.
+	 */
+	res->drops = atomic_swap(&ctx.skel->bss->false_hits, 0);
+}
+
+const struct bench bench_bloom_lookup = {
+	.name = "bloom-lookup",
+	.validate = validate,
+	.setup = bloom_lookup_setup,
+	.producer_thread = producer,
+	.consumer_thread = consumer,
+	.measure = measure,
+	.report_progress = hits_drops_report_progress,
+	.report_final = hits_drops_report_final,
+};
+
+const struct bench bench_hashmap_without_bloom = {
+	.name = "hashmap-without-bloom",
+	.validate = validate,
+	.setup = hashmap_lookup_setup,
+	.producer_thread = producer,
+	.consumer_thread = consumer,
+	.measure = measure,
+	.report_progress = hits_drops_report_progress,
+	.report_final = hits_drops_report_final,
+};
+
+const struct bench bench_hashmap_with_bloom = {
+	.name = "hashmap-with-bloom",
+	.validate = validate,
+	.setup = hashmap_with_bloom_lookup_setup,
+	.producer_thread = producer,
+	.consumer_thread = consumer,
+	.measure = measure,
+	.report_progress = hits_drops_report_progress,
+	.report_final = hits_drops_report_final,
+};
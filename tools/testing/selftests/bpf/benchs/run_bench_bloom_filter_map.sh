@@ -0,0 +1,12 @@
+#!/bin/bash
+
+set -eufo pipefail
+
+for hit_pct in 0 10 50
+do
+	for b in bloom-lookup hashmap-without-bloom hashmap-with-bloom
+	do
+		summary=$(sudo ./bench -w2 -d5 -a --hit_pct=$hit_pct $b | tail -n1 | cut -d'(' -f1 | cut -d' ' -f3-)
+		printf "hit_pct %-3s %-22s: %s\n" $hit_pct $b "$summary"
+	done
+done
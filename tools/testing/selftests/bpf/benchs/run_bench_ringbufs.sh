@@ -68,8 +68,9 @@ for b in rb-libbpf rb-custom pb-libbpf pb-custom; do
 	summarize $b "$($RUN_BENCH --rb-batch-cnt 1 --rb-sample-rate 1 --prod-affinity 0 --cons-affinity 0 $b)"
 done
 
-header "Ringbuf, multi-producer contention"
+header "Multi-producer contention, ringbuf vs perfbuf"
 for b in 1 2 3 4 8 12 16 20 24 28 32 36 40 44 48 52; do
 	summarize "rb-libbpf nr_prod $b" "$($RUN_BENCH -p$b --rb-batch-cnt 50 rb-libbpf)"
+	summarize "pb-libbpf nr_prod $b" "$($RUN_BENCH -p$b --rb-batch-cnt 50 pb-libbpf)"
 done
 
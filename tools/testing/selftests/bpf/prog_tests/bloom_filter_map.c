@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <sys/syscall.h>
+#include <test_progs.h>
+#include "bloom_filter_map.skel.h"
+
+static int duration;
+
+static int create_bloom(__u32 key_size, __u32 value_size, __u32 max_entries,
+			__u64 map_extra)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = BPF_MAP_TYPE_BLOOM_FILTER;
+	attr.key_size = key_size;
+	attr.value_size = value_size;
+	attr.max_entries = max_entries;
+	attr.map_extra = map_extra;
+
+	return syscall(__NR_bpf, BPF_MAP_CREATE, &attr, sizeof(attr));
+}
+
+static void test_fail_cases(void)
+{
+	__u32 value;
+	int fd, err;
+
+	fd = create_bloom(4, sizeof(value), 100, 0);
+	if (CHECK(fd >= 0, "non-zero key_size", "unexpected success\n"))
+		close(fd);
+
+	fd = create_bloom(0, 0, 100, 0);
+	if (CHECK(fd >= 0, "zero value_size", "unexpected success\n"))
+		close(fd);
+
+	fd = create_bloom(0, sizeof(value), 0, 0);
+	if (CHECK(fd >= 0, "zero max_entries", "unexpected success\n"))
+		close(fd);
+
+	fd = create_bloom(0, sizeof(value), 100, 0x10);
+	if (CHECK(fd >= 0, "invalid map_extra", "unexpected success\n"))
+		close(fd);
+
+	fd = create_bloom(0, sizeof(value), 100, 0);
+	if (CHECK(fd < 0, "create_bloom", "errno %d\n", errno))
+		return;
+
+	value = 0xcafe;
+	err = bpf_map_update_elem(fd, NULL, &value, BPF_EXIST);
+	ASSERT_ERR(err, "update with BPF_EXIST");
+
+	err = bpf_map_update_elem(fd, NULL, &value, BPF_ANY);
+	ASSERT_OK(err, "update");
+
+	err = bpf_map_lookup_elem(fd, NULL, &value);
+	ASSERT_OK(err, "lookup");
+
+	err = bpf_map_delete_elem(fd, &value);
+	ASSERT_ERR(err, "delete");
+
+	err = bpf_map_get_next_key(fd, NULL, &value);
+	ASSERT_ERR(err, "get_next_key");
+
+	close(fd);
+}
+
+static void test_map_info(struct bloom_filter_map *skel)
+{
+	struct bpf_map_info info = {};
+	__u32 len = sizeof(info);
+	int err;
+
+	err = bpf_obj_get_info_by_fd(bpf_map__fd(skel->maps.bloom_map), &info,
+				     &len);
+	if (!ASSERT_OK(err, "bpf_obj_get_info_by_fd"))
+		return;
+
+	ASSERT_EQ(info.type, BPF_MAP_TYPE_BLOOM_FILTER, "info.type");
+	ASSERT_EQ(info.key_size, 0, "info.key_size");
+	ASSERT_EQ(info.map_extra, 3, "info.map_extra");
+}
+
+static void test_lookup(struct bloom_filter_map *skel)
+{
+	int map_fd = bpf_map__fd(skel->maps.bloom_map);
+	__u32 i, val;
+	int err;
+
+	/* Values pushed from user space must be seen by the program, and
+	 * values pushed by the program must be seen from user space.
+	 */
+	for (i = 0; i < ARRAY_SIZE(skel->bss->check_vals); i++) {
+		val = rand();
+		err = bpf_map_update_elem(map_fd, NULL, &val, BPF_ANY);
+		if (!ASSERT_OK(err, "bpf_map_update_elem"))
+			return;
+		skel->bss->check_vals[i] = val;
+		skel->bss->push_vals[i] = rand();
+	}
+
+	skel->bss->my_pid = getpid();
+
+	syscall(SYS_getpgid);
+
+	ASSERT_EQ(skel->bss->error, 0, "error");
+
+	for (i = 0; i < ARRAY_SIZE(skel->bss->push_vals); i++) {
+		val = skel->bss->push_vals[i];
+		err = bpf_map_lookup_elem(map_fd, NULL, &val);
+		if (!ASSERT_OK(err, "bpf_map_lookup_elem"))
+			return;
+	}
+}
+
+void test_bloom_filter_map(void)
+{
+	struct bloom_filter_map *skel;
+	int err;
+
+	if (test__start_subtest("fail_cases"))
+		test_fail_cases();
+
+	skel = bloom_filter_map__open_and_load();
+	if (!ASSERT_OK_PTR(skel, "bloom_filter_map__open_and_load"))
+		return;
+
+	err = bloom_filter_map__attach(skel);
+	if (!ASSERT_OK(err, "bloom_filter_map__attach"))
+		goto out;
+
+	if (test__start_subtest("map_info"))
+		test_map_info(skel);
+	if (test__start_subtest("lookup"))
+		test_lookup(skel);
+
+out:
+	bloom_filter_map__destroy(skel);
+}
@@ -7,11 +7,13 @@
 #include "bpf_iter_task.skel.h"
 #include "bpf_iter_task_stack.skel.h"
 #include "bpf_iter_task_file.skel.h"
+#include "bpf_iter_task_vma.skel.h"
 #include "bpf_iter_task_btf.skel.h"
 #include "bpf_iter_tcp4.skel.h"
 #include "bpf_iter_tcp6.skel.h"
 #include "bpf_iter_udp4.skel.h"
 #include "bpf_iter_udp6.skel.h"
+#include "bpf_iter_sock_batch.skel.h"
 #include "bpf_iter_test_kern1.skel.h"
 #include "bpf_iter_test_kern2.skel.h"
 #include "bpf_iter_test_kern3.skel.h"
@@ -38,13 +40,14 @@ static void test_btf_id_or_null(void)
 	}
 }
 
-static void do_dummy_read(struct bpf_program *prog)
+static void do_dummy_read_opts(struct bpf_program *prog,
+			       struct bpf_iter_attach_opts *opts)
 {
 	struct bpf_link *link;
 	char buf[16] = {};
 	int iter_fd, len;
 
-	link = bpf_program__attach_iter(prog, NULL);
+	link = bpf_program__attach_iter(prog, opts);
 	if (CHECK(IS_ERR(link), "attach_iter", "attach_iter failed\n"))
 		return;
 
@@ -63,6 +66,11 @@ static void do_dummy_read(struct bpf_program *prog)
 	bpf_link__destroy(link);
 }
 
+static void do_dummy_read(struct bpf_program *prog)
+{
+	do_dummy_read_opts(prog, NULL);
+}
+
 static void test_ipv6_route(void)
 {
 	struct bpf_iter_ipv6_route *skel;
@@ -168,6 +176,92 @@ static void test_task_file(void)
 	bpf_iter_task_file__destroy(skel);
 }
 
+/* Static, so that reading the iterator does not change the vmas */
+#define VMABUFSZ		16384
+
+static char vma_iter_buf[VMABUFSZ];
+static char vma_maps_buf[VMABUFSZ];
+static char vma_expected[VMABUFSZ];
+
+/* Read one char at a time so that the mmap_lock is dropped and the walk
+ * resumed for every vma, then compare against /proc/self/maps.
+ */
+static void test_task_vma(void)
+{
+	DECLARE_LIBBPF_OPTS(bpf_iter_attach_opts, opts);
+	int iter_fd = -1, maps_fd = -1, len = 0, off = 0;
+	struct bpf_iter_task_vma *skel;
+	union bpf_iter_link_info linfo;
+	struct bpf_link *link = NULL;
+	char *line, *end;
+
+	skel = bpf_iter_task_vma__open_and_load();
+	if (CHECK(!skel, "bpf_iter_task_vma__open_and_load",
+		  "skeleton open_and_load failed\n"))
+		return;
+
+	skel->bss->pid = getpid();
+
+	/* start the walk at this task rather than at pid 1 */
+	memset(&linfo, 0, sizeof(linfo));
+	linfo.task_vma.tid = getpid();
+	opts.link_info = &linfo;
+	opts.link_info_len = sizeof(linfo);
+	link = bpf_program__attach_iter(skel->progs.dump_task_vma, &opts);
+	if (CHECK(IS_ERR(link), "attach_iter", "attach_iter failed\n")) {
+		link = NULL;
+		goto out;
+	}
+
+	iter_fd = bpf_iter_create(bpf_link__fd(link));
+	if (CHECK(iter_fd < 0, "create_iter", "create_iter failed\n"))
+		goto out;
+
+	while (off < VMABUFSZ - 1 &&
+	       (len = read(iter_fd, vma_iter_buf + off, 1)) > 0)
+		off += len;
+	if (CHECK(len < 0, "read", "read failed: %s\n", strerror(errno)))
+		goto out;
+	if (CHECK(!off, "read", "no vma of pid %d\n", getpid()))
+		goto out;
+
+	maps_fd = open("/proc/self/maps", O_RDONLY);
+	if (CHECK(maps_fd < 0, "open", "open maps failed: %s\n",
+		  strerror(errno)))
+		goto out;
+
+	off = 0;
+	while (off < VMABUFSZ - 1 &&
+	       (len = read(maps_fd, vma_maps_buf + off,
+			   VMABUFSZ - 1 - off)) > 0)
+		off += len;
+
+	/* keep the "start-end" of each line */
+	off = 0;
+	for (line = vma_maps_buf; *line && off < VMABUFSZ - 1;
+	     line = end + 1) {
+		end = strchr(line, ' ');
+		if (!end)
+			break;
+		off += snprintf(vma_expected + off, VMABUFSZ - off, "%.*s\n",
+				(int)(end - line), line);
+		end = strchr(end, '\n');
+		if (!end)
+			break;
+	}
+
+	/* /proc also shows the gate area, which is not a vma */
+	CHECK(strncmp(vma_expected, vma_iter_buf, strlen(vma_iter_buf)),
+	      "compare_maps", "iterator output differs from /proc/self/maps\n");
+out:
+	if (maps_fd >= 0)
+		close(maps_fd);
+	if (iter_fd >= 0)
+		close(iter_fd);
+	bpf_link__destroy(link);
+	bpf_iter_task_vma__destroy(skel);
+}
+
 #define TASKBUFSZ		32768
 
 static char taskbuf[TASKBUFSZ];
@@ -301,6 +395,213 @@ static void test_udp6(void)
 	bpf_iter_udp6__destroy(skel);
 }
 
+/* More than BPF_{TCP,UDP}_ITER_INIT_BATCH, all in the bucket of one port */
+#define SOCK_BATCH_NR		40
+#define SOCK_BATCH_BUFSZ	4096
+
+struct sock_batch_entry {
+	__u64 cookie;
+	int bucket;
+};
+
+static char sock_batch_buf[SOCK_BATCH_BUFSZ];
+
+/* Read the iterator one byte at a time, so that the walk is resumed by
+ * every read(), and collect the "cookie bucket" lines it prints.
+ */
+static int read_sock_batch(struct bpf_program *prog,
+			   union bpf_iter_link_info *linfo,
+			   struct sock_batch_entry *ents)
+{
+	DECLARE_LIBBPF_OPTS(bpf_iter_attach_opts, opts);
+	int iter_fd = -1, len = 0, off = 0, n = -1;
+	struct bpf_link *link;
+	char *line, *end;
+
+	if (linfo) {
+		opts.link_info = linfo;
+		opts.link_info_len = sizeof(*linfo);
+	}
+	link = bpf_program__attach_iter(prog, &opts);
+	if (CHECK(IS_ERR(link), "attach_iter", "attach_iter failed\n"))
+		return -1;
+
+	iter_fd = bpf_iter_create(bpf_link__fd(link));
+	if (CHECK(iter_fd < 0, "create_iter", "create_iter failed\n"))
+		goto out;
+
+	while (off < SOCK_BATCH_BUFSZ - 1 &&
+	       (len = read(iter_fd, sock_batch_buf + off, 1)) > 0)
+		off += len;
+	if (CHECK(len < 0, "read", "read failed: %s\n", strerror(errno)))
+		goto out;
+	sock_batch_buf[off] = 0;
+
+	n = 0;
+	for (line = sock_batch_buf; *line && n < SOCK_BATCH_NR;
+	     line = end + 1) {
+		ents[n].cookie = strtoull(line, &end, 10);
+		ents[n].bucket = strtol(end, &end, 10);
+		n++;
+		end = strchr(end, '\n');
+		if (!end)
+			break;
+	}
+out:
+	if (iter_fd >= 0)
+		close(iter_fd);
+	bpf_link__destroy(link);
+	return n;
+}
+
+static void test_sock_batch(bool tcp)
+{
+	struct sock_batch_entry ents[SOCK_BATCH_NR], seek[SOCK_BATCH_NR];
+	int fds[SOCK_BATCH_NR], i, j, n, k = SOCK_BATCH_NR / 2;
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	__u64 cookies[SOCK_BATCH_NR];
+	struct bpf_iter_sock_batch *skel;
+	union bpf_iter_link_info linfo;
+	socklen_t addrlen, optlen;
+	struct bpf_program *prog;
+	int one = 1, cnt;
+
+	for (i = 0; i < SOCK_BATCH_NR; i++)
+		fds[i] = -1;
+
+	skel = bpf_iter_sock_batch__open_and_load();
+	if (CHECK(!skel, "bpf_iter_sock_batch__open_and_load",
+		  "skeleton open_and_load failed\n"))
+		return;
+	prog = tcp ? skel->progs.dump_tcp_cookie : skel->progs.dump_udp_cookie;
+
+	/* bind the first socket to any port and the others to the same one */
+	for (i = 0; i < SOCK_BATCH_NR; i++) {
+		fds[i] = socket(AF_INET, tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+		if (CHECK(fds[i] < 0, "socket", "socket failed: %s\n",
+			  strerror(errno)))
+			goto out;
+		if (CHECK(setsockopt(fds[i], SOL_SOCKET, SO_REUSEPORT, &one,
+				     sizeof(one)), "setsockopt",
+			  "SO_REUSEPORT failed: %s\n", strerror(errno)))
+			goto out;
+		if (CHECK(bind(fds[i], (struct sockaddr *)&addr, sizeof(addr)),
+			  "bind", "bind failed: %s\n", strerror(errno)))
+			goto out;
+		if (tcp && CHECK(listen(fds[i], 1), "listen",
+				 "listen failed: %s\n", strerror(errno)))
+			goto out;
+		addrlen = sizeof(addr);
+		if (CHECK(getsockname(fds[i], (struct sockaddr *)&addr,
+				      &addrlen), "getsockname",
+			  "getsockname failed: %s\n", strerror(errno)))
+			goto out;
+		/* the cookie is only assigned once it is asked for */
+		optlen = sizeof(cookies[i]);
+		if (CHECK(getsockopt(fds[i], SOL_SOCKET, SO_COOKIE, &cookies[i],
+				     &optlen), "getsockopt",
+			  "SO_COOKIE failed: %s\n", strerror(errno)))
+			goto out;
+	}
+	skel->bss->local_port = ntohs(addr.sin_port);
+
+	/* a full walk sees every socket once, though they do not fit in the
+	 * initial batch and the walk is resumed by every read()
+	 */
+	n = read_sock_batch(prog, NULL, ents);
+	if (CHECK(n != SOCK_BATCH_NR, "full_walk",
+		  "got %d sockets, expected %d\n", n, SOCK_BATCH_NR))
+		goto out;
+	for (i = 0; i < SOCK_BATCH_NR; i++) {
+		for (cnt = 0, j = 0; j < n; j++)
+			cnt += ents[j].cookie == cookies[i];
+		if (CHECK(cnt != 1, "full_walk", "socket %d seen %d times\n",
+			  i, cnt))
+			goto out;
+		if (CHECK(ents[i].bucket != ents[0].bucket, "full_walk",
+			  "bucket %d != %d\n", ents[i].bucket, ents[0].bucket))
+			goto out;
+	}
+
+	/* seeking to a socket resumes right after it */
+	memset(&linfo, 0, sizeof(linfo));
+	linfo.sock.cookie = ents[k].cookie;
+	linfo.sock.bucket = ents[k].bucket;
+	n = read_sock_batch(prog, &linfo, seek);
+	if (CHECK(n != SOCK_BATCH_NR - k - 1, "seek",
+		  "got %d sockets, expected %d\n", n, SOCK_BATCH_NR - k - 1))
+		goto out;
+	CHECK(memcmp(seek, ents + k + 1, n * sizeof(*seek)), "seek",
+	      "walk does not resume after the socket seeked to\n");
+
+	/* seeking to a socket that is gone restarts its bucket */
+	for (i = 0; i < SOCK_BATCH_NR; i++) {
+		if (cookies[i] == ents[k].cookie) {
+			close(fds[i]);
+			fds[i] = -1;
+		}
+	}
+	n = read_sock_batch(prog, &linfo, seek);
+	if (CHECK(n != SOCK_BATCH_NR - 1, "seek_gone",
+		  "got %d sockets, expected %d\n", n, SOCK_BATCH_NR - 1))
+		goto out;
+	CHECK(memcmp(seek, ents, k * sizeof(*seek)) ||
+	      memcmp(seek + k, ents + k + 1, (n - k) * sizeof(*seek)),
+	      "seek_gone", "walk does not restart the bucket\n");
+out:
+	for (i = 0; i < SOCK_BATCH_NR; i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+	bpf_iter_sock_batch__destroy(skel);
+}
+
+/* A resume point in the link info must not be mistaken for a map */
+static void test_seek_args(void)
+{
+	DECLARE_LIBBPF_OPTS(bpf_iter_attach_opts, opts);
+	struct bpf_iter_task_vma *vma_skel = NULL;
+	struct bpf_iter_tcp4 *tcp_skel = NULL;
+	struct bpf_iter_udp4 *udp_skel = NULL;
+	union bpf_iter_link_info linfo;
+
+	opts.link_info = &linfo;
+	opts.link_info_len = sizeof(linfo);
+
+	tcp_skel = bpf_iter_tcp4__open_and_load();
+	if (CHECK(!tcp_skel, "bpf_iter_tcp4__open_and_load",
+		  "skeleton open_and_load failed\n"))
+		goto out;
+
+	memset(&linfo, 0, sizeof(linfo));
+	linfo.sock.cookie = ~0ULL;
+	linfo.sock.bucket = 1;
+	do_dummy_read_opts(tcp_skel->progs.dump_tcp4, &opts);
+
+	udp_skel = bpf_iter_udp4__open_and_load();
+	if (CHECK(!udp_skel, "bpf_iter_udp4__open_and_load",
+		  "skeleton open_and_load failed\n"))
+		goto out;
+
+	do_dummy_read_opts(udp_skel->progs.dump_udp4, &opts);
+
+	vma_skel = bpf_iter_task_vma__open_and_load();
+	if (CHECK(!vma_skel, "bpf_iter_task_vma__open_and_load",
+		  "skeleton open_and_load failed\n"))
+		goto out;
+
+	memset(&linfo, 0, sizeof(linfo));
+	linfo.task_vma.tid = getpid();
+	linfo.task_vma.addr = (__u64)(unsigned long)&linfo;
+	do_dummy_read_opts(vma_skel->progs.dump_task_vma, &opts);
+out:
+	bpf_iter_task_vma__destroy(vma_skel);
+	bpf_iter_udp4__destroy(udp_skel);
+	bpf_iter_tcp4__destroy(tcp_skel);
+}
+
 /* The expected string is less than 16 bytes */
 static int do_read_with_fd(int iter_fd, const char *expected,
 			   bool read_one_char)
@@ -1035,6 +1336,8 @@ void test_bpf_iter(void)
 		test_task_stack();
 	if (test__start_subtest("task_file"))
 		test_task_file();
+	if (test__start_subtest("task_vma"))
+		test_task_vma();
 	if (test__start_subtest("task_btf"))
 		test_task_btf();
 	if (test__start_subtest("tcp4"))
@@ -1045,6 +1348,12 @@ void test_bpf_iter(void)
 		test_udp4();
 	if (test__start_subtest("udp6"))
 		test_udp6();
+	if (test__start_subtest("tcp_batch"))
+		test_sock_batch(true);
+	if (test__start_subtest("udp_batch"))
+		test_sock_batch(false);
+	if (test__start_subtest("seek_args"))
+		test_seek_args();
 	if (test__start_subtest("anon"))
 		test_anon_iter(false);
 	if (test__start_subtest("anon-read-one-char"))
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <test_progs.h>
+#include <network_helpers.h>
+#include "bpf_loop.skel.h"
+
+static void run_loop(struct bpf_loop *skel, __u32 nr_loops, __u32 stop_index,
+		     __u64 flags, long exp_iterations, __u64 exp_sum)
+{
+	__u32 duration = 0, retval;
+	int err, prog_fd;
+
+	skel->bss->nr_loops = nr_loops;
+	skel->data->stop_index = stop_index;
+	skel->bss->flags = flags;
+
+	prog_fd = bpf_program__fd(skel->progs.test_prog);
+	err = bpf_prog_test_run(prog_fd, 1, &pkt_v4, sizeof(pkt_v4),
+				NULL, NULL, &retval, &duration);
+	if (CHECK(err, "test_run", "err %d errno %d\n", err, errno))
+		return;
+
+	CHECK(skel->bss->nr_iterations != exp_iterations, "nr_iterations",
+	      "nr_loops %u: got %ld exp %ld\n", nr_loops,
+	      skel->bss->nr_iterations, exp_iterations);
+	CHECK(skel->bss->sum != exp_sum, "sum",
+	      "nr_loops %u: got %llu exp %llu\n", nr_loops,
+	      skel->bss->sum, exp_sum);
+}
+
+void test_bpf_loop(void)
+{
+	struct bpf_loop *skel;
+	__u32 duration = 0;
+
+	skel = bpf_loop__open_and_load();
+	if (CHECK(!skel, "skel_open_and_load", "failed to load skeleton\n"))
+		return;
+
+	if (test__start_subtest("sum"))
+		run_loop(skel, 1000, -1, 0, 1000, 999 * 1000 / 2);
+
+	if (test__start_subtest("zero"))
+		run_loop(skel, 0, -1, 0, 0, 0);
+
+	if (test__start_subtest("early_stop"))
+		run_loop(skel, 1000, 10, 0, 11, 9 * 10 / 2);
+
+	if (test__start_subtest("max_loops"))
+		run_loop(skel, (1 << 23) + 1, -1, 0, -E2BIG, 0);
+
+	if (test__start_subtest("bad_flags"))
+		run_loop(skel, 10, -1, 1, -EINVAL, 0);
+
+	bpf_loop__destroy(skel);
+}
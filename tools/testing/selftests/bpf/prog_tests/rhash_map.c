@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <test_progs.h>
+#include <network_helpers.h>
+#include "test_rhash_map.skel.h"
+
+#define NR_ELEMS 10000
+
+static void test_rhash_syscall(int map_fd)
+{
+	__u32 key, next_key, seen = 0;
+	__u64 value;
+	int duration = 0, err;
+
+	/* enough elements for the table to be grown several times */
+	for (key = 0; key < NR_ELEMS; key++) {
+		value = (__u64)key << 32 | key;
+		err = bpf_map_update_elem(map_fd, &key, &value, BPF_NOEXIST);
+		if (CHECK(err, "update", "key %u err %d\n", key, errno))
+			return;
+	}
+
+	for (key = 0; key < NR_ELEMS; key++) {
+		err = bpf_map_lookup_elem(map_fd, &key, &value);
+		if (CHECK(err || value != ((__u64)key << 32 | key), "lookup",
+			  "key %u err %d value %llx\n", key, errno, value))
+			return;
+	}
+
+	err = bpf_map_get_next_key(map_fd, NULL, &key);
+	while (!err) {
+		seen++;
+		err = bpf_map_get_next_key(map_fd, &key, &next_key);
+		key = next_key;
+	}
+	CHECK(seen != NR_ELEMS, "get_next_key", "seen %u elems\n", seen);
+
+	/* and shrunk again */
+	for (key = 0; key < NR_ELEMS; key++) {
+		err = bpf_map_delete_elem(map_fd, &key);
+		if (CHECK(err, "delete", "key %u err %d\n", key, errno))
+			return;
+	}
+
+	err = bpf_map_get_next_key(map_fd, NULL, &key);
+	CHECK(!err || errno != ENOENT, "empty", "err %d errno %d\n", err,
+	      errno);
+}
+
+static void test_rhash_full(void)
+{
+	__u32 key;
+	__u64 value = 0;
+	int duration = 0, fd, err;
+
+	fd = bpf_create_map(BPF_MAP_TYPE_RHASH, sizeof(key), sizeof(value),
+			    2, 0);
+	if (CHECK(fd < 0, "create_map", "err %d\n", errno))
+		return;
+
+	for (key = 0; key < 2; key++) {
+		err = bpf_map_update_elem(fd, &key, &value, BPF_ANY);
+		CHECK(err, "update", "key %u err %d\n", key, errno);
+	}
+
+	err = bpf_map_update_elem(fd, &key, &value, BPF_ANY);
+	CHECK(!err || errno != E2BIG, "update full", "err %d errno %d\n",
+	      err, errno);
+
+	/* replacing an element of a full map must work */
+	key = 0;
+	err = bpf_map_update_elem(fd, &key, &value, BPF_ANY);
+	CHECK(err, "replace full", "err %d\n", errno);
+
+	close(fd);
+}
+
+void test_rhash_map(void)
+{
+	struct test_rhash_map *skel;
+	__u32 duration = 0, retval;
+	int err, prog_fd;
+
+	skel = test_rhash_map__open();
+	if (CHECK(!skel, "skel_open", "failed to open skeleton\n"))
+		return;
+
+	/* trace type programs must not be able to use the map */
+	err = test_rhash_map__load(skel);
+	if (CHECK(!err, "skel_load", "unexpected success\n"))
+		goto cleanup;
+	test_rhash_map__destroy(skel);
+
+	skel = test_rhash_map__open();
+	if (CHECK(!skel, "skel_open", "failed to open skeleton\n"))
+		return;
+
+	bpf_program__set_autoload(skel->progs.test_rhash_tp, false);
+
+	err = test_rhash_map__load(skel);
+	if (CHECK(err, "skel_load", "failed to load skeleton: %d\n", err))
+		goto cleanup;
+
+	if (test__start_subtest("prog")) {
+		skel->bss->key = 42;
+		skel->bss->value = 0xdeadbeef;
+		prog_fd = bpf_program__fd(skel->progs.test_rhash);
+		err = bpf_prog_test_run(prog_fd, 1, &pkt_v4, sizeof(pkt_v4),
+					NULL, NULL, &retval, &duration);
+		CHECK(err || skel->bss->err, "test_run",
+		      "err %d errno %d prog err %d\n", err, errno,
+		      skel->bss->err);
+	}
+
+	if (test__start_subtest("syscall"))
+		test_rhash_syscall(bpf_map__fd(skel->maps.rhash));
+
+	if (test__start_subtest("full"))
+		test_rhash_full();
+
+cleanup:
+	test_rhash_map__destroy(skel);
+}
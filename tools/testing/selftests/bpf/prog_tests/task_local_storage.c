@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <sys/syscall.h>
+#include <test_progs.h>
+#include "task_local_storage.skel.h"
+
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+static inline int sys_pidfd_open(pid_t pid, unsigned int flags)
+{
+	return syscall(__NR_pidfd_open, pid, flags);
+}
+
+void test_task_local_storage(void)
+{
+	struct task_local_storage *skel;
+	int duration = 0, err, i, pidfd, map_fd;
+	long value;
+
+	skel = task_local_storage__open_and_load();
+	if (CHECK(!skel, "skel_open_and_load", "skeleton open and load failed\n"))
+		return;
+
+	skel->bss->target_pid = syscall(SYS_gettid);
+
+	err = task_local_storage__attach(skel);
+	if (CHECK(err, "skel_attach", "skeleton attach failed: %d\n", err))
+		goto out;
+
+	for (i = 0; i < 10; i++)
+		syscall(SYS_gettid);
+
+	task_local_storage__detach(skel);
+
+	/* at least the gettid calls, more from attach and detach */
+	CHECK(skel->bss->enter_cnt < 10, "enter_cnt", "got %d\n",
+	      skel->bss->enter_cnt);
+	CHECK(skel->bss->exit_cnt < 10, "exit_cnt", "got %d\n",
+	      skel->bss->exit_cnt);
+	CHECK(skel->bss->mismatch_cnt, "mismatch_cnt", "got %d\n",
+	      skel->bss->mismatch_cnt);
+
+	/* The storage is reachable from user space with a pidfd as key */
+	pidfd = sys_pidfd_open(getpid(), 0);
+	if (pidfd < 0) {
+		printf("%s:SKIP:pidfd_open not supported\n", __func__);
+		goto out;
+	}
+
+	map_fd = bpf_map__fd(skel->maps.enter_id);
+	err = bpf_map_lookup_elem(map_fd, &pidfd, &value);
+	CHECK(err, "lookup", "err %d errno %d\n", err, errno);
+
+	err = bpf_map_delete_elem(map_fd, &pidfd);
+	CHECK(err, "delete", "err %d errno %d\n", err, errno);
+
+	err = bpf_map_lookup_elem(map_fd, &pidfd, &value);
+	CHECK(!err || errno != ENOENT, "lookup_deleted", "err %d errno %d\n",
+	      err, errno);
+
+	close(pidfd);
+out:
+	task_local_storage__destroy(skel);
+}
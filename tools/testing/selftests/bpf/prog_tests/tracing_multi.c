@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <test_progs.h>
+#include "tracing_multi.skel.h"
+
+static int link_multi(int prog_fd, __u32 *btf_ids, __u32 cnt)
+{
+	DECLARE_LIBBPF_OPTS(bpf_link_create_opts, opts,
+		.btf_ids = btf_ids,
+		.btf_ids_cnt = cnt,
+	);
+
+	return bpf_link_create(prog_fd, 0, BPF_TRACE_FENTRY, &opts);
+}
+
+void test_tracing_multi(void)
+{
+	const char *funcs[] = {
+		"bpf_fentry_test7", "bpf_fentry_test8", "bpf_fentry_test1",
+	};
+	struct tracing_multi *skel;
+	int err, i, prog_fd, link_fd;
+	__u32 btf_ids[3], dup_ids[2];
+	__u32 duration = 0, retval;
+
+	skel = tracing_multi__open_and_load();
+	if (CHECK(!skel, "skel_open_and_load", "skeleton failed\n"))
+		return;
+	prog_fd = bpf_program__fd(skel->progs.test_multi);
+
+	for (i = 0; i < ARRAY_SIZE(funcs); i++) {
+		err = libbpf_find_vmlinux_btf_id(funcs[i], BPF_TRACE_FENTRY);
+		if (CHECK(err <= 0, "find_vmlinux_btf_id", "%s: %d\n",
+			  funcs[i], err))
+			goto cleanup;
+		btf_ids[i] = err;
+	}
+
+	/* bpf_fentry_test1() has a different prototype */
+	link_fd = link_multi(prog_fd, btf_ids, 3);
+	if (CHECK(link_fd >= 0 || errno != EINVAL, "link_proto_mismatch",
+		  "link_fd %d errno %d\n", link_fd, errno))
+		goto cleanup_link;
+
+	dup_ids[0] = dup_ids[1] = btf_ids[0];
+	link_fd = link_multi(prog_fd, dup_ids, 2);
+	if (CHECK(link_fd >= 0 || errno != EINVAL, "link_dup",
+		  "link_fd %d errno %d\n", link_fd, errno))
+		goto cleanup_link;
+
+	link_fd = link_multi(prog_fd, btf_ids, 2);
+	if (CHECK(link_fd < 0, "link_multi", "link_fd %d errno %d\n",
+		  link_fd, errno))
+		goto cleanup;
+
+	/* runs all of bpf_fentry_test1() to bpf_fentry_test8() */
+	err = bpf_prog_test_run(prog_fd, 1, NULL, 0, NULL, NULL, &retval,
+				&duration);
+	CHECK(err || retval, "test_run", "err %d errno %d retval %d\n",
+	      err, errno, retval);
+	CHECK(skel->bss->hits != 2, "hits", "got %llu, expected 2\n",
+	      skel->bss->hits);
+
+	close(link_fd);
+	link_fd = -1;
+
+	err = bpf_prog_test_run(prog_fd, 1, NULL, 0, NULL, NULL, &retval,
+				&duration);
+	CHECK(err || retval, "test_run_detached", "err %d errno %d\n",
+	      err, errno);
+	CHECK(skel->bss->hits != 2, "hits_detached", "got %llu, expected 2\n",
+	      skel->bss->hits);
+
+cleanup_link:
+	if (link_fd >= 0)
+		close(link_fd);
+cleanup:
+	tracing_multi__destroy(skel);
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <test_progs.h>
+
+static int fdinfo_u32(int fd, const char *key, __u32 *val)
+{
+	size_t key_len = strlen(key);
+	char buff[256];
+	int ret = -ENOENT;
+	FILE *fp;
+
+	snprintf(buff, sizeof(buff), "/proc/self/fdinfo/%d", fd);
+	fp = fopen(buff, "r");
+	if (!fp)
+		return -errno;
+
+	while (fgets(buff, sizeof(buff), fp)) {
+		if (strncmp(buff, key, key_len) || buff[key_len] != ':')
+			continue;
+		ret = sscanf(buff + key_len + 1, "%u", val) == 1 ? 0 : -EINVAL;
+		break;
+	}
+
+	fclose(fp);
+	return ret;
+}
+
+void test_verif_stats(void)
+{
+	struct bpf_prog_info info = {};
+	__u32 len = sizeof(info);
+	__u32 states, peak_states;
+	struct bpf_object *obj;
+	int err, prog_fd;
+	__u32 duration = 0;
+
+	err = bpf_prog_load("./test_pkt_access.o", BPF_PROG_TYPE_SCHED_CLS,
+			    &obj, &prog_fd);
+	if (CHECK(err, "prog_load", "err %d errno %d\n", err, errno))
+		return;
+
+	err = bpf_obj_get_info_by_fd(prog_fd, &info, &len);
+	if (CHECK(err, "get_prog_info", "err %d errno %d\n", err, errno))
+		goto close_prog;
+
+	CHECK(!info.verified_insns, "verified_insns", "got 0\n");
+
+	/* The state counts are only reported in fdinfo. */
+	err = fdinfo_u32(prog_fd, "verified_states", &states);
+	if (CHECK(err, "fdinfo_states", "err %d\n", err))
+		goto close_prog;
+	err = fdinfo_u32(prog_fd, "verified_peak_states", &peak_states);
+	if (CHECK(err, "fdinfo_peak_states", "err %d\n", err))
+		goto close_prog;
+
+	CHECK(!states, "verified_states", "got 0\n");
+	CHECK(peak_states > states, "verified_peak_states",
+	      "peak %u > total %u\n", peak_states, states);
+
+close_prog:
+	bpf_object__close(obj);
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+
+char _license[] SEC("license") = "GPL";
+
+#define NR_LOOKUPS 512
+
+/* The value size is fixed by the benchmark, everything else is set up
+ * from user space before load.
+ */
+struct {
+	__uint(type, BPF_MAP_TYPE_BLOOM_FILTER);
+	__uint(value_size, sizeof(__u64));
+} bloom_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__type(key, __u64);
+	__type(value, __u64);
+} hashmap SEC(".maps");
+
+/* Values looked up on each run, filled in from user space */
+__u64 lookup_vals[NR_LOOKUPS];
+
+long hits = 0;
+long false_hits = 0;
+
+SEC("tp/syscalls/sys_enter_getpgid")
+int bloom_lookup(void *ctx)
+{
+	__u64 val;
+	__u32 i;
+
+	for (i = 0; i < NR_LOOKUPS; i++) {
+		val = lookup_vals[i];
+		bpf_map_peek_elem(&bloom_map, &val);
+	}
+
+	__sync_add_and_fetch(&hits, NR_LOOKUPS);
+	return 0;
+}
+
+SEC("tp/syscalls/sys_enter_getpgid")
+int hashmap_lookup(void *ctx)
+{
+	__u64 val;
+	__u32 i;
+
+	for (i = 0; i < NR_LOOKUPS; i++) {
+		val = lookup_vals[i];
+		bpf_map_lookup_elem(&hashmap, &val);
+	}
+
+	__sync_add_and_fetch(&hits, NR_LOOKUPS);
+	return 0;
+}
+
+SEC("tp/syscalls/sys_enter_getpgid")
+int hashmap_with_bloom_lookup(void *ctx)
+{
+	long nr_false = 0;
+	__u64 val;
+	__u32 i;
+
+	for (i = 0; i < NR_LOOKUPS; i++) {
+		val = lookup_vals[i];
+		if (bpf_map_peek_elem(&bloom_map, &val))
+			continue;
+		if (!bpf_map_lookup_elem(&hashmap, &val))
+			nr_false++;
+	}
+
+	__sync_add_and_fetch(&hits, NR_LOOKUPS);
+	if (nr_false)
+		__sync_add_and_fetch(&false_hits, nr_false);
+	return 0;
+}
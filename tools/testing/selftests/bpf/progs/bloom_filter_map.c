@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+
+#define NR_VALUES 256
+
+struct {
+	__uint(type, BPF_MAP_TYPE_BLOOM_FILTER);
+	__uint(max_entries, 1000);
+	__uint(value_size, sizeof(__u32));
+	__uint(map_extra, 3);
+} bloom_map SEC(".maps");
+
+__u32 check_vals[NR_VALUES];
+__u32 push_vals[NR_VALUES];
+int my_pid = 0;
+int error = 0;
+
+SEC("tp/syscalls/sys_enter_getpgid")
+int push_bloom(void *ctx)
+{
+	__u32 i, val;
+
+	if (my_pid != (bpf_get_current_pid_tgid() >> 32))
+		return 0;
+
+	for (i = 0; i < NR_VALUES; i++) {
+		val = push_vals[i];
+		if (bpf_map_push_elem(&bloom_map, &val, BPF_ANY))
+			error |= 1;
+	}
+
+	return 0;
+}
+
+SEC("tp/syscalls/sys_exit_getpgid")
+int check_bloom(void *ctx)
+{
+	__u32 i, val;
+
+	if (my_pid != (bpf_get_current_pid_tgid() >> 32))
+		return 0;
+
+	for (i = 0; i < NR_VALUES; i++) {
+		val = check_vals[i];
+		if (bpf_map_peek_elem(&bloom_map, &val))
+			error |= 2;
+	}
+
+	return 0;
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "bpf_iter.h"
+#include <bpf/bpf_helpers.h>
+
+char _license[] SEC("license") = "GPL";
+
+/* Only sockets bound to this port (host order) are printed */
+__u16 local_port = 0;
+
+SEC("iter/tcp")
+int dump_tcp_cookie(struct bpf_iter__tcp *ctx)
+{
+	struct sock_common *skc = ctx->sk_common;
+	struct seq_file *seq = ctx->meta->seq;
+	__u64 cookie;
+
+	if (skc == (void *)0 || skc->skc_num != local_port)
+		return 0;
+
+	cookie = skc->skc_cookie.counter;
+	BPF_SEQ_PRINTF(seq, "%llu %d\n", cookie, ctx->bucket);
+	return 0;
+}
+
+SEC("iter/udp")
+int dump_udp_cookie(struct bpf_iter__udp *ctx)
+{
+	struct seq_file *seq = ctx->meta->seq;
+	struct udp_sock *udp_sk = ctx->udp_sk;
+	__u64 cookie;
+
+	if (udp_sk == (void *)0 ||
+	    udp_sk->inet.sk.__sk_common.skc_num != local_port)
+		return 0;
+
+	cookie = udp_sk->inet.sk.__sk_common.skc_cookie.counter;
+	BPF_SEQ_PRINTF(seq, "%llu %d\n", cookie, ctx->bucket);
+	return 0;
+}
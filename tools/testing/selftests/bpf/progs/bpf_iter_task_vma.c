@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "bpf_iter.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+char _license[] SEC("license") = "GPL";
+
+pid_t pid = 0;
+
+SEC("iter/task_vma")
+int dump_task_vma(struct bpf_iter__task_vma *ctx)
+{
+	struct vm_area_struct *vma = ctx->vma;
+	struct seq_file *seq = ctx->meta->seq;
+	struct task_struct *task = ctx->task;
+
+	if (task == (void *)0 || vma == (void *)0)
+		return 0;
+
+	if (task->tgid != pid)
+		return 0;
+
+	BPF_SEQ_PRINTF(seq, "%08lx-%08lx\n", vma->vm_start, vma->vm_end);
+	return 0;
+}
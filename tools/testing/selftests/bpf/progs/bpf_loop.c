@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <errno.h>
+#include <linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+
+char _license[] SEC("license") = "GPL";
+
+struct callback_ctx {
+	__u32 stop_index;
+	__u64 sum;
+};
+
+__u32 nr_loops = 0;
+__u32 stop_index = -1;
+__u64 flags = 0;
+
+long nr_iterations = 0;
+__u64 sum = 0;
+
+static int sum_callback(__u32 index, void *data)
+{
+	struct callback_ctx *ctx = data;
+
+	if (index >= ctx->stop_index)
+		return 1;
+
+	ctx->sum += index;
+	return 0;
+}
+
+SEC("classifier")
+int test_prog(struct __sk_buff *skb)
+{
+	struct callback_ctx data = {
+		.stop_index = stop_index,
+	};
+
+	nr_iterations = bpf_loop(nr_loops, sum_callback, &data, flags);
+	sum = data.sum;
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <errno.h>
+#include <linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+
+char _license[] SEC("license") = "GPL";
+
+struct {
+	__uint(type, BPF_MAP_TYPE_RHASH);
+	__uint(max_entries, 65536);
+	__type(key, __u32);
+	__type(value, __u64);
+} rhash SEC(".maps");
+
+__u32 key = 0;
+__u64 value = 0;
+int err = 0;
+
+SEC("classifier")
+int test_rhash(struct __sk_buff *skb)
+{
+	__u64 val, *pval;
+
+	val = value;
+	if (bpf_map_update_elem(&rhash, &key, &val, BPF_NOEXIST)) {
+		err = 1;
+		return 0;
+	}
+
+	pval = bpf_map_lookup_elem(&rhash, &key);
+	if (!pval || *pval != value) {
+		err = 2;
+		return 0;
+	}
+
+	if (bpf_map_update_elem(&rhash, &key, &val, BPF_NOEXIST) != -EEXIST) {
+		err = 3;
+		return 0;
+	}
+
+	val = value + 1;
+	if (bpf_map_update_elem(&rhash, &key, &val, BPF_EXIST)) {
+		err = 4;
+		return 0;
+	}
+
+	pval = bpf_map_lookup_elem(&rhash, &key);
+	if (!pval || *pval != value + 1) {
+		err = 5;
+		return 0;
+	}
+
+	if (bpf_map_delete_elem(&rhash, &key)) {
+		err = 6;
+		return 0;
+	}
+
+	if (bpf_map_delete_elem(&rhash, &key) != -ENOENT) {
+		err = 7;
+		return 0;
+	}
+
+	if (bpf_map_update_elem(&rhash, &key, &val, BPF_EXIST) != -ENOENT)
+		err = 8;
+
+	return 0;
+}
+
+/* Must be rejected by the verifier */
+SEC("tp/syscalls/sys_enter_getpgid")
+int test_rhash_tp(void *ctx)
+{
+	__u64 *pval;
+
+	pval = bpf_map_lookup_elem(&rhash, &key);
+	if (pval)
+		err = 9;
+
+	return 0;
+}
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+char _license[] SEC("license") = "GPL";
+
+struct bpf_fentry_test_t {
+	struct bpf_fentry_test_t *a;
+};
+
+/* bpf_fentry_test7() and bpf_fentry_test8() share this prototype */
+__u64 hits = 0;
+SEC("fentry/bpf_fentry_test7")
+int BPF_PROG(test_multi, struct bpf_fentry_test_t *arg)
+{
+	__sync_fetch_and_add(&hits, 1);
+	return 0;
+}
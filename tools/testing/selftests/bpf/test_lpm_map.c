@@ -325,6 +325,94 @@ static void test_lpm_map(int keysize)
 	 */
 }
 
+static void lpm_stride_check(int map, struct tlpm_node *list, size_t n_lookups)
+{
+	struct bpf_lpm_trie_key *key;
+	uint8_t data[4], value[5];
+	struct tlpm_node *t;
+	size_t i, j;
+	int r;
+
+	key = alloca(sizeof(*key) + 4);
+
+	for (i = 0; i < n_lookups; ++i) {
+		for (j = 0; j < 4; ++j)
+			data[j] = rand() & 0xff;
+
+		t = tlpm_match(list, data, 32);
+
+		key->prefixlen = 32;
+		memcpy(key->data, data, 4);
+		r = bpf_map_lookup_elem(map, key, value);
+		assert(!r || errno == ENOENT);
+		assert(!t == !!r);
+
+		if (t) {
+			assert(t->n_bits == value[4]);
+			for (j = 0; j < t->n_bits; ++j)
+				assert((t->key[j / 8] & (1 << (7 - j % 8))) ==
+				       (value[j / 8] & (1 << (7 - j % 8))));
+		}
+	}
+}
+
+/* Test maps large enough for lookups to go through the stride table */
+static void test_lpm_stride(void)
+{
+	size_t i, j, n_nodes = 20000, n_lookups = 1 << 10;
+	struct tlpm_node *t, *list = NULL;
+	struct bpf_lpm_trie_key *key;
+	uint8_t value[5];
+	int r, map;
+
+	key = alloca(sizeof(*key) + 4);
+
+	map = bpf_create_map(BPF_MAP_TYPE_LPM_TRIE, sizeof(*key) + 4,
+			     sizeof(value), 32768, BPF_F_NO_PREALLOC);
+	assert(map >= 0);
+
+	/* Mostly longer prefixes, so nearly all of them are distinct and
+	 * the trie gets over the size for the stride table.
+	 */
+	for (i = 0; i < n_nodes; ++i) {
+		value[4] = rand() % 8 ? 12 + rand() % 21 : rand() % 33;
+		for (j = 0; j < 4; ++j)
+			value[j] = rand() & 0xff;
+		for (j = value[4]; j < 32; ++j)
+			value[j / 8] &= ~(1 << (7 - j % 8));
+
+		list = tlpm_add(list, value, value[4]);
+
+		key->prefixlen = value[4];
+		memcpy(key->data, value, 4);
+		r = bpf_map_update_elem(map, key, value, 0);
+		assert(!r);
+	}
+
+	/* Right after an update, and after the table had time to be built */
+	lpm_stride_check(map, list, n_lookups);
+	usleep(500000);
+	lpm_stride_check(map, list, n_lookups);
+
+	for (i = 0, t = list; t; i++, t = t->next)
+		;
+	for (j = 0; j < i / 16; ++j) {
+		key->prefixlen = list->n_bits;
+		memcpy(key->data, list->key, 4);
+		r = bpf_map_delete_elem(map, key);
+		assert(!r);
+		list = tlpm_delete(list, list->key, list->n_bits);
+		assert(list);
+	}
+
+	lpm_stride_check(map, list, n_lookups);
+	usleep(500000);
+	lpm_stride_check(map, list, n_lookups);
+
+	close(map);
+	tlpm_clear(list);
+}
+
 /* Test the implementation with some 'real world' examples */
 
 static void test_lpm_ipaddr(void)
@@ -795,6 +883,7 @@ int main(void)
 		test_lpm_map(i);
 
 	test_lpm_ipaddr();
+	test_lpm_stride();
 	test_lpm_delete();
 	test_lpm_get_next_key();
 	test_lpm_multi_thread();
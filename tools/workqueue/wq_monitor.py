@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0
+
+desc = """
+Monitor workqueue activity using the statistics the kernel exports in
+debugfs (workqueue/stats and, with CONFIG_WQ_LATENCY_STATS, also
+workqueue/latency).  All columns are deltas over the interval.
+
+  total      work items started execution
+  infl       started - completed, i.e. in flight at the end of the interval
+  CPUtime    CPU time consumed by the work items in msecs
+  CPUitsv    work items which hogged the CPU for longer than
+             workqueue.cpu_intensive_thresh_us and were automatically
+             taken out of concurrency management
+  CMwake     concurrency-management worker wakeups
+  mayday     maydays sent to the rescuer
+  rescued    work items executed by the rescuer
+
+A workqueue with a steadily increasing CPUitsv count runs work items
+which stall the other per-cpu work items of its pool.  Those should be
+moved to an unbound or WQ_CPU_INTENSIVE workqueue.
+
+With --latency, the queueing (queued -> started) and execution
+(started -> completed) time distributions of each workqueue are printed
+as p50/p99/max bucket upper bounds.
+"""
+
+import argparse
+import re
+import sys
+import time
+
+DEBUGFS = '/sys/kernel/debug/workqueue'
+
+
+def read_stats(path):
+    stats = {}
+    with open(path) as f:
+        for line in f:
+            if line.startswith('#'):
+                continue
+            # names may contain spaces, counters never do
+            fields = line.split()
+            nr = len(fields) - 7
+            stats[' '.join(fields[:nr])] = [int(v) for v in fields[nr:]]
+    return stats
+
+
+def read_latency(path):
+    hists = {}
+    with open(path) as f:
+        for line in f:
+            if line.startswith('#'):
+                continue
+            fields = line.split()
+            nr = len(fields) - 24 - 1
+            name = ' '.join(fields[:nr])
+            hists[(name, fields[nr])] = [int(v) for v in fields[nr + 1:]]
+    return hists
+
+
+def bucket_usecs(bucket, nr_buckets):
+    if bucket == nr_buckets - 1:
+        return '>{}'.format(fmt_usecs(1 << (bucket - 1)))
+    return '<{}'.format(fmt_usecs(1 << bucket))
+
+
+def fmt_usecs(us):
+    if us >= 1000000:
+        return '{}s'.format(us // 1000000)
+    if us >= 1000:
+        return '{}ms'.format(us // 1000)
+    return '{}us'.format(us)
+
+
+def percentiles(hist):
+    total = sum(hist)
+    if not total:
+        return ['-', '-', '-']
+    out = []
+    for pct in (50, 99):
+        acc = 0
+        for i, cnt in enumerate(hist):
+            acc += cnt
+            if acc * 100 >= total * pct:
+                out.append(bucket_usecs(i, len(hist)))
+                break
+    last = max(i for i, cnt in enumerate(hist) if cnt)
+    out.append(bucket_usecs(last, len(hist)))
+    return out
+
+
+def delta(cur, last):
+    if last is None:
+        return cur
+    return [c - l for c, l in zip(cur, last)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=desc,
+                                     formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument('workqueue', metavar='REGEX', nargs='*',
+                        help='Target workqueue name patterns (all if empty)')
+    parser.add_argument('-i', '--interval', metavar='SECS', type=float,
+                        default=1, help='Monitoring interval (0 to print once and exit)')
+    parser.add_argument('-l', '--latency', action='store_true',
+                        help='Print queueing and execution time distributions')
+    parser.add_argument('-a', '--all', action='store_true',
+                        help='Also print idle workqueues')
+    args = parser.parse_args()
+
+    filt = [re.compile(r) for r in args.workqueue]
+
+    def selected(name):
+        return not filt or any(r.search(name) for r in filt)
+
+    last_stats = {}
+    last_hists = {}
+    while True:
+        try:
+            stats = read_stats(DEBUGFS + '/stats')
+            hists = read_latency(DEBUGFS + '/latency') if args.latency else {}
+        except OSError as e:
+            sys.exit('failed to read {}: {}'.format(e.filename, e.strerror))
+
+        print('{:<24} {:>10} {:>8} {:>10} {:>8} {:>8} {:>7} {:>7}'
+              .format('workqueue', 'total', 'infl', 'CPUtime', 'CPUitsv',
+                      'CMwake', 'mayday', 'rescued'), end='')
+        if args.latency:
+            print('  {:>7} {:>7} {:>7}  {:>7} {:>7} {:>7}'
+                  .format('q.p50', 'q.p99', 'q.max', 'e.p50', 'e.p99', 'e.max'),
+                  end='')
+        print()
+
+        for name, cur in stats.items():
+            if not selected(name):
+                continue
+            d = delta(cur, last_stats.get(name))
+            if not args.all and last_stats and not d[0]:
+                continue
+            print('{:<24} {:>10} {:>8} {:>10.1f} {:>8} {:>8} {:>7} {:>7}'
+                  .format(name[:24], d[0], cur[0] - cur[1], d[2] / 1000,
+                          d[3], d[4], d[5], d[6]), end='')
+            if args.latency:
+                for kind in ('queue', 'exec'):
+                    key = (name, kind)
+                    if key not in hists:
+                        print('  {:>7} {:>7} {:>7}'.format('-', '-', '-'), end='')
+                        continue
+                    p = percentiles(delta(hists[key], last_hists.get(key)))
+                    print('  {:>7} {:>7} {:>7}'.format(*p), end='')
+            print()
+
+        if args.interval == 0:
+            break
+        last_stats = stats
+        last_hists = hists
+        print()
+        time.sleep(args.interval)
+
+
+if __name__ == '__main__':
+    main()